@@ -151,15 +151,19 @@ int Base64encode(char *encoded, const char *string, int len) {
 }
 
 namespace Base64 {
+// The buffers live on the heap rather than the stack, since the payloads
+// from the back end can be several megabytes long.
 std::string encode(const std::string& s) {
-    char buf[Base64encode_len(s.length()) + 32];
-    Base64encode(buf, s.c_str(), s.length());
-    return std::string(buf);
+    std::string buf(Base64encode_len(s.length()), '\0');
+    int n = Base64encode(&buf[0], s.c_str(), s.length());
+    buf.resize(n - 1);
+    return buf;
 }
 
 std::string decode(const std::string& s) {
-    char buf[Base64decode_len(s.c_str())];
-    Base64decode(buf, s.c_str());
-    return std::string(buf);
+    std::string buf(Base64decode_len(s.c_str()), '\0');
+    int n = Base64decode(&buf[0], s.c_str());
+    buf.resize(n);
+    return buf;
 }
 }
@@ -0,0 +1,634 @@
+/**
+ * @file concurrentqueue.h
+ *
+ * @brief
+ * This file exports the SPSCQueue and MPMCQueue classes, bounded
+ * first-in/first-out queues that can be shared between threads
+ * created with \c fork without any external locking.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _concurrentqueue_h
+#define _concurrentqueue_h
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include "thread.h"
+
+/*
+ * Implementation notes: QueueWaitSet
+ * ----------------------------------
+ * The lock-free fast paths never touch a Lock.  A thread that has to
+ * block registers itself in waiters and sleeps on the Lock's condition;
+ * the other side calls notifyAll after each successful operation, which
+ * costs only a fence and a load unless someone is actually waiting.
+ * The fences on both sides make the registration and the queue update
+ * sequentially consistent, so either the waiter sees the new element
+ * when it rechecks or the notifier sees the waiter and signals it
+ * while the waiter holds or is sleeping on the lock.  The wakePending
+ * flag collapses the notifications that arrive before the sleeper has
+ * actually run into a single signal, so a producer that keeps filling
+ * the queue does not take the lock once per element.
+ */
+
+class QueueWaitSet {
+public:
+
+   QueueWaitSet() : waiters(0), wakePending(false) {
+      /* Empty */
+   }
+
+   template <typename PredicateType>
+   void waitUntil(PredicateType ready) {
+      for (int i = 0; i < SPIN_LIMIT; i++) {
+         if (ready()) return;
+      }
+      synchronized (lock) {
+         waiters.fetch_add(1);
+         wakePending.exchange(false);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         while (!ready()) {
+            lock.wait();
+            wakePending.exchange(false);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+         }
+         waiters.fetch_sub(1);
+      }
+   }
+
+   void notifyAll() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load(std::memory_order_relaxed) > 0
+            && !wakePending.exchange(true)) {
+         synchronized (lock) {
+            lock.signal();
+         }
+      }
+   }
+
+private:
+
+   static const int SPIN_LIMIT = 16;
+
+   Lock lock;
+   std::atomic<int> waiters;
+   std::atomic<bool> wakePending;
+
+   QueueWaitSet(const QueueWaitSet & src);
+   QueueWaitSet & operator=(const QueueWaitSet & src);
+
+};
+
+/**
+ * @class SPSCQueue
+ *
+ * @brief This class implements a bounded, lock-free queue for exactly
+ * one producer thread and exactly one consumer thread.
+ *
+ * The producer calls \ref enqueue or \ref tryEnqueue, and the consumer
+ * calls \ref dequeue or \ref tryDequeue.  Neither side ever acquires a
+ * lock unless it has to block because the queue is full or empty.
+ * Calling the producer methods from more than one thread, or the
+ * consumer methods from more than one thread, is not supported; use
+ * MPMCQueue for that.
+ */
+template <typename ValueType>
+class SPSCQueue {
+
+public:
+
+/**
+ * Creates a new empty queue that holds at least \em capacity values.
+ * The capacity is rounded up to the next power of two.
+ *
+ * Sample usage:
+ *
+ *     SPSCQueue<ValueType> queue(capacity);
+ */
+   explicit SPSCQueue(int capacity);
+
+
+/**
+ * Frees any heap storage associated with this queue.
+ */
+   virtual ~SPSCQueue();
+
+
+/**
+ * Adds \em value to the end of this queue, waiting for space if the
+ * queue is full.  May be called only from the producer thread.
+ *
+ * Sample usage:
+ *
+ *     queue.enqueue(value);
+ */
+   void enqueue(const ValueType & value);
+
+
+/**
+ * Removes and returns the first value in this queue, waiting for a
+ * value to arrive if the queue is empty.  May be called only from the
+ * consumer thread.
+ *
+ * Sample usage:
+ *
+ *     ValueType first = queue.dequeue();
+ */
+   ValueType dequeue();
+
+
+/**
+ * Adds \em value to the end of this queue if there is room and returns
+ * \c true; returns \c false without waiting if the queue is full.
+ *
+ * Sample usage:
+ *
+ *     if (queue.tryEnqueue(value)) ...
+ */
+   bool tryEnqueue(const ValueType & value);
+
+
+/**
+ * Removes the first value in this queue and stores it in \em value,
+ * returning \c true; returns \c false without waiting if the queue is
+ * empty.
+ *
+ * Sample usage:
+ *
+ *     if (queue.tryDequeue(value)) ...
+ */
+   bool tryDequeue(ValueType & value);
+
+
+/**
+ * Returns the number of values in this queue.  When other threads are
+ * active, the result is only a snapshot.
+ *
+ * Sample usage:
+ *
+ *     int n = queue.size();
+ */
+   int size() const;
+
+
+/**
+ * Returns \c true if this queue contains no values.  When other threads
+ * are active, the result is only a snapshot.
+ *
+ * Sample usage:
+ *
+ *     if (queue.isEmpty()) ...
+ */
+   bool isEmpty() const;
+
+
+/**
+ * Returns the maximum number of values this queue can hold.
+ *
+ * Sample usage:
+ *
+ *     int max = queue.capacity();
+ */
+   int capacity() const;
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Implementation notes: SPSCQueue data structure
+ * ----------------------------------------------
+ * The queue is a ring buffer indexed by two counters that only ever
+ * increase: head belongs to the consumer and tail to the producer.
+ * Each side publishes its counter with a release store and reads the
+ * other side's counter with an acquire load, which is enough to hand
+ * off the buffer slot.  Each side also keeps a private copy of the
+ * other side's counter and rereads the shared one only when the copy
+ * says the queue is full (or empty), so in the steady state the two
+ * threads rarely touch each other's cache lines.  The padding keeps
+ * the two counters on separate cache lines.
+ */
+
+private:
+
+   static const int CACHE_LINE_SIZE = 64;
+
+/* Instance variables */
+
+   ValueType *buffer;                  /* Ring buffer of size mask + 1     */
+   size_t mask;                        /* Buffer size minus one            */
+   char pad0[CACHE_LINE_SIZE];
+   std::atomic<size_t> head;           /* Next slot to dequeue (consumer)  */
+   size_t cachedTail;                  /* Consumer's copy of tail          */
+   char pad1[CACHE_LINE_SIZE];
+   std::atomic<size_t> tail;           /* Next slot to enqueue (producer)  */
+   size_t cachedHead;                  /* Producer's copy of head          */
+   char pad2[CACHE_LINE_SIZE];
+   QueueWaitSet notEmpty;              /* Consumers blocked in dequeue     */
+   QueueWaitSet notFull;               /* Producers blocked in enqueue     */
+
+/* Private methods */
+
+   bool push(const ValueType & value);
+   bool pop(ValueType & value);
+   SPSCQueue(const SPSCQueue & src);
+   SPSCQueue & operator=(const SPSCQueue & src);
+
+};
+
+/**
+ * @class MPMCQueue
+ *
+ * @brief This class implements a bounded, lock-free queue that any
+ * number of producer and consumer threads may share.
+ *
+ * The interface is the same as that of SPSCQueue.  MPMCQueue costs one
+ * compare-and-swap per operation more than SPSCQueue, so SPSCQueue is
+ * the better choice for a simple two-thread pipeline.
+ */
+template <typename ValueType>
+class MPMCQueue {
+
+public:
+
+/**
+ * Creates a new empty queue that holds at least \em capacity values.
+ * The capacity is rounded up to the next power of two.
+ *
+ * Sample usage:
+ *
+ *     MPMCQueue<ValueType> queue(capacity);
+ */
+   explicit MPMCQueue(int capacity);
+
+
+/**
+ * Frees any heap storage associated with this queue.
+ */
+   virtual ~MPMCQueue();
+
+
+/**
+ * Adds \em value to the end of this queue, waiting for space if the
+ * queue is full.
+ *
+ * Sample usage:
+ *
+ *     queue.enqueue(value);
+ */
+   void enqueue(const ValueType & value);
+
+
+/**
+ * Removes and returns the first value in this queue, waiting for a
+ * value to arrive if the queue is empty.
+ *
+ * Sample usage:
+ *
+ *     ValueType first = queue.dequeue();
+ */
+   ValueType dequeue();
+
+
+/**
+ * Adds \em value to the end of this queue if there is room and returns
+ * \c true; returns \c false without waiting if the queue is full.
+ *
+ * Sample usage:
+ *
+ *     if (queue.tryEnqueue(value)) ...
+ */
+   bool tryEnqueue(const ValueType & value);
+
+
+/**
+ * Removes the first value in this queue and stores it in \em value,
+ * returning \c true; returns \c false without waiting if the queue is
+ * empty.
+ *
+ * Sample usage:
+ *
+ *     if (queue.tryDequeue(value)) ...
+ */
+   bool tryDequeue(ValueType & value);
+
+
+/**
+ * Returns the number of values in this queue.  When other threads are
+ * active, the result is only a snapshot.
+ *
+ * Sample usage:
+ *
+ *     int n = queue.size();
+ */
+   int size() const;
+
+
+/**
+ * Returns \c true if this queue contains no values.  When other threads
+ * are active, the result is only a snapshot.
+ *
+ * Sample usage:
+ *
+ *     if (queue.isEmpty()) ...
+ */
+   bool isEmpty() const;
+
+
+/**
+ * Returns the maximum number of values this queue can hold.
+ *
+ * Sample usage:
+ *
+ *     int max = queue.capacity();
+ */
+   int capacity() const;
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Implementation notes: MPMCQueue data structure
+ * ----------------------------------------------
+ * This is Dmitry Vyukov's bounded MPMC queue.  Every cell carries a
+ * sequence number that tells which pass around the ring it is ready
+ * for.  A producer that has claimed position pos (by advancing
+ * enqueuePos with a compare-and-swap) may write the cell once its
+ * sequence equals pos, and then sets the sequence to pos + 1.  A
+ * consumer that has claimed position pos may read the cell once its
+ * sequence equals pos + 1, and then sets it to pos + size, which is
+ * what the producer on the next pass waits for.  A thread that finds
+ * the sequence behind its position knows the queue is full (or empty)
+ * without looking at the other counter.
+ */
+
+private:
+
+   static const int CACHE_LINE_SIZE = 64;
+
+   struct Cell {
+      std::atomic<size_t> sequence;    /* Pass number this cell is ready for */
+      ValueType value;                 /* The stored value                   */
+   };
+
+/* Instance variables */
+
+   Cell *cells;                        /* Ring buffer of size mask + 1     */
+   size_t mask;                        /* Buffer size minus one            */
+   char pad0[CACHE_LINE_SIZE];
+   std::atomic<size_t> enqueuePos;     /* Next position for producers      */
+   char pad1[CACHE_LINE_SIZE];
+   std::atomic<size_t> dequeuePos;     /* Next position for consumers      */
+   char pad2[CACHE_LINE_SIZE];
+   QueueWaitSet notEmpty;              /* Consumers blocked in dequeue     */
+   QueueWaitSet notFull;               /* Producers blocked in enqueue     */
+
+/* Private methods */
+
+   bool push(const ValueType & value);
+   bool pop(ValueType & value);
+   MPMCQueue(const MPMCQueue & src);
+   MPMCQueue & operator=(const MPMCQueue & src);
+
+};
+
+extern void error(std::string msg);
+
+/*
+ * Implementation notes: roundUpToPowerOfTwo
+ * -----------------------------------------
+ * Both queues use a power-of-two buffer so that positions can be
+ * reduced to slot indices with a mask instead of a division.  The
+ * helper lives in the _cq namespace to keep it out of client code.
+ */
+
+namespace _cq {
+   inline size_t roundUpToPowerOfTwo(int n) {
+      size_t size = 1;
+      while (size < size_t(n)) {
+         size <<= 1;
+      }
+      return size;
+   }
+}
+
+template <typename ValueType>
+SPSCQueue<ValueType>::SPSCQueue(int capacity) : head(0), tail(0) {
+   if (capacity <= 0) error("SPSCQueue: capacity must be positive");
+   size_t size = _cq::roundUpToPowerOfTwo(capacity);
+   buffer = new ValueType[size];
+   mask = size - 1;
+   cachedTail = 0;
+   cachedHead = 0;
+}
+
+template <typename ValueType>
+SPSCQueue<ValueType>::~SPSCQueue() {
+   delete[] buffer;
+}
+
+template <typename ValueType>
+bool SPSCQueue<ValueType>::push(const ValueType & value) {
+   size_t t = tail.load(std::memory_order_relaxed);
+   if (t - cachedHead > mask) {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (t - cachedHead > mask) return false;
+   }
+   buffer[t & mask] = value;
+   tail.store(t + 1, std::memory_order_release);
+   return true;
+}
+
+template <typename ValueType>
+bool SPSCQueue<ValueType>::pop(ValueType & value) {
+   size_t h = head.load(std::memory_order_relaxed);
+   if (h == cachedTail) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (h == cachedTail) return false;
+   }
+   value = std::move(buffer[h & mask]);
+   head.store(h + 1, std::memory_order_release);
+   return true;
+}
+
+template <typename ValueType>
+bool SPSCQueue<ValueType>::tryEnqueue(const ValueType & value) {
+   if (!push(value)) return false;
+   notEmpty.notifyAll();
+   return true;
+}
+
+template <typename ValueType>
+bool SPSCQueue<ValueType>::tryDequeue(ValueType & value) {
+   if (!pop(value)) return false;
+   notFull.notifyAll();
+   return true;
+}
+
+template <typename ValueType>
+void SPSCQueue<ValueType>::enqueue(const ValueType & value) {
+   notFull.waitUntil([&]() { return push(value); });
+   notEmpty.notifyAll();
+}
+
+template <typename ValueType>
+ValueType SPSCQueue<ValueType>::dequeue() {
+   ValueType value;
+   notEmpty.waitUntil([&]() { return pop(value); });
+   notFull.notifyAll();
+   return value;
+}
+
+template <typename ValueType>
+int SPSCQueue<ValueType>::size() const {
+   size_t h = head.load(std::memory_order_acquire);
+   size_t t = tail.load(std::memory_order_acquire);
+   return (t > h) ? int(t - h) : 0;
+}
+
+template <typename ValueType>
+bool SPSCQueue<ValueType>::isEmpty() const {
+   return size() == 0;
+}
+
+template <typename ValueType>
+int SPSCQueue<ValueType>::capacity() const {
+   return int(mask + 1);
+}
+
+template <typename ValueType>
+MPMCQueue<ValueType>::MPMCQueue(int capacity) : enqueuePos(0), dequeuePos(0) {
+   if (capacity <= 0) error("MPMCQueue: capacity must be positive");
+   size_t size = _cq::roundUpToPowerOfTwo(capacity);
+   cells = new Cell[size];
+   for (size_t i = 0; i < size; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+   }
+   mask = size - 1;
+}
+
+template <typename ValueType>
+MPMCQueue<ValueType>::~MPMCQueue() {
+   delete[] cells;
+}
+
+template <typename ValueType>
+bool MPMCQueue<ValueType>::push(const ValueType & value) {
+   Cell *cell;
+   size_t pos = enqueuePos.load(std::memory_order_relaxed);
+   while (true) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      long diff = long(seq) - long(pos);
+      if (diff == 0) {
+         if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+            break;
+         }
+      } else if (diff < 0) {
+         return false;
+      } else {
+         pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+   }
+   cell->value = value;
+   cell->sequence.store(pos + 1, std::memory_order_release);
+   return true;
+}
+
+template <typename ValueType>
+bool MPMCQueue<ValueType>::pop(ValueType & value) {
+   Cell *cell;
+   size_t pos = dequeuePos.load(std::memory_order_relaxed);
+   while (true) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      long diff = long(seq) - long(pos + 1);
+      if (diff == 0) {
+         if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+            break;
+         }
+      } else if (diff < 0) {
+         return false;
+      } else {
+         pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+   }
+   value = std::move(cell->value);
+   cell->sequence.store(pos + mask + 1, std::memory_order_release);
+   return true;
+}
+
+template <typename ValueType>
+bool MPMCQueue<ValueType>::tryEnqueue(const ValueType & value) {
+   if (!push(value)) return false;
+   notEmpty.notifyAll();
+   return true;
+}
+
+template <typename ValueType>
+bool MPMCQueue<ValueType>::tryDequeue(ValueType & value) {
+   if (!pop(value)) return false;
+   notFull.notifyAll();
+   return true;
+}
+
+template <typename ValueType>
+void MPMCQueue<ValueType>::enqueue(const ValueType & value) {
+   notFull.waitUntil([&]() { return push(value); });
+   notEmpty.notifyAll();
+}
+
+template <typename ValueType>
+ValueType MPMCQueue<ValueType>::dequeue() {
+   ValueType value;
+   notEmpty.waitUntil([&]() { return pop(value); });
+   notFull.notifyAll();
+   return value;
+}
+
+template <typename ValueType>
+int MPMCQueue<ValueType>::size() const {
+   size_t h = dequeuePos.load(std::memory_order_acquire);
+   size_t t = enqueuePos.load(std::memory_order_acquire);
+   return (t > h) ? int(t - h) : 0;
+}
+
+template <typename ValueType>
+bool MPMCQueue<ValueType>::isEmpty() const {
+   return size() == 0;
+}
+
+template <typename ValueType>
+int MPMCQueue<ValueType>::capacity() const {
+   return int(mask + 1);
+}
+
+#endif
@@ -33,13 +33,24 @@
 /*************************************************************************/
 
 #include "gbufferedimage.h"
+#include <fstream>
 #include <iomanip>
-#include "base64.h"
+#include <sstream>
 #include "filelib.h"
 #include "gwindow.h"
 #include "platform.h"
+#include "private/imagecodec.h"
+#include "private/imagekernels.h"
 
 static Platform* pp = getPlatform();
+
+// limits on the rectangles of changed pixels kept by markDirty
+static const int MAX_DAMAGE_RECTS = 16;
+static const double MERGE_SLACK = 64;
+
+static int* pixelRow(const Grid<int>& grid, int y);
+static GRectangle rectUnion(const GRectangle& r1, const GRectangle& r2);
+static double rectWaste(const GRectangle& r1, const GRectangle& r2);
 static int stringToRGB(const std::string color);
 static std::string rgbToString(const int rgb);
 
@@ -47,7 +58,9 @@ GBufferedImage::GBufferedImage()
         : GInteractor(),
           m_width(0),
           m_height(0),
-          m_backgroundColor(0) {
+          m_backgroundColor(0),
+          m_doubleBuffered(false),
+          m_pendingFill(-1) {
     init(0, 0, 0, 0, 0x000000);
 }
 
@@ -64,7 +77,9 @@ GBufferedImage::GBufferedImage(double width, double height,
     : GInteractor(),
       m_width(0),
       m_height(0),
-      m_backgroundColor(rgbBackground) {
+      m_backgroundColor(rgbBackground),
+      m_doubleBuffered(false),
+      m_pendingFill(-1) {
     init(0, 0, width, height, rgbBackground);
 }
 
@@ -73,7 +88,9 @@ GBufferedImage::GBufferedImage(double x, double y, double width, double height,
     : GInteractor(),
       m_width(width),
       m_height(height),
-      m_backgroundColor(rgbBackground) {
+      m_backgroundColor(rgbBackground),
+      m_doubleBuffered(false),
+      m_pendingFill(-1) {
     init(x, y, width, height, rgbBackground);
 }
 
@@ -82,7 +99,9 @@ GBufferedImage::GBufferedImage(double x, double y, double width, double height,
     : GInteractor(),
       m_width(width),
       m_height(height),
-      m_backgroundColor(0) {
+      m_backgroundColor(0),
+      m_doubleBuffered(false),
+      m_pendingFill(-1) {
     init(x, y, width, height, stringToRGB(rgbBackground));
 }
 
@@ -98,6 +117,14 @@ std::string GBufferedImage::toString() const {
     return "GBufferedImage()";
 }
 
+void GBufferedImage::blur(int radius) {
+    if (radius < 0) {
+        error("GBufferedImage::blur: radius cannot be negative");
+    }
+    boxBlurImage(m_pixels, radius);
+    markAllDirty();
+}
+
 void GBufferedImage::clear() {
     fill(m_backgroundColor);
 }
@@ -115,13 +142,7 @@ int GBufferedImage::countDiffPixels(GBufferedImage& image) const {
     int diffPxCount = (w1 * h1 - overlap) + (w2 * h2 - overlap);
 
     for (int y = 0; y < hmin; y++) {
-        for (int x = 0; x < wmin; x++) {
-            int px1 = m_pixels[y][x];
-            int px2 = image.m_pixels[y][x];
-            if (px1 != px2) {
-                diffPxCount++;
-            }
-        }
+        diffPxCount += countDiffSpan(pixelRow(m_pixels, y), pixelRow(image.m_pixels, y), wmin);
     }
 
     return diffPxCount;
@@ -137,24 +158,73 @@ GBufferedImage* GBufferedImage::diff(GBufferedImage& image, int diffPixelColor)
     int wmax = std::max(w1, w2);
     int hmax = std::max(h1, h2);
     
-    GBufferedImage* result = new GBufferedImage(wmax, hmax, diffPixelColor);
-    result->fillRegion(0, 0, w1, h1, m_backgroundColor);
-    for (int y = 0; y < hmin; y++) {
-        for (int x = 0; x < wmin; x++) {
-            int px1 = m_pixels[y][x];
-            int px2 = image.m_pixels[y][x];
-            if (px1 != px2) {
-                result->setRGB(x, y, diffPixelColor);
-            }
+    checkColor("diff", diffPixelColor);
+
+    // build the result here so that it reaches the back end in one message
+    Grid<int> pixels(hmax, wmax);
+    for (int y = 0; y < hmax; y++) {
+        int* row = pixelRow(pixels, y);
+        fillSpan(row, wmax, diffPixelColor);
+        if (y < h1) {
+            fillSpan(row, w1, m_backgroundColor);
+        }
+        if (y < hmin) {
+            diffSpan(pixelRow(m_pixels, y), pixelRow(image.m_pixels, y), row, wmin,
+                     m_backgroundColor, diffPixelColor);
         }
     }
+    GBufferedImage* result = new GBufferedImage(wmax, hmax, diffPixelColor);
+    result->setPixels(pixels);
     return result;
 }
 
+void GBufferedImage::drawImage(const GBufferedImage& image, double x, double y) {
+    drawImage(image, x, y, 1.0);
+}
+
+void GBufferedImage::drawImage(const GBufferedImage& image, double x, double y, double alpha) {
+    if (alpha < 0 || alpha > 1) {
+        error("GBufferedImage::drawImage: alpha must be between 0.0 and 1.0");
+    }
+    int dx = (int) x;
+    int dy = (int) y;
+    int left = std::max(dx, 0);
+    int top = std::max(dy, 0);
+    int right = std::min(dx + (int) image.m_width, (int) m_width);
+    int bottom = std::min(dy + (int) image.m_height, (int) m_height);
+    if (right <= left || bottom <= top) {
+        return;
+    }
+
+    // drawing an image onto itself must read the pixels before they change
+    Grid<int> copy;
+    const Grid<int>* source = &image.m_pixels;
+    if (&image == this) {
+        copy = m_pixels;
+        source = &copy;
+    }
+    int weight = (int) (alpha * 256 + 0.5);
+    for (int r = top; r < bottom; r++) {
+        const int* src = pixelRow(*source, r - dy) + (left - dx);
+        int* dst = pixelRow(m_pixels, r) + left;
+        if (weight == 256) {
+            std::copy(src, src + (right - left), dst);
+        } else {
+            blendSpan(src, dst, right - left, weight);
+        }
+    }
+    markDirty(left, top, right - left, bottom - top);
+}
+
 void GBufferedImage::fill(int rgb) {
     checkColor("fill", rgb);
     m_pixels.fill(rgb);
-    pp->gbufferedimage_fill(this, rgb);
+    clearDirty(0, 0, (int) m_width, (int) m_height);
+    if (m_doubleBuffered) {
+        m_pendingFill = rgb;
+    } else {
+        pp->gbufferedimage_fill(this, rgb);
+    }
 }
 
 void GBufferedImage::fill(std::string rgb) {
@@ -166,21 +236,42 @@ void GBufferedImage::fillRegion(double x, double y, double width, double height,
     checkIndex("fillRegion", x + width - 1, y + height - 1);
     checkColor("fillRegion", rgb);
     for (int r = (int) y; r < y + height; r++) {
-        for (int c = (int) x; c < x + width; c++) {
-            m_pixels[r][c] = rgb;
-        }
+        fillSpan(pixelRow(m_pixels, r) + (int) x, (int) width, rgb);
+    }
+    if (m_doubleBuffered) {
+        markDirty((int) x, (int) y, (int) width, (int) height);
+    } else {
+        clearDirty((int) x, (int) y, (int) width, (int) height);
+        pp->gbufferedimage_fillRegion(this, x, y, width, height, rgb);
     }
-    pp->gbufferedimage_fillRegion(this, x, y, width, height, rgb);
 }
 
 void GBufferedImage::fillRegion(double x, double y, double width, double height, std::string rgb) {
     fillRegion(x, y, width, height, stringToRGB(rgb));
 }
 
+void GBufferedImage::flush() {
+    if (!m_doubleBuffered) {
+        sendChanges();
+    }
+}
+
+void GBufferedImage::gaussianBlur(double sigma) {
+    if (sigma < 0) {
+        error("GBufferedImage::gaussianBlur: sigma cannot be negative");
+    }
+    gaussianBlurImage(m_pixels, sigma);
+    markAllDirty();
+}
+
 double GBufferedImage::getHeight() const {
     return m_height;
 }
 
+const Grid<int>& GBufferedImage::getPixels() const {
+    return m_pixels;
+}
+
 int GBufferedImage::getRGB(double x, double y) const {
     checkIndex("getRGB", x, y);
     return m_pixels[(int) y][(int) x];
@@ -194,6 +285,10 @@ double GBufferedImage::getWidth() const {
     return m_width;
 }
 
+bool GBufferedImage::isDoubleBuffered() const {
+    return m_doubleBuffered;
+}
+
 bool GBufferedImage::inBounds(double x, double y) const {
     return m_pixels.inBounds((int) y, (int) x);
 }
@@ -205,6 +300,20 @@ void GBufferedImage::load(const std::string& filename) {
         error("GBufferedImage::load: file not found: " + filename);
     }
 
+    // PNG, PPM, and BMP files are decoded here; the pixels reach the
+    // back end in a single message, along with any later changes
+    std::ifstream input(filename.c_str(), std::ios::binary);
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    if (input.fail()) {
+        error("GBufferedImage::load: cannot read " + filename);
+    }
+    Grid<int> pixels;
+    if (decodeImage(contents.str(), pixels)) {
+        setPixels(pixels);
+        return;
+    }
+
     // BUGFIX (JL): due to back-end restriction, can't load if width or height was 0,
     //   because no Java BufferedImage object was created.
     bool wasEmpty = (this->m_width == 0 || this->m_height == 0);
@@ -212,38 +321,21 @@ void GBufferedImage::load(const std::string& filename) {
         resize(1, 1);
     }
 
-    std::string result = pp->gbufferedimage_load(this, filename);
-    result = Base64::decode(result);
-    std::istringstream input(result);
-    std::string line;
-    if (!getline(input, line)) {
-        error("GBufferedImage::load: image data does not contain valid width");
-    }
-    m_width = stringToInteger(line);
-    if (!getline(input, line)) {
-        error("GBufferedImage::load: image data does not contain valid height");
-    }
-    m_height = stringToInteger(line);
-
-    // BUGFIX (JL) : avoid crash if current grid not big enough to hold image
-    m_pixels.resize(m_height, m_width);
+    // the loaded image replaces any pixels that have not been sent yet
+    clearDirty(0, 0, (int) m_width, (int) m_height);
+    readImage("load", pp->gbufferedimage_load(this, filename));
+}
 
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            if (!getline(input, line)) {
-                error("GBufferedImage::load: image data does not contain valid pixel (x="
-                      + integerToString(x) + ", y=" + integerToString(y) + ")");
-            }
-            // BUGFIX (JL) added mask, because convertColorToRGB returns an int of the form
-            // 0xaarrggbb, but GBufferedImage assumes all ints representing colors are of the
-            // form 0xrrggbb.
-            int px = convertColorToRGB(line) & 0x00FFFFFF;
-            m_pixels[y][x] = px;
-        }
-    }
+void GBufferedImage::present() {
+    sendChanges();
 }
 
 void GBufferedImage::resize(double width, double height, bool retain) {
+    if (retain) {
+        flush();
+    } else {
+        clearDirty(0, 0, (int) m_width, (int) m_height);
+    }
     bool wasZero = (this->m_width == 0 && this->m_height == 0);
     this->m_width = width;
     this->m_height = height;
@@ -258,58 +350,109 @@ void GBufferedImage::resize(double width, double height, bool retain) {
         if (!retain && m_backgroundColor != 0x0) {
             this->m_pixels.fill(m_backgroundColor);
         }
+        if (retain && m_doubleBuffered) {
+            // the back end has kept the last frame presented, not the
+            // changes made since, so the next frame sends every pixel
+            clearDirty(0, 0, (int) m_width, (int) m_height);
+            markAllDirty();
+        }
     }
+    boundsChanged();
 }
 
-GBufferedImage *GBufferedImage::rescale(int width, int height) const {
+GBufferedImage *GBufferedImage::rescale(int width, int height, ScaleFilter filter) const {
     checkSize("rescale", width, height);
-    GBufferedImage *scaledImage = new GBufferedImage(1, 1);
-    std::string result = pp->gbufferedimage_scale(this, scaledImage, width, height);
-
-    result = Base64::decode(result);
-    std::istringstream input(result);
-    std::string line;
-    if (!getline(input, line)) {
-        error("GBufferedImage::rescale: image data does not contain valid width");
-    }
-    scaledImage->m_width = stringToInteger(line);
-    if (!getline(input, line)) {
-        error("GBufferedImage::rescale: image data does not contain valid height");
-    }
-    scaledImage->m_height = stringToInteger(line);
-    scaledImage->m_pixels.resize(m_height, m_width);
-
-    for (int y = 0; y < scaledImage->m_height; y++) {
-        for (int x = 0; x < scaledImage->m_width; x++) {
-            if (!getline(input, line)) {
-                error("GBufferedImage::rescale: image data does not contain valid pixel (x="
-                      + integerToString(x) + ", y=" + integerToString(y) + ")");
-            }
-            int px = convertColorToRGB(line) & 0x00FFFFFF;
-
-            scaledImage->m_pixels[y][x] = px;
-        }
+    ResampleFilter resample = RESAMPLE_AREA;
+    if (filter == NEAREST) {
+        resample = RESAMPLE_NEAREST;
+    } else if (filter == BILINEAR) {
+        resample = RESAMPLE_BILINEAR;
     }
-
+    Grid<int> pixels;
+    resampleImage(m_pixels, pixels, width, height, resample);
+    GBufferedImage *scaledImage = new GBufferedImage(width, height);
+    scaledImage->setPixels(pixels);
     return scaledImage;
 }
 
 
 void GBufferedImage::save(const std::string& filename) const {
-    pp->gbufferedimage_save(this, filename);
+    if (!isEncodableImageFile(filename)) {
+        pp->gbufferedimage_save(this, filename);
+        return;
+    }
+    std::string data = encodeImage(m_pixels, filename);
+    std::ofstream output(filename.c_str(), std::ios::binary);
+    output.write(data.data(), data.length());
+    output.close();
+    if (output.fail()) {
+        error("GBufferedImage::save: cannot write " + filename);
+    }
+}
+
+void GBufferedImage::setDoubleBuffered(bool flag) {
+    bool wasDoubleBuffered = m_doubleBuffered;
+    m_doubleBuffered = flag;
+    if (wasDoubleBuffered && !flag) {
+        sendChanges();
+    }
 }
 
 void GBufferedImage::setRGB(double x, double y, int rgb) {
     checkIndex("setRGB", x, y);
     checkColor("setRGB", rgb);
     m_pixels[(int) y][(int) x] = rgb;
-    pp->gbufferedimage_setRGB(this, x, y, rgb);
+    markDirty((int) x, (int) y, 1, 1);
 }
 
 void GBufferedImage::setRGB(double x, double y, std::string rgb) {
     setRGB(x, y, stringToRGB(rgb));
 }
 
+void GBufferedImage::setPixels(const Grid<int>& pixels) {
+    for (int r = 0; r < pixels.numRows(); r++) {
+        if (!isRGBSpan(pixelRow(pixels, r), pixels.numCols())) {
+            error("GBufferedImage::setPixels: color is outside of range 0x000000 through 0xffffff");
+        }
+    }
+    if (pixels.numRows() != (int) m_height || pixels.numCols() != (int) m_width) {
+        resize(pixels.numCols(), pixels.numRows(), false);
+    }
+    m_pixels = pixels;
+    markAllDirty();
+}
+
+void GBufferedImage::threshold(int level, int rgbDark, int rgbLight) {
+    checkColor("threshold", rgbDark);
+    checkColor("threshold", rgbLight);
+    for (int r = 0; r < (int) m_height; r++) {
+        int* row = pixelRow(m_pixels, r);
+        thresholdSpan(row, row, (int) m_width, level, rgbDark, rgbLight);
+    }
+    markAllDirty();
+}
+
+void GBufferedImage::toGrayscale() {
+    for (int r = 0; r < (int) m_height; r++) {
+        int* row = pixelRow(m_pixels, r);
+        grayscaleSpan(row, row, (int) m_width);
+    }
+    markAllDirty();
+}
+
+void GBufferedImage::updateRegion(double x, double y, double width, double height) {
+    checkIndex("updateRegion", x, y);
+    checkIndex("updateRegion", x + width - 1, y + height - 1);
+    if (m_pendingFill >= 0) {
+        // the region must not be covered later by an earlier fill
+        pp->gbufferedimage_fill(this, m_pendingFill);
+        m_pendingFill = -1;
+    }
+    clearDirty((int) x, (int) y, (int) width, (int) height);
+    pp->gbufferedimage_updateRegion(this, m_pixels, (int) x, (int) y,
+                                    (int) width, (int) height);
+}
+
 void GBufferedImage::checkColor(std::string member, int rgb) const {
     if (rgb < 0x0 || rgb > 0xffffff) {
         error("GBufferedImage::" + member
@@ -334,6 +477,20 @@ void GBufferedImage::checkSize(std::string member, double width, double height)
     }
 }
 
+void GBufferedImage::clearDirty(int x, int y, int width, int height) {
+    for (int i = m_damage.size() - 1; i >= 0; i--) {
+        const GRectangle& rect = m_damage[i];
+        if (rect.getX() >= x && rect.getY() >= y
+                && rect.getX() + rect.getWidth() <= x + width
+                && rect.getY() + rect.getHeight() <= y + height) {
+            m_damage.remove(i);
+        }
+    }
+    if (x <= 0 && y <= 0 && x + width >= m_width && y + height >= m_height) {
+        m_pendingFill = -1;
+    }
+}
+
 void GBufferedImage::init(double x, double y, double width, double height,
                           int rgb) {
     checkSize("constructor", width, height);
@@ -359,6 +516,128 @@ void GBufferedImage::init(double x, double y, double width, double height,
     }
 }
 
+void GBufferedImage::readImage(std::string member, const std::string& data) {
+    const unsigned char* bytes = (const unsigned char*) data.data();
+    if (data.length() < 8) {
+        error("GBufferedImage::" + member + ": image data does not contain valid width and height");
+    }
+    int width = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    int height = (bytes[4] << 24) | (bytes[5] << 16) | (bytes[6] << 8) | bytes[7];
+    if (width < 0 || height < 0 || data.length() - 8 < 3 * (size_t) width * height) {
+        error("GBufferedImage::" + member + ": image data does not contain "
+              + integerToString(width) + "x" + integerToString(height) + " pixels");
+    }
+    m_width = width;
+    m_height = height;
+    m_pixels.resize(height, width);
+    const unsigned char* px = bytes + 8;
+    for (int& rgb : m_pixels) {
+        rgb = (px[0] << 16) | (px[1] << 8) | px[2];
+        px += 3;
+    }
+    boundsChanged();
+}
+
+void GBufferedImage::markAllDirty() {
+    if (m_width > 0 && m_height > 0) {
+        markDirty(0, 0, (int) m_width, (int) m_height);
+    }
+}
+
+void GBufferedImage::markDirty(int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (m_damage.isEmpty() && !m_doubleBuffered) {
+        pp->gbufferedimage_markDirty(this);
+    }
+    GRectangle rect(x, y, width, height);
+    for (int i = 0; i < m_damage.size(); i++) {
+        if (rectWaste(m_damage[i], rect) <= MERGE_SLACK) {
+            // a rectangle that already covers the region is the usual case
+            if (rectUnion(m_damage[i], rect) == m_damage[i]) {
+                return;
+            }
+            rect = rectUnion(m_damage[i], rect);
+            m_damage.remove(i);
+            i = -1;
+        }
+    }
+    m_damage.add(rect);
+    if (m_damage.size() > MAX_DAMAGE_RECTS) {
+        int best1 = 0;
+        int best2 = 1;
+        for (int i = 0; i < m_damage.size(); i++) {
+            for (int j = i + 1; j < m_damage.size(); j++) {
+                if (rectWaste(m_damage[i], m_damage[j])
+                        < rectWaste(m_damage[best1], m_damage[best2])) {
+                    best1 = i;
+                    best2 = j;
+                }
+            }
+        }
+        m_damage[best1] = rectUnion(m_damage[best1], m_damage[best2]);
+        m_damage.remove(best2);
+    }
+}
+
+void GBufferedImage::sendChanges() {
+    if (m_pendingFill >= 0) {
+        int rgb = m_pendingFill;
+        m_pendingFill = -1;
+        pp->gbufferedimage_fill(this, rgb);
+    }
+    Vector<GRectangle> regions;
+    for (const GRectangle& rect : m_damage) {
+        double left = std::max(rect.getX(), 0.0);
+        double top = std::max(rect.getY(), 0.0);
+        double right = std::min(rect.getX() + rect.getWidth(), m_width);
+        double bottom = std::min(rect.getY() + rect.getHeight(), m_height);
+        if (right > left && bottom > top) {
+            regions.add(GRectangle(left, top, right - left, bottom - top));
+        }
+    }
+    m_damage.clear();
+    if (!regions.isEmpty()) {
+        pp->gbufferedimage_updateRegions(this, m_pixels, regions);
+    }
+}
+
+/*
+ * Returns the address of row y of the grid.  A Grid stores its elements
+ * contiguously in row-major order, so the row is a span of numCols()
+ * pixels that the image kernels can process directly.
+ */
+static int* pixelRow(const Grid<int>& grid, int y) {
+    return &*grid.begin() + y * grid.numCols();
+}
+
+/*
+ * Returns the smallest rectangle that contains both rectangles.
+ */
+static GRectangle rectUnion(const GRectangle& r1, const GRectangle& r2) {
+    double left = std::min(r1.getX(), r2.getX());
+    double top = std::min(r1.getY(), r2.getY());
+    double right = std::max(r1.getX() + r1.getWidth(), r2.getX() + r2.getWidth());
+    double bottom = std::max(r1.getY() + r1.getHeight(), r2.getY() + r2.getHeight());
+    return GRectangle(left, top, right - left, bottom - top);
+}
+
+/*
+ * Returns the number of pixels that replacing the two rectangles by their
+ * union would send needlessly, which is 0 if one contains the other or
+ * if they are adjacent and line up.
+ */
+static double rectWaste(const GRectangle& r1, const GRectangle& r2) {
+    GRectangle both = rectUnion(r1, r2);
+    double overlapWidth = std::max(0.0, std::min(r1.getX() + r1.getWidth(), r2.getX() + r2.getWidth())
+                                        - std::max(r1.getX(), r2.getX()));
+    double overlapHeight = std::max(0.0, std::min(r1.getY() + r1.getHeight(), r2.getY() + r2.getHeight())
+                                         - std::max(r1.getY(), r2.getY()));
+    return both.getWidth() * both.getHeight() - r1.getWidth() * r1.getHeight()
+           - r2.getWidth() * r2.getHeight() + overlapWidth * overlapHeight;
+}
+
 static int stringToRGB(const std::string color) {
     return convertColorToRGB(color) & 0x00FFFFFF;
 }
@@ -29,6 +29,7 @@
 #include "ginteractors.h"
 #include "gobjects.h"
 #include "gtypes.h"
+#include "vector.h"
 
 // default color used to highlight pixels that do not match between two images
 #define GBUFFEREDIMAGE_DEFAULT_DIFF_PIXEL_COLOR 0xdd00dd
@@ -63,22 +64,49 @@
  * into integers by discarding any fractional component (by typecasting from
  * <code>double</code> to <code>int</code>).
  *
- * Note that per-pixel graphics operations using the Stanford C++ library are
- * relatively slow.  A call to the \ref fill method is relatively
- * efficient, and a call to \ref getRGB is also efficient since pixels'
- * colors are cached locally.  But calling \ref setRGB repeatedly over
- * a large range of pixels is likely to yield poor performance.
- * This is due to the fact that the graphics are implemented using a background
- * Java process to which all graphical commands are forwarded.
- * The \c %GBufferedImage class is not performant enough to be used
- * for rapidly advancing animations or extremely complex graphical effects.
- * It also does not provide any drawing primitives other than filling
- * individual pixels and rectangular regions.
+ * Pixels' colors are kept locally, so \ref getRGB is efficient, and so is
+ * \ref setRGB: it changes only the local copy and remembers the rectangles
+ * of pixels that have changed.  The graphics are implemented using a
+ * background Java process, and the changed rectangles are sent to it in a
+ * single message when the program next sends any other graphical command,
+ * or when it calls \ref flush.  To replace every pixel at once, use
+ * \ref setPixels.
+ *
+ * For animation, an image can be made double-buffered by calling
+ * \ref setDoubleBuffered.  Then no change to its pixels, including those
+ * made by \ref fill and \ref fillRegion, appears on the screen until the
+ * program calls \ref present, which sends everything that has changed
+ * since the last frame in one message.  Each frame then costs in
+ * proportion to the area that changed, however many calls changed it.
+ * The methods that process the whole image, such as \ref blur,
+ * \ref drawImage, and \ref toGrayscale, work directly on the rows of the
+ * local copy and are much faster than equivalent loops that call
+ * \ref getRGB and \ref setRGB for each pixel.
+ * The \c %GBufferedImage class does not provide any drawing primitives
+ * other than filling pixels and rectangular regions and copying other
+ * images.
  * If you want to draw shapes and lines, use other classes from this library
  * such as GRect, GLine, and so on.
  */
 class GBufferedImage : public GInteractor {
 public:
+    /**
+     * Constants for the ways \ref rescale can compute the pixels of the
+     * scaled image.
+     *
+     * \c NEAREST copies the nearest pixel of the original image, which
+     * keeps hard edges but makes shrunken images look rough.
+     * \c BILINEAR mixes the four nearest pixels, which suits enlarging.
+     * \c AREA averages all of the pixels that each new pixel covers, which
+     * gives the best results when shrinking, such as for thumbnails; in a
+     * direction in which the image grows, it works as \c BILINEAR does.
+     */
+    enum ScaleFilter {
+        NEAREST = 0,    ///<.
+        BILINEAR = 1,   ///<.
+        AREA = 2        ///<.
+    };
+
     /** \_overload */
     GBufferedImage();
     //GBufferedImage(double width, double height);
@@ -114,6 +142,21 @@ public:
 
     /* unique GBufferedImage behavior */
 
+    /**
+     * Blurs this image by replacing each pixel with the average color of
+     * the square of pixels within \em radius pixels of it horizontally and
+     * vertically, where the pixels at the edges of the image are repeated
+     * outward as far as necessary.  A radius of 0 leaves the image as it is,
+     * and a radius larger than the image's width and height is treated as
+     * the larger of the two.  Throws an error if \em radius is negative.
+     *
+     * Sample usage:
+     *
+     *     im->blur(radius);
+     */
+    void blur(int radius);
+
+
     /**
      * Sets all pixels in this image to be the original background color passed
      * to the constructor.
@@ -151,6 +194,25 @@ public:
     GBufferedImage* diff(GBufferedImage& image, int diffPixelColor = GBUFFEREDIMAGE_DEFAULT_DIFF_PIXEL_COLOR) const;
     
 
+    /** \_overload */
+    void drawImage(const GBufferedImage& image, double x = 0, double y = 0);
+    /**
+     * Copies the pixels of the given image into this image, with the
+     * upper-left corner of the given image at (\em x, \em y).
+     * If \em alpha is passed, each copied pixel is mixed with the pixel it
+     * covers, where an \em alpha of 1.0 copies the pixel and 0.0 leaves this
+     * image unchanged.
+     * Pixels that fall outside the bounds of this image are ignored.
+     * Throws an error if \em alpha is not between 0.0 and 1.0.
+     *
+     * Sample usages:
+     *
+     *     im->drawImage(im2, x, y);
+     *     im->drawImage(im2, x, y, alpha);
+     */
+    void drawImage(const GBufferedImage& image, double x, double y, double alpha);
+
+
     /** \_overload */
     void fill(int rgb);
     /**
@@ -185,6 +247,36 @@ public:
                     std::string rgb);
 
 
+    /**
+     * Sends the pixels changed by \ref setRGB since the last flush to the
+     * back end, so that they appear on the screen.  This happens
+     * automatically before any other graphical command, so most programs
+     * never need to call this method; it is useful for showing progress
+     * while a long computation draws into the image.
+     * A double-buffered image ignores this method and shows its changes
+     * only when \ref present is called.
+     *
+     * Sample usage:
+     *
+     *     im->flush();
+     */
+    void flush();
+
+
+    /**
+     * Blurs this image with a Gaussian function whose standard deviation
+     * is \em sigma pixels, which gives a smoother result than \ref blur.
+     * The edges are treated as they are by \ref blur, and the time taken
+     * does not depend on \em sigma.
+     * Throws an error if \em sigma is negative.
+     *
+     * Sample usage:
+     *
+     *     im->gaussianBlur(sigma);
+     */
+    void gaussianBlur(double sigma);
+
+
     /**
      * Returns the height of this image in pixels.
      *
@@ -240,6 +332,17 @@ public:
     bool inBounds(double x, double y) const;
     
 
+    /**
+     * Returns \c true if this image is double-buffered, as set by
+     * \ref setDoubleBuffered.
+     *
+     * Sample usage:
+     *
+     *     if (im->isDoubleBuffered()) ...
+     */
+    bool isDoubleBuffered() const;
+
+
     /**
      * Reads this image's contents from the specified image file.
      * The file must have one of the following formats:
@@ -248,7 +351,11 @@ public:
      *  <li>Graphics Interchange Format (GIF)
      *  <li>Joint Photographic Experts Group (JPEG) format
      *  <li>Portable Network Graphics (PNG) format
+     *  <li>Portable Pixmap (PPM) or Graymap (PGM) format
      * </ul>
+     * BMP, PNG, and PPM files are decoded by the library itself, which is
+     * much faster than asking the Java back end to do it; the other formats
+     * are read by the back end.
      * If the image file is successfully loaded, this image's dimensions are
      * set to match the dimensions of the loaded image.
      *
@@ -262,6 +369,32 @@ public:
     void load(const std::string& filename);
     
 
+    /**
+     * Returns a grid of the colors of all of the pixels in this image,
+     * indexed by row (<em>y</em>) and column (<em>x</em>).
+     *
+     * Sample usage:
+     *
+     *     Grid<int> pixels = im->getPixels();
+     */
+    const Grid<int>& getPixels() const;
+
+
+    /**
+     * Shows all of the changes made to this image since the last call to
+     * \ref present, by sending the rectangles of pixels that have changed
+     * to the back end in one message.  Overlapping and nearby changes are
+     * merged into larger rectangles as they are made.  A double-buffered
+     * image should call this method once per frame of an animation.  On
+     * an image that is not double-buffered, it works as \ref flush does.
+     *
+     * Sample usage:
+     *
+     *     im->present();
+     */
+    void present();
+
+
     /**
      * Changes this image's bounds to be the given size.
      * This does not scale the image but rather just changes the range
@@ -284,12 +417,18 @@ public:
     /**
      * Returns a pointer to a new GBufferedImage that is a scaled version
      * of this one, scaled to the given width and height.
+     * The optional \em filter chooses how the new pixels are computed, as
+     * described for \ref ScaleFilter; the default is \c AREA.
+     * The image is scaled by the library itself, using several threads
+     * for large images.
+     * Throws an error if \em width or \em height is negative.
      *
      * Sample usages:
      *
-     *     GBufferedImage *scaledImage = im->scale(width, height);
+     *     GBufferedImage *scaledImage = im->rescale(width, height);
+     *     GBufferedImage *scaledImage = im->rescale(width, height, GBufferedImage::NEAREST);
      */
-    GBufferedImage *rescale(int width, int height) const;
+    GBufferedImage *rescale(int width, int height, ScaleFilter filter = AREA) const;
 
 
     /**
@@ -320,11 +459,18 @@ public:
      *      <td><code>.png</code></td>
      *  </tr>
      *  <tr>
+     *      <td>Portable Pixmap (PPM)</td>
+     *      <td><code>.ppm</code>, <code>.pnm</code></td>
+     *  </tr>
+     *  <tr>
      *      <td>Tagged Image File Format (TIFF)</td>
      *      <td><code>.tif</code>, <code>.tiff</code></td>
      *  </tr>
      * </table>
      *
+     * BMP, PNG, and PPM files are written by the library itself; the other
+     * formats are written by the Java back end.
+     *
      * This method throws an error if the given file is not writeable or the
      * requested image file format is not supported.
      *
@@ -335,17 +481,30 @@ public:
     void save(const std::string& filename) const;
 
 
+    /**
+     * Sets whether this image is double-buffered.  The changes to a
+     * double-buffered image appear on the screen only when \ref present
+     * is called, so that each frame of an animation appears at once and
+     * costs a single message.  Turning double buffering off shows any
+     * changes that are waiting.  Images are not double-buffered by
+     * default.
+     *
+     * Sample usage:
+     *
+     *     im->setDoubleBuffered(true);
+     */
+    void setDoubleBuffered(bool flag);
+
+
     /** \_overload */
     void setRGB(double x, double y, int rgb);
     /**
      * Sets the color of the pixel at the given <i>xy</i>-coordinates of this
      * image to the given value. The color may be specified as an int or a
      * string, as described above in the class description for GBufferedImage.
-     * Implementation/performance note: Each call to this method produces a
-     * call to the Java graphical back-end.  Calling this method many times
-     * in a tight loop can lead to poor performance.  If you need to fill a
-     * large rectangular region, consider calling \ref fill or \ref fillRegion
-     * instead.
+     * Implementation/performance note: This method changes only the local
+     * copy of the image; the changed pixels are sent to the back end
+     * together, as described for \ref flush.
      * Throws an error if the given (\em x, \em y) values are out of bounds.
      * Throws an error if \em rgb is not a valid color.
      *
@@ -355,11 +514,71 @@ public:
      */
     void setRGB(double x, double y, std::string rgb);
 
+
+    /**
+     * Sets the colors of all of the pixels in this image to the values in
+     * the given grid, which is indexed by row (<em>y</em>) and column
+     * (<em>x</em>).  If the grid's size differs from the image's, the image
+     * is resized to match.  The new pixels are sent to the back end in a
+     * single message.
+     * Throws an error if any value in the grid is not a valid color.
+     *
+     * Sample usage:
+     *
+     *     im->setPixels(pixels);
+     */
+    void setPixels(const Grid<int>& pixels);
+
+
+    /**
+     * Replaces each pixel of this image whose luminance is less than
+     * \em level by \em rgbDark and every other pixel by \em rgbLight.
+     * The luminance of a pixel is the level of the gray that
+     * \ref toGrayscale would give it, from 0 to 255, so a \em level of 128
+     * divides the image into the darker and lighter halves of the range.
+     * Throws an error if \em rgbDark or \em rgbLight is not a valid color.
+     *
+     * Sample usages:
+     *
+     *     im->threshold(level);
+     *     im->threshold(level, rgbDark, rgbLight);
+     */
+    void threshold(int level, int rgbDark = 0x000000, int rgbLight = 0xffffff);
+
+
+    /**
+     * Converts this image to shades of gray, giving each pixel the
+     * luminance 0.30 <em>red</em> + 0.59 <em>green</em> + 0.11 <em>blue</em>
+     * of its color.
+     *
+     * Sample usage:
+     *
+     *     im->toGrayscale();
+     */
+    void toGrayscale();
+
+
+    /**
+     * Sends the pixels in the given rectangular region of this image to the
+     * back end right away, whether or not they have changed.  Most programs
+     * should call \ref flush instead, which sends only the changed pixels.
+     * Throws an error if the given x/y/width/height range goes outside the
+     * bounds of the image.
+     *
+     * Sample usage:
+     *
+     *     im->updateRegion(x, y, width, height);
+     */
+    void updateRegion(double x, double y, double width, double height);
+
 private:
     double m_width;          // really, these are treated as integers
     double m_height;
     int m_backgroundColor;
     Grid<int> m_pixels;      // row-major; [y][x]
+    bool m_doubleBuffered;   // changes wait for present
+    int m_pendingFill;       // fill color not yet sent, or -1
+    Vector<GRectangle> m_damage;   // pixels changed locally but not yet sent
 
     /*
      * Throws an error if the given rgb value is not a valid color.
@@ -376,10 +595,39 @@ private:
      */
     void checkSize(std::string member, double width, double height) const;
 
+    /*
+     * Forgets the changed rectangles that lie within the given region,
+     * which is about to be sent or overwritten in the back end.
+     */
+    void clearDirty(int x, int y, int width, int height);
+
     /*
      * Initializes private member variables; called by all constructors.
      */
     void init(double x, double y, double width, double height, int rgb);
+
+    /*
+     * Replaces this image's size and pixels with the image data sent by the
+     * back end, which holds the width and height as 4-byte big-endian
+     * integers followed by 3 bytes (red, green, blue) per pixel, row by row.
+     */
+    void readImage(std::string member, const std::string& data);
+
+    /*
+     * Marks every pixel of this image as changed.
+     */
+    void markAllDirty();
+
+    /*
+     * Adds the given region to the changed rectangles, merging it with
+     * those that it overlaps or nearly touches.
+     */
+    void markDirty(int x, int y, int width, int height);
+
+    /*
+     * Sends the pending fill and the changed rectangles to the back end.
+     */
+    void sendChanges();
 };
 
 #endif
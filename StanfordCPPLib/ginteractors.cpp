@@ -60,6 +60,7 @@ void GInteractor::setSize(const GDimension & size) {
 
 void GInteractor::setSize(double width, double height) {
    pp->setSize(this, width, height);
+   boundsChanged();
 }
 
 void GInteractor::setBounds(const GRectangle & rect) {
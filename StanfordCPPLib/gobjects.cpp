@@ -23,15 +23,19 @@
 /*************************************************************************/
 
 #include <cmath>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include "gevents.h"
+#include "ginteractors.h"
 #include "gmath.h"
 #include "gobjects.h"
 #include "gtypes.h"
 #include "gwindow.h"
+#include "hashmap.h"
 #include "platform.h"
+#include "strlib.h"
 #include "vector.h"
 
 using namespace std;
@@ -42,8 +46,52 @@ const double LINE_TOLERANCE = 1.5;
 const double ARC_TOLERANCE = 2.5;
 const double DEFAULT_CORNER = 10;
 const string DEFAULT_GLABEL_FONT = "Dialog-13";
+const int MAX_CACHED_LABEL_SIZES = 10000;
+const int N_ADVANCES = '~' - ' ' + 1;
+
+/*
+ * Implementation notes: label metrics cache
+ * -----------------------------------------
+ * The size of a label depends only on its font and text, and its ascent
+ * and descent only on its font, so the answers from the back end are
+ * shared by every label.  labelSizes is keyed by the font and text
+ * joined by a NUL character, which cannot occur in a font name.  The
+ * table is emptied when it reaches MAX_CACHED_LABEL_SIZES entries so
+ * that a program displaying an endless series of different strings
+ * does not grow it without bound.
+ */
+
+struct FontMetrics {
+   double ascent;
+   double descent;
+   double height;
+   bool local;                    /* True if advances has been filled */
+   double advances[N_ADVANCES];   /* Widths of the characters ' '..'~' */
+};
+
+static HashMap<string,GDimension> labelSizes;
+static HashMap<string,FontMetrics> fontMetrics;
+
+/*
+ * Implementation notes: local font metrics
+ * ----------------------------------------
+ * With local metrics enabled, the first label in a font fetches the
+ * font's ascent, descent, line height, and the advance widths of the
+ * printable ASCII characters with a single GLabel.getFontMetrics query,
+ * unless loadFontMetrics has already supplied them.  The width of a
+ * string is then the sum of its advances rounded to the nearest integer,
+ * and its height is the line height, which is how the back end measures
+ * labels in fonts without fractional metrics.  Strings containing any
+ * other character are still measured by the back end.
+ */
+
+static bool localFontMetrics = false;
 
 static double dsq(double x0, double y0, double x1, double y1);
+static string labelSizeKey(const string & font, const string & str);
+static FontMetrics parseFontMetrics(const string & font, const string & line);
+static bool measureLocally(const string & font, const string & str,
+                           double & width, double & height);
 
 double GObject::getX() const {
    return x;
@@ -65,6 +113,7 @@ void GObject::setLocation(double x, double y) {
    this->x = x;
    this->y = y;
    pp->setLocation(this, x, y);
+   boundsChanged();
 }
 
 void GObject::move(double dx, double dy) {
@@ -115,6 +164,7 @@ void GObject::scale(double sx, double sy) {
    transformed = true;
    matrix.applyScale(sx, sy);
    pp->scale(this, sx, sy);
+   boundsChanged();
 }
 
 void GObject::rotate(double theta) {
@@ -122,6 +172,7 @@ void GObject::rotate(double theta) {
    transformed = true;
    matrix.applyRotate(theta);
    pp->rotate(this, theta);
+   boundsChanged();
 }
 
 void GObject::setVisible(bool flag) {
@@ -173,12 +224,18 @@ GObject::GObject() {
    lineWidth = 1.0;
    transformed = false;
    visible = true;
+   parent = NULL;
 }
 
 GObject::~GObject() {
+   if (parent != NULL) parent->detach(this);
    pp->deleteGObject(this);
 }
 
+void GObject::boundsChanged() {
+   if (parent != NULL) parent->childChanged(this);
+}
+
 /*
  * Implementation notes: GRect class
  * ---------------------------------
@@ -207,6 +264,7 @@ void GRect::setSize(double width, double height) {
    this->width = width;
    this->height = height;
    pp->setSize(this, width, height);
+   boundsChanged();
 }
 
 void GRect::setBounds(const GRectangle & bounds) {
@@ -456,6 +514,7 @@ void GOval::setSize(double width, double height) {
    this->width = width;
    this->height = height;
    pp->setSize(this, width, height);
+   boundsChanged();
 }
 
 void GOval::setBounds(const GRectangle & bounds) {
@@ -562,6 +621,7 @@ GArc::GArc(double x, double y, double width, double height,
 void GArc::setStartAngle(double start) {
    this->start = start;
    pp->setStartAngle(this, start);
+   boundsChanged();
 }
 
 double GArc::getStartAngle() const {
@@ -571,6 +631,7 @@ double GArc::getStartAngle() const {
 void GArc::setSweepAngle(double sweep) {
    this->sweep = sweep;
    pp->setSweepAngle(this, sweep);
+   boundsChanged();
 }
 
 double GArc::getSweepAngle() const {
@@ -596,6 +657,7 @@ void GArc::setFrameRectangle(double x, double y, double width, double height) {
    frameWidth = width;
    frameHeight = height;
    pp->setFrameRectangle(this, x, y, width, height);
+   boundsChanged();
 }
 
 GRectangle GArc::getFrameRectangle() const {
@@ -605,6 +667,7 @@ GRectangle GArc::getFrameRectangle() const {
 void GArc::setFilled(bool flag) {
    fillFlag = true;
    pp->setFilled(this, flag);
+   boundsChanged();
 }
 
 bool GArc::isFilled() const {
@@ -729,14 +792,427 @@ void GArc::create(double width, double height, double start, double sweep) {
    pp->createGArc(this, width, height, start, sweep);
 }
 
+/*
+ * Implementation notes: GCompound stacking order
+ * ----------------------------------------------
+ * Each GCompound keeps an Index that records the children and their
+ * order from back to front.  The children occupy increasing positions
+ * in the slots array, which may leave NULL gaps between them, and a
+ * Fenwick tree over the slots counts the occupied ones.  Each child's
+ * entry in a HashMap holds its slot, so the index of a child is a
+ * prefix count and the child at an index is found by descending the
+ * tree, both in O(log n) time.  Removing a child empties its slot, and
+ * sendToFront and sendToBack move a child into the free slot past the
+ * front or back end; sendForward and sendBackward exchange a child
+ * with its neighbor.  When no free slot remains at an end, or when the
+ * gaps outnumber the children, the slots are rebuilt with room for as
+ * many children again at each end, which keeps the cost of each
+ * operation O(log n) when amortized over a series of them.
+ *
+ * Implementation notes: GCompound bounds and spatial index
+ * --------------------------------------------------------
+ * The Index also records the bounds of every child,
+ * in the coordinates of the compound, as of the last time they were
+ * needed.  Methods that move or resize an object call boundsChanged,
+ * which only marks the child as changed in its parent and passes the
+ * news up to the parent's own parent; the bounds of the changed
+ * children are read again the next time the compound is queried.  The
+ * union of the children's bounds is cached as well.  Adding or moving a
+ * child can only extend it, and removing or moving a child invalidates
+ * it only if the child touched its edge, so getBounds rarely has to
+ * visit every child.
+ *
+ * Once a compound holds INDEX_THRESHOLD children, the index also files
+ * each child under the cells of a uniform grid that its bounds overlap,
+ * and contains and getElementAt test only the children filed under the
+ * cell holding the point.  The cells are hashed into a HashMap, and a
+ * collision merely adds candidates, since every candidate is checked
+ * against its bounds.  The bounds are widened by INDEX_TOLERANCE, which
+ * covers the tolerance that GLine and GArc allow around thin shapes.
+ * Children that span more than MAX_INDEX_CELLS cells, along with
+ * transformed interactors and compounds, whose contains methods may
+ * accept points outside the bounds computed here, are kept in a
+ * separate list that is searched on every query.
+ */
+
+const int INDEX_THRESHOLD = 64;
+const int MAX_INDEX_CELLS = 64;
+const double INDEX_TOLERANCE = ARC_TOLERANCE;
+
+struct GCompound::Index {
+
+   struct Entry {
+      int slot;                    /* Position in the slots array       */
+      GRectangle box;              /* Bounds when the child was indexed */
+      bool indexed;                /* True if box has been computed     */
+      bool changed;                /* True if box may be out of date    */
+   };
+
+   HashMap<GObject *,Entry> entries;
+   Vector<GObject *> slots;        /* Children from back to front       */
+   Vector<int> tree;               /* Fenwick tree of filled slots      */
+   int low, high;                  /* Filled slots lie in [low, high)   */
+   Vector<GObject *> changed;      /* Children to index again           */
+   bool boundsValid;               /* True if x1, y1, x2, y2 are valid  */
+   double x1, y1, x2, y2;          /* Union of the boxes                */
+   bool gridBuilt;                 /* True if the grid is in use        */
+   double cellSize;                /* Width and height of a grid cell   */
+   int builtSize;                  /* Number of children at build time  */
+   HashMap<int,Vector<GObject *> > cells;
+   Vector<GObject *> unbounded;    /* Children outside the grid         */
+
+   Index() {
+      low = high = 0;
+      boundsValid = true;
+      x1 = y1 = 1E20;
+      x2 = y2 = -1E20;
+      gridBuilt = false;
+      cellSize = 0;
+      builtSize = 0;
+   }
+
+   int size() const {
+      return entries.size();
+   }
+
+   void add(GObject *gobj) {
+      Entry entry;
+      entry.indexed = false;
+      entry.changed = true;
+      entries.put(gobj, entry);
+      changed.add(gobj);
+      placeAtFront(gobj);
+   }
+
+   void remove(GObject *gobj) {
+      Entry & entry = entries[gobj];
+      if (entry.indexed) {
+         if (gridBuilt) unfile(gobj, entry.box);
+         if (touchesEdge(entry.box)) boundsValid = false;
+      }
+      vacate(entry.slot);
+      entries.remove(gobj);
+      if (high - low > 2 * size() + 32) rebuildSlots();
+   }
+
+   /*
+    * Returns the index of gobj from the back, which must be a child.
+    */
+   int indexOf(GObject *gobj) const {
+      return countBefore(entries.get(gobj).slot);
+   }
+
+   GObject *childAt(int k) const {
+      if (k < 0 || k >= size()) {
+         error("GCompound::getElement: Index of " + integerToString(k)
+               + " is outside of valid range of [0.."
+               + integerToString(size() - 1) + "]");
+      }
+      return slots[findSlot(k)];
+   }
+
+   void placeAtFront(GObject *gobj) {
+      if (high == slots.size()) rebuildSlots();
+      fill(high++, gobj);
+   }
+
+   void placeAtBack(GObject *gobj) {
+      if (low == 0) rebuildSlots();
+      fill(--low, gobj);
+   }
+
+   /*
+    * Exchanges the child gobj with the one k places in front of it,
+    * where k is 1 or -1, and returns false if there is none.
+    */
+   bool swapWithNeighbor(GObject *gobj, int k) {
+      int slot = entries[gobj].slot;
+      int other = countBefore(slot) + k;
+      if (other < 0 || other >= size()) return false;
+      int otherSlot = findSlot(other);
+      slots[slot] = slots[otherSlot];
+      slots[otherSlot] = gobj;
+      entries[slots[slot]].slot = slot;
+      entries[gobj].slot = otherSlot;
+      return true;
+   }
+
+   void fill(int slot, GObject *gobj) {
+      slots[slot] = gobj;
+      entries[gobj].slot = slot;
+      for (int i = slot + 1; i < tree.size(); i += i & -i) {
+         tree[i]++;
+      }
+   }
+
+   void vacate(int slot) {
+      slots[slot] = NULL;
+      for (int i = slot + 1; i < tree.size(); i += i & -i) {
+         tree[i]--;
+      }
+      while (high > low && slots[high - 1] == NULL) {
+         high--;
+      }
+      while (low < high && slots[low] == NULL) {
+         low++;
+      }
+   }
+
+   /*
+    * Returns the number of filled slots before the given one.
+    */
+   int countBefore(int slot) const {
+      int n = 0;
+      for (int i = slot; i > 0; i -= i & -i) {
+         n += tree[i];
+      }
+      return n;
+   }
+
+   /*
+    * Returns the slot holding the child with k children behind it.
+    */
+   int findSlot(int k) const {
+      int slot = 0;
+      int step = 1;
+      while (2 * step < tree.size()) {
+         step *= 2;
+      }
+      for (; step > 0; step /= 2) {
+         if (slot + step < tree.size() && tree[slot + step] <= k) {
+            slot += step;
+            k -= tree[slot];
+         }
+      }
+      return slot;
+   }
+
+   void rebuildSlots() {
+      Vector<GObject *> order;
+      for (int i = low; i < high; i++) {
+         if (slots[i] != NULL) order.add(slots[i]);
+      }
+      int n = order.size();
+      int room = n + 16;
+      slots = Vector<GObject *>(n + 2 * room, NULL);
+      tree = Vector<int>(slots.size() + 1, 0);
+      low = room;
+      high = room + n;
+      for (int i = 0; i < n; i++) {
+         slots[low + i] = order[i];
+         entries[order[i]].slot = low + i;
+         tree[low + i + 1] = 1;
+      }
+      for (int i = 1; i < tree.size(); i++) {
+         int parent = i + (i & -i);
+         if (parent < tree.size()) tree[parent] += tree[i];
+      }
+   }
+
+   /*
+    * Marks gobj as changed and returns true, or returns false if it was
+    * already marked, in which case its ancestors have been told too.
+    */
+   bool markChanged(GObject *gobj) {
+      if (!entries.containsKey(gobj)) return false;
+      Entry & entry = entries[gobj];
+      if (entry.changed) return false;
+      entry.changed = true;
+      changed.add(gobj);
+      return true;
+   }
+
+   void update() {
+      int nChildren = size();
+      for (int i = 0; i < changed.size(); i++) {
+         GObject *gobj = changed[i];
+         if (!entries.containsKey(gobj)) continue;
+         Entry & entry = entries[gobj];
+         if (!entry.changed) continue;
+         if (entry.indexed) {
+            if (gridBuilt) unfile(gobj, entry.box);
+            if (touchesEdge(entry.box)) boundsValid = false;
+         }
+         entry.box = gobj->getBounds();
+         entry.indexed = true;
+         entry.changed = false;
+         if (boundsValid) extend(entry.box);
+         if (gridBuilt) file(gobj, entry.box);
+      }
+      changed.clear();
+      if (!boundsValid) {
+         x1 = y1 = 1E20;
+         x2 = y2 = -1E20;
+         for (GObject *gobj : entries) {
+            extend(entries[gobj].box);
+         }
+         boundsValid = true;
+      }
+      if (nChildren < INDEX_THRESHOLD / 2) {
+         if (gridBuilt) clearGrid();
+      } else if (nChildren >= INDEX_THRESHOLD
+                 && (!gridBuilt || nChildren > 4 * builtSize
+                                || 4 * nChildren < builtSize)) {
+         buildGrid();
+      }
+   }
+
+   void extend(const GRectangle & box) {
+      double left = box.getX();
+      double top = box.getY();
+      double right = left + box.getWidth();
+      double bottom = top + box.getHeight();
+      x1 = min(x1, min(left, right));
+      y1 = min(y1, min(top, bottom));
+      x2 = max(x2, max(left, right));
+      y2 = max(y2, max(top, bottom));
+   }
+
+   bool touchesEdge(const GRectangle & box) const {
+      double left = box.getX();
+      double top = box.getY();
+      double right = left + box.getWidth();
+      double bottom = top + box.getHeight();
+      return min(left, right) <= x1 || min(top, bottom) <= y1
+          || max(left, right) >= x2 || max(top, bottom) >= y2;
+   }
+
+   void clearGrid() {
+      cells.clear();
+      unbounded.clear();
+      gridBuilt = false;
+   }
+
+   void buildGrid() {
+      clearGrid();
+      double total = 0;
+      for (GObject *gobj : entries) {
+         const GRectangle & box = entries[gobj].box;
+         double size = max(abs(box.getWidth()), abs(box.getHeight()));
+         if (size < 1E6) total += size;
+      }
+      cellSize = max(1.0, 2 * total / entries.size() + 2 * INDEX_TOLERANCE);
+      builtSize = entries.size();
+      gridBuilt = true;
+      for (GObject *gobj : entries) {
+         file(gobj, entries[gobj].box);
+      }
+   }
+
+   static bool isUnbounded(GObject *gobj) {
+      if (!gobj->transformed) return false;
+      return dynamic_cast<GInteractor *>(gobj) != NULL
+          || dynamic_cast<GCompound *>(gobj) != NULL;
+   }
+
+   static int cellKey(int col, int row) {
+      return int(unsigned(col) * 73856093u ^ unsigned(row) * 19349663u);
+   }
+
+   /*
+    * Computes the range of cells that the widened box overlaps and
+    * returns false if the child belongs in the unbounded list instead.
+    */
+   bool cellRange(GObject *gobj, const GRectangle & box,
+                  int & c1, int & r1, int & c2, int & r2) const {
+      if (isUnbounded(gobj)) return false;
+      double left = min(box.getX(), box.getX() + box.getWidth());
+      double top = min(box.getY(), box.getY() + box.getHeight());
+      double cols = floor((left + abs(box.getWidth()) + INDEX_TOLERANCE) / cellSize)
+                  - floor((left - INDEX_TOLERANCE) / cellSize) + 1;
+      double rows = floor((top + abs(box.getHeight()) + INDEX_TOLERANCE) / cellSize)
+                  - floor((top - INDEX_TOLERANCE) / cellSize) + 1;
+      if (!(cols * rows <= MAX_INDEX_CELLS)) return false;
+      c1 = (int) floor((left - INDEX_TOLERANCE) / cellSize);
+      r1 = (int) floor((top - INDEX_TOLERANCE) / cellSize);
+      c2 = c1 + (int) cols - 1;
+      r2 = r1 + (int) rows - 1;
+      return true;
+   }
+
+   void file(GObject *gobj, const GRectangle & box) {
+      int c1, r1, c2, r2;
+      if (!cellRange(gobj, box, c1, r1, c2, r2)) {
+         unbounded.add(gobj);
+         return;
+      }
+      for (int row = r1; row <= r2; row++) {
+         for (int col = c1; col <= c2; col++) {
+            cells[cellKey(col, row)].add(gobj);
+         }
+      }
+   }
+
+   void unfile(GObject *gobj, const GRectangle & box) {
+      int c1, r1, c2, r2;
+      if (!cellRange(gobj, box, c1, r1, c2, r2)) {
+         removeFrom(unbounded, gobj);
+         return;
+      }
+      for (int row = r1; row <= r2; row++) {
+         for (int col = c1; col <= c2; col++) {
+            int key = cellKey(col, row);
+            removeFrom(cells[key], gobj);
+            if (cells[key].isEmpty()) cells.remove(key);
+         }
+      }
+   }
+
+   static void removeFrom(Vector<GObject *> & list, GObject *gobj) {
+      for (int i = list.size() - 1; i >= 0; i--) {
+         if (list[i] == gobj) {
+            list[i] = list[list.size() - 1];
+            list.remove(list.size() - 1);
+            return;
+         }
+      }
+   }
+
+   /*
+    * Adds to candidates the children whose widened boxes contain the
+    * point, along with the unbounded ones.  Requires the grid.
+    */
+   void findCandidates(double x, double y, Vector<GObject *> & candidates) {
+      int key = cellKey((int) floor(x / cellSize), (int) floor(y / cellSize));
+      if (cells.containsKey(key)) {
+         const Vector<GObject *> & cell = cells[key];
+         for (int i = 0; i < cell.size(); i++) {
+            const GRectangle & box = entries[cell[i]].box;
+            double left = min(box.getX(), box.getX() + box.getWidth());
+            double top = min(box.getY(), box.getY() + box.getHeight());
+            if (x >= left - INDEX_TOLERANCE
+                  && x <= left + abs(box.getWidth()) + INDEX_TOLERANCE
+                  && y >= top - INDEX_TOLERANCE
+                  && y <= top + abs(box.getHeight()) + INDEX_TOLERANCE) {
+               candidates.add(cell[i]);
+            }
+         }
+      }
+      for (int i = 0; i < unbounded.size(); i++) {
+         candidates.add(unbounded[i]);
+      }
+   }
+
+};
+
 GCompound::GCompound() {
+   index = new Index();
    pp->createGCompound(this);
 }
 
+GCompound::~GCompound() {
+   for (int i = 0; i < index->size(); i++) {
+      index->childAt(i)->parent = NULL;
+   }
+   delete index;
+}
+
 void GCompound::add(GObject *gobj) {
+   if (gobj->parent != NULL) gobj->parent->detach(gobj);
    pp->add(this, gobj);
-   contents.add(gobj);
+   index->add(gobj);
    gobj->parent = this;
+   boundsChanged();
 }
 
 void GCompound::add(GObject *gobj, double x, double y) {
@@ -745,42 +1221,72 @@ void GCompound::add(GObject *gobj, double x, double y) {
 }
 
 void GCompound::remove(GObject *gobj) {
-   int index = findGObject(gobj);
-   if (index != -1) removeAt(index);
+   if (!index->entries.containsKey(gobj)) return;
+   index->remove(gobj);
+   pp->remove(gobj);
+   gobj->parent = NULL;
+   boundsChanged();
 }
 
 void GCompound::removeAll() {
-   while (!contents.isEmpty()) {
-      removeAt(0);
+   while (index->size() > 0) {
+      remove(index->childAt(0));
    }
 }
 
 int GCompound::getElementCount() {
-   return contents.size();
+   return index->size();
 }
 
 GObject *GCompound::getElement(int index) {
-   return contents.get(index);
+   return this->index->childAt(index);
+}
+
+GObject *GCompound::getElementAt(double x, double y) {
+   index->update();
+   if (!index->gridBuilt) {
+      for (int i = index->high - 1; i >= index->low; i--) {
+         GObject *gobj = index->slots[i];
+         if (gobj != NULL && gobj->contains(x, y)) return gobj;
+      }
+      return NULL;
+   }
+   Vector<GObject *> candidates;
+   index->findCandidates(x, y, candidates);
+   GObject *result = NULL;
+   int resultSlot = -1;
+   for (int i = 0; i < candidates.size(); i++) {
+      GObject *gobj = candidates[i];
+      int slot = index->entries[gobj].slot;
+      if (slot > resultSlot && gobj->contains(x, y)) {
+         result = gobj;
+         resultSlot = slot;
+      }
+   }
+   return result;
 }
 
 // JL rewrote to handle transformed case
 GRectangle GCompound::getBounds() const {
+   index->update();
+   if (!transformed) {
+      return GRectangle(x + index->x1, y + index->y1,
+                        index->x2 - index->x1, index->y2 - index->y1);
+   }
    double x1, y1, x2, y2;
    x1 = 1E20;
    x2 = -1E20;
    y1 = 1E20;
    y2 = -1E20;
-   for (int i = 0; i < contents.size(); i++) {
-      GRectangle bounds = contents.get(i)->getBounds();
+   for (GObject *gobj : index->entries) {
+      GRectangle bounds = index->entries[gobj].box;
       GPoint vertices[4];
       vertices[0] = GPoint(bounds.getX(), bounds.getY());
       vertices[1] = GPoint(bounds.getX() + bounds.getWidth(), bounds.getY());
       vertices[2] = GPoint(bounds.getX(), bounds.getY() + bounds.getHeight());
       vertices[3] = GPoint(bounds.getX()+ bounds.getWidth(), bounds.getY() + bounds.getHeight());
-      if (transformed) {
-          for (int j = 0; j < 4; j++)
-             vertices[j] = matrix.image(vertices[j]);
-      }
+      for (int j = 0; j < 4; j++)
+         vertices[j] = matrix.image(vertices[j]);
       for (int j = 0; j < 4; j++) {
           double x = vertices[j].getX();
           double y = vertices[j].getY();
@@ -802,8 +1308,18 @@ bool GCompound::contains(double x, double y) const {
        x = pt.getX();
        y = pt.getY();
    }
-   for (int i = 0; i < contents.size(); i++) {
-       if (contents.get(i)->contains(x, y)) return true;
+   index->update();
+   if (index->gridBuilt) {
+      Vector<GObject *> candidates;
+      index->findCandidates(x, y, candidates);
+      for (int i = 0; i < candidates.size(); i++) {
+         if (candidates[i]->contains(x, y)) return true;
+      }
+      return false;
+   }
+   for (int i = index->low; i < index->high; i++) {
+       GObject *gobj = index->slots[i];
+       if (gobj != NULL && gobj->contains(x, y)) return true;
    }
    return false;
 }
@@ -817,58 +1333,61 @@ string GCompound::toString() const {
 }
 
 void GCompound::sendForward(GObject *gobj) {
-   int index = findGObject(gobj);
-   if (index == -1) return;
-   if (index != contents.size() - 1) {
-      contents.remove(index);
-      contents.insert(index + 1, gobj);
+   if (findGObject(gobj) == -1) return;
+   if (index->swapWithNeighbor(gobj, 1)) {
       pp->sendForward(gobj);
    }
 }
 
 void GCompound::sendToFront(GObject *gobj) {
-   int index = findGObject(gobj);
-   if (index == -1) return;
-   if (index != contents.size() - 1) {
-      contents.remove(index);
-      contents.add(gobj);
+   int k = findGObject(gobj);
+   if (k == -1) return;
+   if (k != index->size() - 1) {
+      index->vacate(index->entries[gobj].slot);
+      index->placeAtFront(gobj);
       pp->sendToFront(gobj);
    }
 }
 
 void GCompound::sendBackward(GObject *gobj) {
-   int index = findGObject(gobj);
-   if (index == -1) return;
-   if (index != 0) {
-      contents.remove(index);
-      contents.insert(index - 1, gobj);
+   if (findGObject(gobj) == -1) return;
+   if (index->swapWithNeighbor(gobj, -1)) {
       pp->sendBackward(gobj);
    }
 }
 
 void GCompound::sendToBack(GObject *gobj) {
-   int index = findGObject(gobj);
-   if (index == -1) return;
-   if (index != 0) {
-      contents.remove(index);
-      contents.insert(0, gobj);
+   int k = findGObject(gobj);
+   if (k == -1) return;
+   if (k != 0) {
+      index->vacate(index->entries[gobj].slot);
+      index->placeAtBack(gobj);
       pp->sendToBack(gobj);
    }
 }
 
 int GCompound::findGObject(GObject *gobj) {
-   int n = contents.size();
-   for (int i = 0; i < n; i++) {
-      if (contents.get(i) == gobj) return i;
-   }
-   return -1;
+   if (!index->entries.containsKey(gobj)) return -1;
+   return index->indexOf(gobj);
 }
 
-void GCompound::removeAt(int index) {
-   GObject *gobj = contents[index];
-   contents.remove(index);
-   pp->remove(gobj);
+/*
+ * Implementation notes: detach
+ * ----------------------------
+ * Removes gobj from this compound without telling the back end, which
+ * takes an object out of its old parent by itself when the object is
+ * added somewhere else or deleted.
+ */
+
+void GCompound::detach(GObject *gobj) {
+   if (!index->entries.containsKey(gobj)) return;
+   index->remove(gobj);
    gobj->parent = NULL;
+   boundsChanged();
+}
+
+void GCompound::childChanged(GObject *gobj) {
+   if (index->markChanged(gobj)) boundsChanged();
 }
 
 GImage::GImage(string filenameOrURL) {
@@ -944,21 +1463,39 @@ void GLabel::create(const string & str) {
    this->str = str;
    pp->createGLabel(this, str);
    setFont(DEFAULT_GLABEL_FONT);
-   GDimension size = pp->getGLabelSize(this);
-   width = size.getWidth();
-   height = size.getHeight();
-   ascent = pp->getFontAscent(this);
-   descent = pp->getFontDescent(this);
 }
 
+/*
+ * Implementation notes: setFont
+ * -----------------------------
+ * The metrics of a font that has not been seen before are requested
+ * together with the size of the label, so that all three queries cost
+ * one round trip to the back end rather than three.
+ */
+
 void GLabel::setFont(string font) {
    this->font = font;
    pp->setFont(this, font);
-   GDimension size = pp->getGLabelSize(this);
-   width = size.getWidth();
-   height = size.getHeight();
-   ascent = pp->getFontAscent(this);
-   descent = pp->getFontDescent(this);
+   if (localFontMetrics
+         && !(fontMetrics.containsKey(font) && fontMetrics[font].local)) {
+      fontMetrics.put(font, parseFontMetrics(font, pp->getFontMetrics(font)));
+   } else if (!fontMetrics.containsKey(font)) {
+      PendingResult<GDimension> size = pp->getGLabelSizeAsync(this);
+      PendingResult<double> fontAscent = pp->getFontAscentAsync(this);
+      PendingResult<double> fontDescent = pp->getFontDescentAsync(this);
+      cacheSize(size.get());
+      FontMetrics metrics;
+      metrics.ascent = fontAscent.get();
+      metrics.descent = fontDescent.get();
+      metrics.height = 0;
+      metrics.local = false;
+      fontMetrics.put(font, metrics);
+   }
+   const FontMetrics & metrics = fontMetrics[font];
+   ascent = metrics.ascent;
+   descent = metrics.descent;
+   updateSize();
+   boundsChanged();
 }
 
 string GLabel::getFont() const {
@@ -968,11 +1505,46 @@ string GLabel::getFont() const {
 void GLabel::setLabel(string str) {
    this->str = str;
    pp->setLabel(this, str);
-   GDimension size = pp->getGLabelSize(this);
+   updateSize();
+   boundsChanged();
+}
+
+void GLabel::setLocalFontMetrics(bool flag) {
+   localFontMetrics = flag;
+}
+
+void GLabel::loadFontMetrics(string filename) {
+   ifstream infile(filename.c_str());
+   if (infile.fail()) {
+      error("GLabel::loadFontMetrics: Can't open " + filename);
+   }
+   string line;
+   while (getline(infile, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      size_t space = line.find(' ');
+      string font = line.substr(0, space);
+      string values = (space == string::npos) ? "" : line.substr(space + 1);
+      fontMetrics.put(font, parseFontMetrics(font, values));
+   }
+   localFontMetrics = true;
+}
+
+void GLabel::updateSize() {
+   if (localFontMetrics && measureLocally(font, str, width, height)) return;
+   string key = labelSizeKey(font, str);
+   if (!labelSizes.containsKey(key)) {
+      cacheSize(pp->getGLabelSize(this));
+   }
+   const GDimension & size = labelSizes[key];
    width = size.getWidth();
    height = size.getHeight();
 }
 
+void GLabel::cacheSize(const GDimension & size) {
+   if (labelSizes.size() >= MAX_CACHED_LABEL_SIZES) labelSizes.clear();
+   labelSizes.put(labelSizeKey(font, str), size);
+}
+
 string GLabel::getLabel() const {
    return str;
 }
@@ -1045,6 +1617,7 @@ void GLine::setStartPoint(double x, double y) {
    this->x = x;
    this->y = y;
    pp->setStartPoint(this, x, y);
+   boundsChanged();
 }
 
 GPoint GLine::getStartPoint() const {
@@ -1055,6 +1628,7 @@ void GLine::setEndPoint(double x, double y) {
    dx = x - this->x;
    dy = y - this->y;
    pp->setEndPoint(this, x, y);
+   boundsChanged();
 }
 
 GPoint GLine::getEndPoint() const {
@@ -1121,11 +1695,35 @@ GPolygon::GPolygon() {
    pp->createGPolygon(this);
 }
 
+GPolygon::GPolygon(const Vector<GPoint> & vertices) {
+   fillFlag = false;
+   fillColor = "";
+   pp->createGPolygon(this);
+   addVertices(vertices);
+}
+
 void GPolygon::addVertex(double x, double y) {
    cx = x;
    cy = y;
    vertices.add(GPoint(cx, cy));
    pp->addVertex(this, cx, cy);
+   boundsChanged();
+}
+
+void GPolygon::addVertices(const Vector<GPoint> & points) {
+   if (points.isEmpty()) return;
+   if (&points == &vertices) {
+      Vector<GPoint> copy = points;
+      addVertices(copy);
+      return;
+   }
+   for (int i = 0; i < points.size(); i++) {
+      vertices.add(points[i]);
+   }
+   cx = points[points.size() - 1].getX();
+   cy = points[points.size() - 1].getY();
+   pp->addVertices(this, points);
+   boundsChanged();
 }
 
 void GPolygon::addEdge(double dx, double dy) {
@@ -1136,7 +1734,7 @@ void GPolygon::addPolarEdge(double r, double theta) {
    addEdge(r * cos(theta * PI / 180), -r * sin(theta * PI / 180));
 }
 
-Vector<GPoint> GPolygon::getVertices() const {
+const Vector<GPoint> & GPolygon::getVertices() const {
    return vertices;
 }
 
@@ -1273,6 +1871,61 @@ GPoint GObject::Matrix2D::preimage(double x, double y) const {
     return GPoint(xx, yy);
 }
 
+static string labelSizeKey(const string & font, const string & str) {
+   string key = font;
+   key += '\0';
+   key += str;
+   return key;
+}
+
+/*
+ * Function: parseFontMetrics
+ * Usage: FontMetrics metrics = parseFontMetrics(font, line);
+ * ----------------------------------------------------------
+ * Reads the ascent, descent, height, and N_ADVANCES advance widths from
+ * a line in the format of the GLabel.getFontMetrics result, which is
+ * also the format of a metrics file after the font name.
+ */
+
+static FontMetrics parseFontMetrics(const string & font, const string & line) {
+   istringstream stream(line);
+   FontMetrics metrics;
+   stream >> metrics.ascent >> metrics.descent >> metrics.height;
+   for (int i = 0; i < N_ADVANCES; i++) {
+      stream >> metrics.advances[i];
+   }
+   if (stream.fail()) {
+      error("GLabel: Illegal font metrics for " + font);
+   }
+   metrics.local = true;
+   return metrics;
+}
+
+/*
+ * Function: measureLocally
+ * Usage: if (measureLocally(font, str, width, height)) ...
+ * --------------------------------------------------------
+ * Computes the size of str in the specified font from the local metrics
+ * and returns true, or returns false if the metrics are not available
+ * or str contains a character outside the range they cover.
+ */
+
+static bool measureLocally(const string & font, const string & str,
+                           double & width, double & height) {
+   if (!fontMetrics.containsKey(font)) return false;
+   const FontMetrics & metrics = fontMetrics[font];
+   if (!metrics.local) return false;
+   double total = 0;
+   for (size_t i = 0; i < str.length(); i++) {
+      char ch = str[i];
+      if (ch < ' ' || ch > '~') return false;
+      total += metrics.advances[ch - ' '];
+   }
+   width = floor(total + 0.5);
+   height = metrics.height;
+   return true;
+}
+
 static double dsq(double x0, double y0, double x1, double y1) {
    return (x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0);
 }
@@ -463,6 +463,13 @@ protected:
 protected:
    GObject();
 
+   /*
+    * Tells the parent compound, if any, that the bounds of this object
+    * may have changed.  Every method that moves or resizes an object
+    * calls it, so that the parent's cached bounds stay up to date.
+    */
+   void boundsChanged();
+
    friend class GArc;
    friend class GButton;
    friend class GCheckBox;
@@ -1166,6 +1173,16 @@ private:
  * Once assembled, the internal objects can be manipulated as a unit.
  * A `%GCompound` keeps track of its own position, and all objects
  * within it are drawn relative to that location.
+ *
+ * A compound remembers the bounds of its objects and updates them only
+ * when an object is added, removed, moved, or resized, so
+ * \ref getBounds does not visit every object.  Once a compound holds
+ * many objects, it also files them by location in a grid, so that
+ * \ref contains and \ref getElementAt examine only the objects near
+ * the given point.  Scenes with many thousands of objects can therefore
+ * follow the mouse without delay.  Removing an object and changing its
+ * place in the stacking order take O(log n) time, as does
+ * \ref getElement.
  */
 class GCompound : public GObject {
 
@@ -1179,6 +1196,7 @@ public:
  *     GCompound *comp = new GCompound();
  */
    GCompound();
+   virtual ~GCompound();
 
 
 /** \_overload */
@@ -1186,6 +1204,8 @@ public:
 /**
  * Adds a new graphical object to this compound.  The second
  * form moves the object to the point (\em x, \em y) first.
+ * An object that already belongs to a compound is removed from it
+ * first, so that it appears in front of the others.
  *
  * Sample usages:
  *
@@ -1238,6 +1258,19 @@ public:
    GObject *getElement(int index);
 
 
+/**
+ * Returns a pointer to the topmost graphical object in this compound
+ * that contains the point (\em x, \em y), where the point is expressed
+ * in the same coordinates as the objects' locations.  Returns
+ * <code>NULL</code> if no object contains the point.
+ *
+ * Sample usage:
+ *
+ *     GObject *gobj = comp->getElementAt(x, y);
+ */
+   GObject *getElementAt(double x, double y);
+
+
 /* Prototypes for the virtual methods */
 
    virtual GRectangle getBounds() const;
@@ -1246,16 +1279,19 @@ public:
    virtual std::string toString() const;
 
 private:
+   struct Index;
+
    void sendForward(GObject *gobj);
    void sendToFront(GObject *gobj);
    void sendBackward(GObject *gobj);
    void sendToBack(GObject *gobj);
    int findGObject(GObject *gobj);
-   void removeAt(int index);
+   void detach(GObject *gobj);
+   void childChanged(GObject *gobj);
 
 /* Instance variables */
 
-   Vector<GObject *> contents;
+   Index *index;                   /* Order and bounds of the contents   */
 
 /* Friend declarations */
 
@@ -1468,6 +1504,38 @@ public:
    double getFontDescent() const;
 
 
+/**
+ * Enables or disables the measurement of labels in C++.  When local
+ * font metrics are enabled, the first label in each font fetches the
+ * character widths of that font from the back end, and the sizes of
+ * later labels in the same font are computed without contacting the
+ * back end at all.  Labels containing characters other than printable
+ * ASCII are still measured by the back end.  Local metrics are disabled
+ * by default.
+ *
+ * Sample usage:
+ *
+ *     GLabel::setLocalFontMetrics(true);
+ */
+   static void setLocalFontMetrics(bool flag);
+
+
+/**
+ * Reads font metrics from the specified file and enables local font
+ * metrics, so that labels in the fonts it describes are measured
+ * without contacting the back end even once.  Each line of the file
+ * consists of a font name followed by the values that the back end
+ * reports for that font: the ascent, descent, and line height, and
+ * then the widths of the 95 characters from space through tilde.
+ * Blank lines and lines beginning with <code>#</code> are ignored.
+ *
+ * Sample usage:
+ *
+ *     GLabel::loadFontMetrics("fonts.txt");
+ */
+   static void loadFontMetrics(std::string filename);
+
+
 /* Prototypes for the virtual methods */
    virtual bool contains(double x, double y) const;
    virtual GRectangle getBounds() const;
@@ -1486,6 +1554,8 @@ private:
    double descent;                 /* Font descent                      */
 
    void create(const std::string & str);
+   void updateSize();
+   void cacheSize(const GDimension & size);
 
 };
 
@@ -1601,6 +1671,9 @@ protected:
  * You then need to add a sequence of vertices to the polygon using
  * one or more of the methods \ref addVertex, \ref addEdge,
  * and \ref addPolarEdge (the initial vertex must be added with \ref addVertex).
+ * A polygon with many vertices is best built from a list of points, either
+ * by passing it to the constructor or to \ref addVertices, which sends the
+ * whole list to the graphics back end at once.
  *
  * As an example, the following code adds a filled red octagon to the center
  * of the window:
@@ -1641,6 +1714,17 @@ public:
    GPolygon();
 
 
+/**
+ * Constructs a new polygon based at the origin whose vertices are the
+ * points in \em vertices, given relative to that origin.
+ *
+ * Sample usage:
+ *
+ *     GPolygon *poly = new GPolygon(vertices);
+ */
+   GPolygon(const Vector<GPoint> & vertices);
+
+
 /**
  * Adds a vertex at (\em x, \em y) relative to this polygon's
  * origin.
@@ -1656,6 +1740,18 @@ public:
    void addVertex(double x, double y);
 
 
+/**
+ * Adds each point in \em points as a vertex, in order, relative to this
+ * polygon's origin.  The result is the same as calling \ref addVertex
+ * for each point, but the vertices travel to the back end together.
+ *
+ * Sample usage:
+ *
+ *     poly->addVertices(points);
+ */
+   void addVertices(const Vector<GPoint> & points);
+
+
 /**
  * Adds an edge to this polygon. The new edge begins at the most recently added vertex
  * and ends at displacement (\em dx, \em dy) relative to that vertex.
@@ -1702,7 +1798,7 @@ public:
  *
  *     Vector<GPoint> vec = poly->getVertices();
  */
-   Vector<GPoint> getVertices() const;
+   const Vector<GPoint> & getVertices() const;
 
 
 /**
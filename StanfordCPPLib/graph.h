@@ -1218,6 +1218,9 @@ std::istream& operator >>(std::istream& is, Graph<NodeType, ArcType>& g) {
 
 /*
  * Template hash function for graphs.
+ * Arcs are identified by the names of their endpoints rather than by
+ * the node addresses, and their hashes are summed because the arc set
+ * is ordered by address.
  */
 template <typename NodeType, typename ArcType>
 int hashCode(const Graph<NodeType, ArcType>& graph) {
@@ -1225,10 +1228,12 @@ int hashCode(const Graph<NodeType, ArcType>& graph) {
     for (NodeType* node : graph) {
         code = HASH_MULTIPLIER * code + hashCode(node->name);
     }
+    uint64_t arcCode = 0;
     for (ArcType* arc : graph.getArcSet()) {
-        code = HASH_MULTIPLIER * code + hashCode(arc->start);
-        code = HASH_MULTIPLIER * code + hashCode(arc->finish);
+        arcCode += hashCombine(hashCode(arc->start->name),
+                               hashCode(arc->finish->name));
     }
+    code = HASH_MULTIPLIER * code + hashFold(arcCode);
     return (code & HASH_MASK);
 }
 
@@ -27,6 +27,7 @@
 #ifndef _grid_h
 #define _grid_h
 
+#include <utility>
 #include "strlib.h"
 #include "vector.h"
 #include "hashcode.h"
@@ -328,6 +329,21 @@ public:
       deepCopy(src);
    }
 
+/*
+ * Method: swap
+ * Usage: grid.swap(other);
+ * ------------------------
+ * Exchanges the contents of this grid and other in constant time, which
+ * lets a function build a grid in a local variable and hand it to its
+ * caller without copying the elements.
+ */
+
+   void swap(Grid & other) {
+      std::swap(elements, other.elements);
+      std::swap(nRows, other.nRows);
+      std::swap(nCols, other.nCols);
+   }
+
 /*
  * Iterator support
  * ----------------
@@ -515,7 +531,7 @@ void Grid<ValueType>::resize(int nRows, int nCols, bool retain) {
        int minCols = oldnCols < nCols ? oldnCols : nCols;
        for (int row = 0; row < minRows; row++) {
            for (int col = 0; col < minCols; col++) {
-               this->elements[(row * nCols) + col] = oldElements[(row * oldnRows) + col];
+               this->elements[(row * nCols) + col] = oldElements[(row * oldnCols) + col];
            }
        }
    }
@@ -692,6 +708,8 @@ std::istream & operator>>(std::istream & is, Grid<ValueType> & grid) {
 template <typename T>
 int hashCode(const Grid<T>& g) {
     int code = HASH_SEED;
+    code = HASH_MULTIPLIER * code + g.numRows();
+    code = HASH_MULTIPLIER * code + g.numCols();
     for (T n : g) {
         code = HASH_MULTIPLIER * code + hashCode(n);
     }
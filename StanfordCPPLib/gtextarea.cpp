@@ -27,7 +27,6 @@
 #include <string>
 #include "gtextarea.h"
 #include "platform.h"
-#include "base64.h"
 
 using namespace std;
 
@@ -55,8 +54,7 @@ void GTextArea::setText(std::string text) {
 }
 
 std::string GTextArea::getText() const {
-    string encoded = pp->gtextarea_getText(this);
-    return Base64::decode(encoded);
+    return pp->gtextarea_getText(this);
 }
 
 void GTextArea::setFont(std::string font) {
@@ -26,6 +26,7 @@
 #include <cmath>
 #include "error.h"
 #include "gtypes.h"
+#include "hashcode.h"
 #include "strlib.h"
 using namespace std;
 
@@ -37,7 +38,7 @@ using namespace std;
  * ----------------------------------
  * The GPoint class itself is entirely straightforward.  The relational
  * operators compare the x components first, followed by the y component.
- * The hashCode function computes the exclusive-or of the individual words.
+ * The hashCode function combines the hash codes of the coordinates.
  */
 
 GPoint::GPoint() {
@@ -75,11 +76,7 @@ bool operator!=(const GPoint & p1, const GPoint & p2) {
 }
 
 int hashCode(const GPoint & pt) {
-   int hash = 0;
-   for (int i = 0; i < sizeof(double) / sizeof(int); i++) {
-      hash ^= ((int *) &pt.x)[i] ^ ((int *) &pt.y)[i];
-   }
-   return HASH_MASK & hash;
+   return hashFold(hashCombine(hashCode(pt.x), hashCode(pt.y)));
 }
 
 /*
@@ -87,7 +84,7 @@ int hashCode(const GPoint & pt) {
  * --------------------------------------
  * The GDimension class itself is entirely straightforward.  The
  * relational operators compare the width first, followed by the height.
- * The hashCode function computes the exclusive-or of the individual words.
+ * The hashCode function combines the hash codes of the two dimensions.
  */
 
 GDimension::GDimension() {
@@ -125,11 +122,7 @@ bool operator!=(const GDimension & d1, const GDimension & d2) {
 }
 
 int hashCode(const GDimension & dim) {
-   int hash = 0;
-   for (int i = 0; i < sizeof(double) / sizeof(int); i++) {
-      hash ^= ((int *) &dim.width)[i] ^ ((int *) &dim.height)[i];
-   }
-   return HASH_MASK & hash;
+   return hashFold(hashCombine(hashCode(dim.width), hashCode(dim.height)));
 }
 
 /*
@@ -137,8 +130,8 @@ int hashCode(const GDimension & dim) {
  * --------------------------------------
  * The GRectangle class itself is entirely straightforward.  The
  * relational operators compare the components in the following order:
- * x, y, width, height.  The hashCode function computes the exclusive-or
- * of the individual words.
+ * x, y, width, height.  The hashCode function combines the hash codes
+ * of the four components in that order.
  */
 
 GRectangle::GRectangle() {
@@ -205,10 +198,7 @@ bool operator!=(const GRectangle & r1, const GRectangle & r2) {
 }
 
 int hashCode(const GRectangle & r) {
-   int hash = 0;
-   for (int i = 0; i < sizeof(double) / sizeof(int); i++) {
-      hash ^= ((int *) &r.x)[i] ^ ((int *) &r.y)[i];
-      hash ^= ((int *) &r.width)[i] ^ ((int *) &r.height)[i];
-   }
-   return HASH_MASK & hash;
+   uint64_t hash = hashCombine(hashCode(r.x), hashCode(r.y));
+   hash = hashCombine(hash, hashCode(r.width));
+   return hashFold(hashCombine(hash, hashCode(r.height)));
 }
@@ -134,9 +134,11 @@ void GWindow::drawLine(const GPoint & p0, const GPoint & p1) {
 }
 
 void GWindow::drawLine(double x0, double y0, double x1, double y1) {
-   GLine line(x0, y0, x1, y1);
-   line.setColor(gwd->color);
-   draw(line);
+   pp->drawLine(*this, x0, y0, x1, y1, gwd->color);
+}
+
+void GWindow::drawLines(const Vector<GPoint> & points) {
+   if (points.size() > 1) pp->drawLines(*this, points, gwd->color);
 }
 
 GPoint GWindow::drawPolarLine(const GPoint & p0, double r, double theta) {
@@ -156,9 +158,7 @@ void GWindow::drawRect(const GRectangle & bounds) {
 }
 
 void GWindow::drawRect(double x, double y, double width, double height) {
-   GRect rect(x, y, width, height);
-   rect.setColor(gwd->color);
-   draw(rect);
+   pp->drawRect(*this, x, y, width, height, gwd->color, false);
 }
 
 void GWindow::fillRect(const GRectangle & bounds) {
@@ -167,10 +167,7 @@ void GWindow::fillRect(const GRectangle & bounds) {
 }
 
 void GWindow::fillRect(double x, double y, double width, double height) {
-   GRect rect(x, y, width, height);
-   rect.setColor(gwd->color);
-   rect.setFilled(true);
-   draw(rect);
+   pp->drawRect(*this, x, y, width, height, gwd->color, true);
 }
 
 void GWindow::drawOval(const GRectangle & bounds) {
@@ -179,9 +176,7 @@ void GWindow::drawOval(const GRectangle & bounds) {
 }
 
 void GWindow::drawOval(double x, double y, double width, double height) {
-   GOval oval(x, y, width, height);
-   oval.setColor(gwd->color);
-   draw(oval);
+   pp->drawOval(*this, x, y, width, height, gwd->color, false);
 }
 
 void GWindow::fillOval(const GRectangle & bounds) {
@@ -190,10 +185,7 @@ void GWindow::fillOval(const GRectangle & bounds) {
 }
 
 void GWindow::fillOval(double x, double y, double width, double height) {
-   GOval oval(x, y, width, height);
-   oval.setColor(gwd->color);
-   oval.setFilled(true);
-   draw(oval);
+   pp->drawOval(*this, x, y, width, height, gwd->color, true);
 }
 
 void GWindow::setColor(string color) {
@@ -284,12 +276,7 @@ void GWindow::remove(GObject *gobj) {
 }
 
 GObject *GWindow::getGObjectAt(double x, double y) {
-   int n = gwd->top->getElementCount();
-   for (int i = n - 1; i >= 0; i--) {
-      GObject *gobj = gwd->top->getElement(i);
-      if (gobj->contains(x, y)) return gobj;
-   }
-   return NULL;
+   return gwd->top->getElementAt(x, y);
 }
 
 void GWindow::setRegionAlignment(string region, string align) {
@@ -354,6 +341,14 @@ void exitGraphics() {
    exit(0);
 }
 
+void beginBatch() {
+   pp->beginBatch();
+}
+
+void endBatch() {
+   pp->endBatch();
+}
+
 static void initColorTable() {
    colorTable["black"] = 0xFF000000;
    colorTable["darkgray"] = 0xFF595959;
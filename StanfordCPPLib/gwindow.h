@@ -51,6 +51,9 @@ struct GWindowData {
    std::string color;
    bool visible;
    GCompound *top;
+   double canvasWidth;
+   double canvasHeight;
+   bool canvasSizeKnown;
 };
 
 /**
@@ -183,6 +186,18 @@ public:
    void drawLine(double x0, double y0, double x1, double y1);
 
 
+/**
+ * Draws the polyline that connects the specified points in order.  The
+ * whole polyline is sent to the back end as a single command, which makes
+ * this method much faster than calling \ref drawLine for each segment.
+ *
+ * Sample usage:
+ *
+ *     gw.drawLines(points);
+ */
+   void drawLines(const Vector<GPoint> & points);
+
+
 /** \_overload */
    GPoint drawPolarLine(const GPoint & p0, double r, double theta);
 /**
@@ -638,6 +653,35 @@ std::string convertRGBToColor(int rgb);
 void exitGraphics();
 
 
+/**
+ * Starts a batch of graphics operations.  Commands for the graphics
+ * window are normally sent whenever the window is repainted or the
+ * program writes to the console.  Until the matching call to
+ * \ref endBatch, they are instead held back, so that a complete frame
+ * of an animation appears at once.  Calls to <code>beginBatch</code>
+ * may be nested; operations that need an answer from the window, such
+ * as <code>getCanvasWidth</code>, still take effect immediately.
+ *
+ * Sample usage:
+ *
+ *     beginBatch();
+ *     for (GObject *gobj : objects) gobj->move(dx, dy);
+ *     endBatch();
+ */
+void beginBatch();
+
+
+/**
+ * Ends the batch started by the matching call to \ref beginBatch.  When
+ * the outermost batch ends, the held commands are sent to the window.
+ *
+ * Sample usage:
+ *
+ *     endBatch();
+ */
+void endBatch();
+
+
 #include "console.h"
 #include "private/main.h"
 
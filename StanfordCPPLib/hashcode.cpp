@@ -17,21 +17,212 @@
 /*************************************************************************/
 
 #include "hashcode.h"
+#include <chrono>
+#include <cstring>
+#include <random>
 
 const int HASH_SEED = 5381;               // Starting point for first cycle
 const int HASH_MULTIPLIER = 33;           // Multiplier for each cycle
 const int HASH_MASK = unsigned(-1) >> 1;  // All 1 bits except the sign
 
+/*
+ * Implementation notes: 64-bit hashing
+ * ------------------------------------
+ * The 64-bit functions follow the design of wyhash by Wang Yi.  The
+ * core operation, mix, forms the full 128-bit product of two 64-bit
+ * words and folds the halves together with exclusive-or, which
+ * diffuses every input bit across the result.  Strings are consumed
+ * eight bytes at a time rather than one, and long strings are split
+ * across three independent lanes so that the multiplications can
+ * proceed in parallel.  The hashCode64 functions start from the
+ * per-process seed; the hashCode functions use the same mixing with
+ * the fixed seed STABLE_SEED, so that their results never change.
+ */
+
+static const uint64_t P0 = 0x2d358dccaa6c78a5ULL;
+static const uint64_t P1 = 0x8bb84b93962eacc9ULL;
+static const uint64_t P2 = 0x4b33a62ed433d4a3ULL;
+static const uint64_t P3 = 0x4d5a2da51de1aa47ULL;
+static const uint64_t STABLE_SEED = 0x9e3779b97f4a7c15ULL;
+
+/*
+ * Replaces a and b with the low and high words of their 128-bit product.
+ */
+
+static inline void multiply(uint64_t & a, uint64_t & b) {
+#ifdef __SIZEOF_INT128__
+   __uint128_t product = (__uint128_t) a * b;
+   a = uint64_t(product);
+   b = uint64_t(product >> 64);
+#else
+   uint64_t aLo = uint32_t(a), aHi = a >> 32;
+   uint64_t bLo = uint32_t(b), bHi = b >> 32;
+   uint64_t lh = aLo * bHi, hl = aHi * bLo, ll = aLo * bLo;
+   uint64_t carry = ((ll >> 32) + uint32_t(lh) + uint32_t(hl)) >> 32;
+   a = ll + (lh << 32) + (hl << 32);
+   b = aHi * bHi + (lh >> 32) + (hl >> 32) + carry;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+   multiply(a, b);
+   return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+   uint64_t word;
+   std::memcpy(&word, p, sizeof word);
+   return word;
+}
+
+static inline uint64_t read32(const uint8_t *p) {
+   uint32_t word;
+   std::memcpy(&word, p, sizeof word);
+   return word;
+}
+
+/*
+ * Implementation notes: hashSeed
+ * ------------------------------
+ * The seed combines the system's random device with the clock, since
+ * some implementations of random_device are deterministic.  The local
+ * static is initialized exactly once, even if several threads ask for
+ * the seed at the same time.
+ */
+
+static uint64_t createSeed() {
+   std::random_device rd;
+   uint64_t seed = (uint64_t(rd()) << 32) ^ rd();
+   seed ^= (uint64_t) std::chrono::high_resolution_clock::now()
+                                    .time_since_epoch().count();
+   return mix(seed ^ P0, P1);
+}
+
+uint64_t hashSeed() {
+   static const uint64_t seed = createSeed();
+   return seed;
+}
+
+/*
+ * Hashes the length bytes at data starting from the specified seed.
+ */
+
+static uint64_t hashBytes(const void *data, size_t length, uint64_t seed) {
+   const uint8_t *p = (const uint8_t *) data;
+   uint64_t a, b;
+   if (length <= 16) {
+      if (length >= 4) {
+         size_t mid = (length >> 3) << 2;
+         a = (read32(p) << 32) | read32(p + mid);
+         b = (read32(p + length - 4) << 32) | read32(p + length - 4 - mid);
+      } else if (length > 0) {
+         a = (uint64_t(p[0]) << 16) | (uint64_t(p[length >> 1]) << 8)
+                                    | p[length - 1];
+         b = 0;
+      } else {
+         a = b = 0;
+      }
+   } else {
+      size_t i = length;
+      if (i > 48) {
+         uint64_t lane1 = seed, lane2 = seed;
+         do {
+            seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+            lane1 = mix(read64(p + 16) ^ P2, read64(p + 24) ^ lane1);
+            lane2 = mix(read64(p + 32) ^ P3, read64(p + 40) ^ lane2);
+            p += 48;
+            i -= 48;
+         } while (i > 48);
+         seed ^= lane1 ^ lane2;
+      }
+      while (i > 16) {
+         seed = mix(read64(p) ^ P1, read64(p + 8) ^ seed);
+         p += 16;
+         i -= 16;
+      }
+      a = read64(p + i - 16);
+      b = read64(p + i - 8);
+   }
+   a ^= P1;
+   b ^= seed;
+   multiply(a, b);
+   return mix(a ^ P0 ^ length, b ^ P1);
+}
+
+uint64_t hashBytes(const void *data, size_t length) {
+   return hashBytes(data, length, hashSeed());
+}
+
+/*
+ * Returns the bits of key, with negative zero replaced by zero so that
+ * the two values that compare equal also hash equally.
+ */
+
+static uint64_t doubleBits(double key) {
+   if (key == 0) key = 0;
+   uint64_t bits;
+   std::memcpy(&bits, &key, sizeof bits);
+   return bits;
+}
+
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+   return mix(hash ^ P0, value ^ P1);
+}
+
+uint64_t hashCode64(bool key) {
+   return hashCombine(hashSeed(), (uint64_t) key);
+}
+
+uint64_t hashCode64(char key) {
+   return hashCombine(hashSeed(), (uint64_t) key);
+}
+
+/*
+ * Implementation notes: hashCode64 for floating-point types
+ * ---------------------------------------------------------
+ * The value is hashed as a single 64-bit word.  Floats are widened to
+ * double, which is exact.
+ */
+
+uint64_t hashCode64(double key) {
+   return hashCombine(hashSeed(), doubleBits(key));
+}
+
+uint64_t hashCode64(float key) {
+   return hashCode64(double(key));
+}
+
+uint64_t hashCode64(int key) {
+   return hashCombine(hashSeed(), (uint64_t) key);
+}
+
+uint64_t hashCode64(long key) {
+   return hashCombine(hashSeed(), (uint64_t) key);
+}
+
+uint64_t hashCode64(const char* str) {
+   return (str == NULL) ? hashBytes("", 0) : hashBytes(str, std::strlen(str));
+}
+
+uint64_t hashCode64(const std::string& str) {
+   return hashBytes(str.data(), str.length());
+}
+
+uint64_t hashCode64(void* key) {
+   return hashCode64(reinterpret_cast<long>(key));
+}
+
 /*
  * Implementation notes: hashCode
  * ------------------------------
- * This function takes a string key and uses it to derive a hash code,
- * which is a nonnegative integer related to the key by a deterministic
- * function that distributes keys well across the space of integers.
- * The general method is called linear congruence, which is also used
- * in random-number generators.  The specific algorithm used here is
- * called djb2 after the initials of its inventor, Daniel J. Bernstein,
- * Professor of Mathematics at the University of Illinois at Chicago.
+ * A bool or char hashes to its own value, and an int to its value with
+ * the sign bit masked off.  A long, and so a pointer, has its high 32
+ * bits folded into its low 32 bits by exclusive-or before the mask is
+ * applied, so that keys differing only in their high bits still get
+ * different codes.  Strings and the floating-point types use the top
+ * bits of a 64-bit hash computed from STABLE_SEED rather than the
+ * per-process seed, so hashCode returns the same value for the same key
+ * on every run.
  */
 
 int hashCode(bool key) {
@@ -43,21 +234,11 @@ int hashCode(char key) {
 }
 
 int hashCode(double key) {
-    char* byte = (char*) &key;
-    unsigned hash = HASH_SEED;
-    for (int i = 0; i < (int) sizeof(double); i++) {
-        hash = HASH_MULTIPLIER * hash + (int) *byte++;
-    }
-    return hash & HASH_MASK;
+    return hashFold(hashCombine(STABLE_SEED, doubleBits(key)));
 }
 
 int hashCode(float key) {
-    char* byte = (char*) &key;
-    unsigned hash = HASH_SEED;
-    for (int i = 0; i < (int) sizeof(float); i++) {
-        hash = HASH_MULTIPLIER * hash + (int) *byte++;
-    }
-    return hash & HASH_MASK;
+    return hashCode(double(key));
 }
 
 int hashCode(int key) {
@@ -65,24 +246,16 @@ int hashCode(int key) {
 }
 
 int hashCode(long key) {
-    return int(key) & HASH_MASK;
+    return int((key ^ ((long long) key >> 32)) & HASH_MASK);
 }
 
 int hashCode(const char* str) {
-    unsigned hash = HASH_SEED;
-    for (int i = 0; str && str[i] != 0; i++) {
-        hash = HASH_MULTIPLIER * hash + str[i];
-    }
-    return int(hash & HASH_MASK);
+    size_t length = (str == NULL) ? 0 : std::strlen(str);
+    return hashFold(hashBytes((str == NULL) ? "" : str, length, STABLE_SEED));
 }
 
 int hashCode(const std::string& str) {
-    unsigned hash = HASH_SEED;
-    int n = str.length();
-    for (int i = 0; i < n; i++) {
-        hash = HASH_MULTIPLIER * hash + str[i];
-    }
-    return int(hash & HASH_MASK);
+    return hashFold(hashBytes(str.data(), str.length(), STABLE_SEED));
 }
 
 int hashCode(void* key) {
@@ -33,6 +33,8 @@
 #ifndef _hashcode_h
 #define _hashcode_h
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 
@@ -54,8 +56,9 @@ int hashCode(const char* str);
 int hashCode(const std::string& str);
 /**
  * Returns a hash code for the specified key. The hash code is always a
- * nonnegative integer.  This function is overloaded to support
- * all of the primitive types and the C++ \c string type.
+ * nonnegative integer and is the same for a given key on every run of a
+ * program.  This function is overloaded to support all of the primitive
+ * types and the C++ \c string type.
  *
  * Sample usage:
  *
@@ -72,4 +75,83 @@ extern const int HASH_SEED;         // Starting point for first cycle
 extern const int HASH_MULTIPLIER;   // Multiplier for each cycle
 extern const int HASH_MASK;         // All 1 bits except the sign
 
+/**
+ * Returns the hash seed for this process.  The seed is chosen at random
+ * the first time it is needed, so that an adversary who supplies the
+ * keys of a HashMap cannot precompute a set of colliding keys.  As a
+ * consequence, the results of \c hashCode64 and the iteration order of
+ * hash-based collections differ from one run of a program to the next;
+ * the results of \c hashCode do not.
+ */
+uint64_t hashSeed();
+
+/**
+ * Returns a 64-bit hash of the \em length bytes starting at \em data.
+ * The hash depends on the per-process seed.
+ *
+ * Sample usage:
+ *
+ *     uint64_t hash = hashBytes(buffer, n);
+ */
+uint64_t hashBytes(const void *data, size_t length);
+
+/**
+ * Combines the hash code of one more component into \em hash and returns
+ * the result.  The combination itself is not seeded, so combining the
+ * stable \c hashCode values of the components gives a stable result.
+ * Unlike the exclusive-or of the components, the result depends on the
+ * order in which the components are combined, so that (x, y) and (y, x)
+ * do not collide.
+ *
+ * Sample usage:
+ *
+ *     int code = hashFold(hashCombine(hashCode(pt.x), hashCode(pt.y)));
+ */
+uint64_t hashCombine(uint64_t hash, uint64_t value);
+
+/** \_overload */
+uint64_t hashCode64(bool key);
+/** \_overload */
+uint64_t hashCode64(char key);
+/** \_overload */
+uint64_t hashCode64(double key);
+/** \_overload */
+uint64_t hashCode64(float key);
+/** \_overload */
+uint64_t hashCode64(int key);
+/** \_overload */
+uint64_t hashCode64(long key);
+/** \_overload */
+uint64_t hashCode64(const char* str);
+/** \_overload */
+uint64_t hashCode64(const std::string& str);
+/** \_overload */
+uint64_t hashCode64(void* key);
+
+/**
+ * Returns the seeded 64-bit hash code that HashMap and HashSet use to
+ * place the specified key.  The primitive types and strings are hashed
+ * directly.  For any other type, this function calls the \c hashCode
+ * function for that type and scrambles the result, so \c hashCode
+ * remains the only function a client needs to write.
+ *
+ * Sample usage:
+ *
+ *     uint64_t hash = hashCode64(key);
+ */
+template <typename KeyType>
+uint64_t hashCode64(const KeyType& key) {
+   return hashCombine(hashSeed(), (uint64_t) hashCode(key));
+}
+
+/*
+ * Function: hashFold
+ * Usage: int code = hashFold(hash);
+ * ---------------------------------
+ * Reduces a 64-bit hash to the nonnegative int returned by hashCode.
+ */
+inline int hashFold(uint64_t hash) {
+   return int(hash >> 33);
+}
+
 #endif // _hashcode_h
@@ -32,6 +32,7 @@
 #include <sstream>
 #include "vector.h"
 #include "hashcode.h"
+#include "private/nodevalue.h"
 
 /**
  * @class HashMap
@@ -62,6 +63,8 @@ public:
  * exports \c hashCode functions for \c string and
  * the C++ primitive types. In addition, each of the Stanford-Whittier collection
  * classes (Vector, Stack, Queue, etc.) exports its own \c hashCode function.
+ * The map scrambles these codes with a per-process random seed, so the
+ * iteration order can change from one run of a program to the next.
  *
  * Sample usage:
  *
@@ -258,21 +261,29 @@ public:
  * Implementation notes:
  * ---------------------
  * The HashMap class is represented using a hash table that uses
- * bucket chaining to resolve collisions.
+ * bucket chaining to resolve collisions.  Keys are placed using the
+ * seeded 64-bit hashCode64 function from hashcode.h.  Because that
+ * hash is already well mixed, the number of buckets is kept at a power
+ * of two and the bucket index is taken from the low bits of the hash.
+ * The cells do not store the hashes of their keys, which would add a
+ * word to every cell; expandAndRehash hashes each key again instead.
  */
 
 private:
 
 /* Constant definitions */
 
-   static const int INITIAL_BUCKET_COUNT = 101;
+   static const int INITIAL_BUCKET_COUNT = 128;
    static const int MAX_LOAD_PERCENTAGE = 70;
 
-/* Type definition for cells in the bucket chain */
+/*
+ * Type definition for cells in the bucket chain.  The value is
+ * inherited from NodeValue so that the KeyOnly maps used by HashSet
+ * do not store one.
+ */
 
-   struct Cell {
+   struct Cell : public NodeValue<ValueType> {
       KeyType key;
-      ValueType value;
       Cell *next;
    };
 
@@ -300,6 +311,17 @@ private:
       numEntries = 0;
    }
 
+/*
+ * Private method: bucketFor
+ * Usage: int bucket = bucketFor(hash);
+ * ------------------------------------
+ * Returns the index of the bucket for a key with the specified hash.
+ */
+
+   int bucketFor(uint64_t hash) const {
+      return int(hash & (nBuckets - 1));
+   }
+
 /*
  * Private method: deleteBuckets
  * Usage: deleteBuckets(buckets);
@@ -331,22 +353,29 @@ private:
  */
 
    void expandAndRehash() {
-      Vector<Cell *>oldBuckets = buckets;
-      createBuckets(oldBuckets.size() * 2 + 1);
+      Vector<Cell *> oldBuckets = buckets;
+      int oldEntries = numEntries;
+      createBuckets(oldBuckets.size() * 2);
       for (int i = 0; i < oldBuckets.size(); i++) {
-         for (Cell *cp = oldBuckets[i]; cp != NULL; cp = cp->next) {
-            put(cp->key, cp->value);
+         Cell *cp = oldBuckets[i];
+         while (cp != NULL) {
+            Cell *np = cp->next;
+            int bucket = bucketFor(hashCode64(cp->key));
+            cp->next = buckets[bucket];
+            buckets[bucket] = cp;
+            cp = np;
          }
       }
-      deleteBuckets(oldBuckets);
+      numEntries = oldEntries;
    }
 
 /*
  * Private method: findCell
- * Usage: Cell *cp = findCell(bucket, key);
- *        Cell *cp = findCell(bucket, key, parent);
- * ------------------------------------------------
- * Finds a cell in the chain for the specified bucket that matches key.
+ * Usage: Cell *cp = findCell(hash, key);
+ *        Cell *cp = findCell(hash, key, parent);
+ * ----------------------------------------------
+ * Finds a cell in the chain for the bucket selected by hash that matches
+ * key.
  * If a match is found, the return value is a pointer to the cell containing
  * the matching key.  If no match is found, the function returns NULL.
  * If the optional third argument is supplied, it is filled in with the
@@ -355,14 +384,14 @@ private:
  * that the cell is the first cell in the bucket chain.
  */
 
-   Cell *findCell(int bucket, KeyType key) const {
+   Cell *findCell(uint64_t hash, const KeyType & key) const {
       Cell *dummy;
-      return findCell(bucket, key, dummy);
+      return findCell(hash, key, dummy);
    }
 
-   Cell *findCell(int bucket, KeyType key, Cell * & parent) const {
+   Cell *findCell(uint64_t hash, const KeyType & key, Cell * & parent) const {
       parent = NULL;
-      Cell *cp = buckets.get(bucket);
+      Cell *cp = buckets.get(bucketFor(hash));
       while (cp != NULL && key != cp->key) {
          parent = cp;
          cp = cp->next;
@@ -374,9 +403,14 @@ private:
       createBuckets(src.nBuckets);
       for (int i = 0; i < src.nBuckets; i++) {
          for (Cell *cp = src.buckets.get(i); cp != NULL; cp = cp->next) {
-            put(cp->key, cp->value);
+            Cell *copy = new Cell;
+            copy->key = cp->key;
+            copy->setValue(cp->getValue());
+            copy->next = buckets[i];
+            buckets[i] = copy;
          }
       }
+      numEntries = src.numEntries;
    }
 
 public:
@@ -540,14 +574,14 @@ void HashMap<KeyType,ValueType>::put(KeyType key, ValueType value) {
 
 template <typename KeyType,typename ValueType>
 ValueType HashMap<KeyType,ValueType>::get(KeyType key) const {
-   Cell *cp = findCell(hashCode(key) % nBuckets, key);
+   Cell *cp = findCell(hashCode64(key), key);
    if (cp == NULL) return ValueType();
-   return cp->value;
+   return cp->getValue();
 }
 
 template <typename KeyType,typename ValueType>
 bool HashMap<KeyType,ValueType>::containsKey(KeyType key) const {
-   return findCell(hashCode(key) % nBuckets, key) != NULL;
+   return findCell(hashCode64(key), key) != NULL;
 }
 
 template <typename KeyType, typename ValueType>
@@ -577,12 +611,12 @@ bool HashMap<KeyType, ValueType>::equals(const HashMap<KeyType, ValueType>& map2
 
 template <typename KeyType,typename ValueType>
 void HashMap<KeyType,ValueType>::remove(KeyType key) {
-   int bucket = hashCode(key) % nBuckets;
+   uint64_t hash = hashCode64(key);
    Cell *parent;
-   Cell *cp = findCell(bucket, key, parent);
+   Cell *cp = findCell(hash, key, parent);
    if (cp != NULL) {
       if (parent == NULL) {
-         buckets[bucket] = cp->next;
+         buckets[bucketFor(hash)] = cp->next;
       } else {
          parent->next = cp->next;
       }
@@ -599,28 +633,28 @@ void HashMap<KeyType,ValueType>::clear() {
 
 template <typename KeyType,typename ValueType>
 ValueType & HashMap<KeyType,ValueType>::operator[](KeyType key) {
-   int bucket = hashCode(key) % nBuckets;
-   Cell *cp = findCell(bucket, key);
+   uint64_t hash = hashCode64(key);
+   Cell *cp = findCell(hash, key);
    if (cp == NULL) {
       if (numEntries > MAX_LOAD_PERCENTAGE * nBuckets / 100.0) {
          expandAndRehash();
-         bucket = hashCode(key) % nBuckets;
       }
+      int bucket = bucketFor(hash);
       cp = new Cell;
       cp->key = key;
-      cp->value = ValueType();
+      cp->setValue(ValueType());
       cp->next = buckets[bucket];
       buckets[bucket] = cp;
       numEntries++;
    }
-   return cp->value;
+   return cp->getValue();
 }
 
 template <typename KeyType,typename ValueType>
 void HashMap<KeyType,ValueType>::mapAll(void (*fn)(KeyType, ValueType)) const {
    for (int i = 0 ; i < buckets.size(); i++) {
       for (Cell *cp = buckets.get(i); cp != NULL; cp = cp->next) {
-         fn(cp->key, cp->value);
+         fn(cp->key, cp->getValue());
       }
    }
 }
@@ -630,7 +664,7 @@ void HashMap<KeyType,ValueType>::mapAll(void (*fn)(const KeyType &,
                                                    const ValueType &)) const {
    for (int i = 0 ; i < buckets.size(); i++) {
       for (Cell *cp = buckets.get(i); cp != NULL; cp = cp->next) {
-         fn(cp->key, cp->value);
+         fn(cp->key, cp->getValue());
       }
    }
 }
@@ -640,7 +674,7 @@ template <typename FunctorType>
 void HashMap<KeyType,ValueType>::mapAll(FunctorType fn) const {
    for (int i = 0 ; i < buckets.size(); i++) {
       for (Cell *cp = buckets.get(i); cp != NULL; cp = cp->next) {
-         fn(cp->key, cp->value);
+         fn(cp->key, cp->getValue());
       }
    }
 }
@@ -731,16 +765,16 @@ std::istream & operator>>(std::istream & is,
 /*
  * Template hash function for hash maps.
  * Requires the key and value types in the HashMap to have a hashCode function.
+ * The entries are summed rather than chained, since equal maps may
+ * iterate over their keys in different orders.
  */
 template <typename K, typename V>
 int hashCode(const HashMap<K, V>& map) {
-    int code = HASH_SEED;
+    uint64_t code = HASH_SEED;
     for (K k : map) {
-        code = HASH_MULTIPLIER * code + hashCode(k);
-        V v = map[k];
-        code = HASH_MULTIPLIER * code + hashCode(v);
+        code += hashCombine(hashCode(k), hashCode(map[k]));
     }
-    return int(code & HASH_MASK);
+    return hashFold(code);
 }
 
 #endif
@@ -351,7 +351,7 @@ public:
 
 private:
 
-   HashMap<ValueType,bool> map;        /* Map used to store the element     */
+   HashMap<ValueType,KeyOnly> map;     /* Key-only map storing the elements */
    bool removeFlag;                    /* Flag to differentiate += and -=   */
 
 public:
@@ -386,7 +386,7 @@ public:
 
    private:
 
-      typename HashMap<ValueType,bool>::iterator mapit;
+      typename HashMap<ValueType,KeyOnly>::iterator mapit;
 
    public:
 
@@ -394,7 +394,7 @@ public:
          /* Empty */
       }
 
-      iterator(typename HashMap<ValueType,bool>::iterator it) : mapit(it) {
+      iterator(typename HashMap<ValueType,KeyOnly>::iterator it) : mapit(it) {
          /* Empty */
       }
 
@@ -464,7 +464,7 @@ bool HashSet<ValueType>::isEmpty() const {
 
 template <typename ValueType>
 void HashSet<ValueType>::add(const ValueType & value) {
-   map.put(value, true);
+   map.put(value, KeyOnly());
 }
 
 template <typename ValueType>
@@ -483,7 +483,7 @@ bool HashSet<ValueType>::equals(const HashSet<ValueType>& set2) const {
 
 template <typename ValueType>
 void HashSet<ValueType>::insert(const ValueType & value) {
-   map.put(value, true);
+   map.put(value, KeyOnly());
 }
 
 template <typename ValueType>
@@ -626,25 +626,31 @@ ValueType HashSet<ValueType>::first() const {
 
 template <typename ValueType>
 std::string HashSet<ValueType>::toString() {
-   ostringstream os;
+   std::ostringstream os;
    os << *this;
    return os.str();
 }
 
 template <typename ValueType>
 void HashSet<ValueType>::mapAll(void (*fn)(ValueType)) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 template <typename ValueType>
 void HashSet<ValueType>::mapAll(void (*fn)(const ValueType &)) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 template <typename ValueType>
 template <typename FunctorType>
 void HashSet<ValueType>::mapAll(FunctorType fn) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 /**
@@ -694,14 +700,16 @@ std::istream & operator>>(std::istream & is, HashSet<ValueType> & set) {
 /*
  * Template hash function for hash sets.
  * Requires the element type in the HashSet to have a hashCode function.
+ * The element hashes are summed rather than chained, since equal sets
+ * may iterate over their elements in different orders.
  */
 template <typename T>
 int hashCode(const HashSet<T>& s) {
-    int code = HASH_SEED;
+    uint64_t code = HASH_SEED;
     for (T n : s) {
-        code = HASH_MULTIPLIER * code + hashCode(n);
+        code += hashCombine(HASH_SEED, hashCode(n));
     }
-    return int(code & HASH_MASK);
+    return hashFold(code);
 }
 
 #endif
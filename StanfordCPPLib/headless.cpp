@@ -0,0 +1,1208 @@
+/*
+ * File: headless.cpp
+ * ------------------
+ * This file implements the headless back end declared in
+ * private/backend.h and the headless.h interface.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "base64.h"
+#include "error.h"
+#include "gevents.h"
+#include "gtypes.h"
+#include "gwindow.h"
+#include "headless.h"
+#include "platform.h"
+#include "strlib.h"
+#include "tokenscanner.h"
+#include "private/backend.h"
+using namespace std;
+
+static Platform *pp = getPlatform();
+
+/* Implementation of the headless.h interface */
+
+bool isHeadless() {
+   return pp->isHeadless();
+}
+
+Grid<int> getWindowPixels(const GWindow & gw) {
+   return pp->getWindowPixels(gw);
+}
+
+void saveWindowImage(const GWindow & gw, string filename) {
+   Grid<int> pixels = getWindowPixels(gw);
+   ofstream out(filename.c_str(), ios::binary);
+   if (out.fail()) error("saveWindowImage: Can't open " + filename);
+   out << "P6\n" << pixels.numCols() << " " << pixels.numRows() << "\n255\n";
+   string row(3 * pixels.numCols(), '\0');
+   for (int y = 0; y < pixels.numRows(); y++) {
+      for (int x = 0; x < pixels.numCols(); x++) {
+         int rgb = pixels[y][x];
+         row[3 * x] = char(rgb >> 16);
+         row[3 * x + 1] = char(rgb >> 8);
+         row[3 * x + 2] = char(rgb);
+      }
+      out.write(row.data(), row.length());
+   }
+   if (out.fail()) error("saveWindowImage: Can't write " + filename);
+}
+
+/* Private section */
+
+/*
+ * Implementation notes: headless back end
+ * ---------------------------------------
+ * The headless back end receives the same text commands that would go
+ * to the Java back end and answers them with the same reply lines, so
+ * Platform needs to know only where the bytes go.  Each command is
+ * executed as soon as its line is complete; replies accumulate in the
+ * replies string until Platform reads them.  The back end declines the
+ * binary protocol, which would save nothing inside one process.
+ *
+ * The objects form the same tree as in the Java back end: every window
+ * has a top compound, and each object has a location in its parent's
+ * coordinates plus a 2x2 matrix that accumulates rotate and scale.
+ * Shapes are drawn by converting them to polygons in window coordinates,
+ * filling those with an even-odd scanline fill that samples pixel
+ * centers, and tracing their outlines with Bresenham lines.  What the
+ * program draws with GWindow::draw goes into a background grid that is
+ * kept for each window; getPixels copies that grid and draws the object
+ * tree over it.
+ *
+ * Fonts are modeled rather than rendered.  A font of size s has an
+ * ascent of s, a descent of s/4, and the same advance of 0.6 s for every
+ * character, and the same metrics are returned by getFontMetrics, so
+ * labels measured locally agree with the back end.
+ *
+ * There is no real clock.  The time starts at the wall-clock time when
+ * the back end is created and advances only when the program pauses or
+ * asks for an event, in which case the clock jumps to the next tick of
+ * the earliest running timer.
+ */
+
+enum HeadlessType {
+   H_RECT, H_ROUND_RECT, H_3D_RECT, H_OVAL, H_ARC, H_LINE, H_POLYGON,
+   H_LABEL, H_COMPOUND, H_BUFFERED_IMAGE, H_INTERACTOR
+};
+
+static const int WHITE = 0xFFFFFF;
+static const int DEFAULT_FONT_SIZE = 12;
+static const int SCREEN_WIDTH = 1920;
+static const int SCREEN_HEIGHT = 1080;
+static const double LINE_TOLERANCE = 1.5;
+static const double ARC_TOLERANCE = 2.5;
+static const int FIRST_FONT_CHAR = ' ';
+static const int LAST_FONT_CHAR = '~';
+
+/* Flags of GObject.setState, which must match those in platform.cpp */
+
+enum StateFlag {
+   STATE_LOCATION = 1,
+   STATE_SIZE = 2,
+   STATE_COLOR = 4,
+   STATE_FILL_COLOR = 8,
+   STATE_FILLED = 16,
+   STATE_VISIBLE = 32,
+   STATE_LINE_WIDTH = 64
+};
+
+struct HeadlessObject {
+   int type;
+   double x, y;
+   double width, height;
+   double corner;
+   double start, sweep;
+   double dx, dy;
+   vector<GPoint> vertices;
+   string text;
+   double fontSize;
+   int color;
+   int fillColor;
+   bool hasFillColor;
+   bool filled;
+   bool visible;
+   double lineWidth;
+   double matrix[4];
+   HeadlessObject *parent;
+   vector<HeadlessObject *> children;
+   Grid<int> pixels;
+   int background;
+   bool selected;
+   int value;
+   Vector<string> items;
+
+   HeadlessObject(int type) {
+      this->type = type;
+      x = y = width = height = corner = start = sweep = dx = dy = 0;
+      fontSize = DEFAULT_FONT_SIZE;
+      color = 0xFF000000;
+      fillColor = 0xFF000000;
+      hasFillColor = false;
+      filled = false;
+      visible = true;
+      lineWidth = 1;
+      matrix[0] = matrix[3] = 1;
+      matrix[1] = matrix[2] = 0;
+      parent = NULL;
+      background = WHITE;
+      selected = false;
+      value = 0;
+   }
+};
+
+struct HeadlessWindow {
+   int width;
+   int height;
+   Grid<int> background;
+   HeadlessObject *top;
+};
+
+struct HeadlessTimer {
+   double delay;
+   double next;
+   bool running;
+   int serial;
+};
+
+/*
+ * Type: Affine
+ * ------------
+ * An affine transformation that takes (x, y) to
+ * (a x + c y + tx, b x + d y + ty).
+ */
+
+struct Affine {
+   double a, b, c, d, tx, ty;
+
+   Affine() {
+      a = d = 1;
+      b = c = tx = ty = 0;
+   }
+
+   GPoint apply(double x, double y) const {
+      return GPoint(a * x + c * y + tx, b * x + d * y + ty);
+   }
+
+   Affine compose(const Affine & t) const {
+      Affine r;
+      r.a = a * t.a + c * t.b;
+      r.b = b * t.a + d * t.b;
+      r.c = a * t.c + c * t.d;
+      r.d = b * t.c + d * t.d;
+      r.tx = a * t.tx + c * t.ty + tx;
+      r.ty = b * t.tx + d * t.ty + ty;
+      return r;
+   }
+};
+
+/* Font model */
+
+static double parseFontSize(const string & font) {
+   size_t dash = font.rfind('-');
+   if (dash == string::npos) return DEFAULT_FONT_SIZE;
+   double size = atof(font.c_str() + dash + 1);
+   return (size > 0) ? size : DEFAULT_FONT_SIZE;
+}
+
+static int fontAscent(double size) {
+   return (int) floor(size + 0.5);
+}
+
+static int fontDescent(double size) {
+   return (int) floor(size / 4 + 0.5);
+}
+
+static int fontAdvance(double size) {
+   return (int) floor(0.6 * size + 0.5);
+}
+
+static int countChars(const string & str) {
+   int n = 0;
+   for (size_t i = 0; i < str.length(); i++) {
+      if ((str[i] & 0xC0) != 0x80) n++;
+   }
+   return n;
+}
+
+/* Geometry */
+
+static Affine localTransform(const HeadlessObject *obj) {
+   Affine t;
+   t.a = obj->matrix[0];
+   t.b = obj->matrix[1];
+   t.c = obj->matrix[2];
+   t.d = obj->matrix[3];
+   t.tx = obj->x;
+   t.ty = obj->y;
+   return t;
+}
+
+static void appendArc(vector<GPoint> & path, const Affine & t,
+                      double x, double y, double width, double height,
+                      double start, double sweep) {
+   double rx = width / 2;
+   double ry = height / 2;
+   double perimeter = fabs(sweep) / 360 * M_PI * (fabs(rx) + fabs(ry));
+   int n = max(8, min(720, (int) (perimeter / 2)));
+   for (int i = 0; i <= n; i++) {
+      double theta = (start + sweep * i / n) * M_PI / 180;
+      path.push_back(t.apply(x + rx + rx * cos(theta),
+                             y + ry - ry * sin(theta)));
+   }
+}
+
+static void appendRect(vector<GPoint> & path, const Affine & t,
+                       double x, double y, double width, double height) {
+   path.push_back(t.apply(x, y));
+   path.push_back(t.apply(x + width, y));
+   path.push_back(t.apply(x + width, y + height));
+   path.push_back(t.apply(x, y + height));
+}
+
+/*
+ * Function: getOutline
+ * Usage: bool closed = getOutline(obj, t, path);
+ * ----------------------------------------------
+ * Appends the outline of a leaf object, transformed by t, to path and
+ * returns true if the outline is a closed polygon.  A filled arc is
+ * outlined as a pie slice.
+ */
+
+static bool getOutline(const HeadlessObject *obj, const Affine & t,
+                       vector<GPoint> & path) {
+   switch (obj->type) {
+   case H_ROUND_RECT: {
+      double r = min(obj->corner, min(obj->width, obj->height)) / 2;
+      double w = obj->width;
+      double h = obj->height;
+      appendArc(path, t, w - 2 * r, 0, 2 * r, 2 * r, 0, 90);
+      appendArc(path, t, 0, 0, 2 * r, 2 * r, 90, 90);
+      appendArc(path, t, 0, h - 2 * r, 2 * r, 2 * r, 180, 90);
+      appendArc(path, t, w - 2 * r, h - 2 * r, 2 * r, 2 * r, 270, 90);
+      return true;
+   }
+   case H_OVAL:
+      appendArc(path, t, 0, 0, obj->width, obj->height, 0, 360);
+      return true;
+   case H_ARC:
+      if (obj->filled) path.push_back(t.apply(obj->width / 2, obj->height / 2));
+      appendArc(path, t, 0, 0, obj->width, obj->height, obj->start, obj->sweep);
+      return obj->filled;
+   case H_LINE:
+      path.push_back(t.apply(0, 0));
+      path.push_back(t.apply(obj->dx, obj->dy));
+      return false;
+   case H_POLYGON:
+      for (const GPoint & pt : obj->vertices) {
+         path.push_back(t.apply(pt.getX(), pt.getY()));
+      }
+      return true;
+   case H_LABEL: {
+      double ascent = fontAscent(obj->fontSize);
+      double width = countChars(obj->text) * fontAdvance(obj->fontSize);
+      appendRect(path, t, 0, -ascent, width,
+                 ascent + fontDescent(obj->fontSize));
+      return true;
+   }
+   case H_COMPOUND:
+      return false;
+   default:
+      appendRect(path, t, 0, 0, obj->width, obj->height);
+      return true;
+   }
+}
+
+static void collectPoints(const HeadlessObject *obj, const Affine & t,
+                          vector<GPoint> & points) {
+   if (obj->type == H_COMPOUND) {
+      for (const HeadlessObject *child : obj->children) {
+         if (child->visible) {
+            collectPoints(child, t.compose(localTransform(child)), points);
+         }
+      }
+   } else {
+      getOutline(obj, t, points);
+   }
+}
+
+static bool insidePolygon(const vector<GPoint> & path, double x, double y) {
+   bool inside = false;
+   size_t n = path.size();
+   for (size_t i = 0, j = n - 1; i < n; j = i++) {
+      double xi = path[i].getX(), yi = path[i].getY();
+      double xj = path[j].getX(), yj = path[j].getY();
+      if ((yi > y) != (yj > y) && x < xi + (y - yi) * (xj - xi) / (yj - yi)) {
+         inside = !inside;
+      }
+   }
+   return inside;
+}
+
+static double distanceToPath(const vector<GPoint> & path, double x, double y) {
+   double best = INFINITY;
+   for (size_t i = 0; i + 1 < path.size(); i++) {
+      double x0 = path[i].getX(), y0 = path[i].getY();
+      double ux = path[i + 1].getX() - x0, uy = path[i + 1].getY() - y0;
+      double len2 = ux * ux + uy * uy;
+      double f = (len2 == 0) ? 0 : ((x - x0) * ux + (y - y0) * uy) / len2;
+      f = max(0.0, min(1.0, f));
+      best = min(best, hypot(x - x0 - f * ux, y - y0 - f * uy));
+   }
+   return best;
+}
+
+static bool containsPoint(const HeadlessObject *obj, const Affine & t,
+                          double x, double y) {
+   if (obj->type == H_COMPOUND) {
+      for (const HeadlessObject *child : obj->children) {
+         if (child->visible
+               && containsPoint(child, t.compose(localTransform(child)), x, y)) {
+            return true;
+         }
+      }
+      return false;
+   }
+   vector<GPoint> path;
+   if (getOutline(obj, t, path)) return insidePolygon(path, x, y);
+   double tolerance = (obj->type == H_LINE) ? LINE_TOLERANCE : ARC_TOLERANCE;
+   return distanceToPath(path, x, y) <= tolerance;
+}
+
+/* Rasterizer */
+
+static void plot(Grid<int> & canvas, int x, int y, int argb) {
+   if (y < 0 || y >= canvas.numRows() || x < 0 || x >= canvas.numCols()) {
+      return;
+   }
+   int alpha = (argb >> 24) & 0xFF;
+   if (alpha == 0xFF) {
+      canvas[y][x] = argb & 0xFFFFFF;
+   } else if (alpha != 0) {
+      int old = canvas[y][x];
+      int rgb = 0;
+      for (int shift = 0; shift < 24; shift += 8) {
+         int src = (argb >> shift) & 0xFF;
+         int dst = (old >> shift) & 0xFF;
+         rgb |= ((src * alpha + dst * (255 - alpha) + 127) / 255) << shift;
+      }
+      canvas[y][x] = rgb;
+   }
+}
+
+static void fillPath(Grid<int> & canvas, const vector<GPoint> & path,
+                     int argb) {
+   size_t n = path.size();
+   if (n < 3) return;
+   double ymin = INFINITY, ymax = -INFINITY;
+   for (const GPoint & pt : path) {
+      ymin = min(ymin, pt.getY());
+      ymax = max(ymax, pt.getY());
+   }
+   int row0 = max(0, (int) ceil(ymin - 0.5));
+   int row1 = min(canvas.numRows() - 1, (int) floor(ymax - 0.5));
+   vector<double> crossings;
+   for (int row = row0; row <= row1; row++) {
+      double cy = row + 0.5;
+      crossings.clear();
+      for (size_t i = 0, j = n - 1; i < n; j = i++) {
+         double yi = path[i].getY(), yj = path[j].getY();
+         if ((yi <= cy) != (yj <= cy)) {
+            double xi = path[i].getX(), xj = path[j].getX();
+            crossings.push_back(xi + (cy - yi) * (xj - xi) / (yj - yi));
+         }
+      }
+      sort(crossings.begin(), crossings.end());
+      for (size_t k = 0; k + 1 < crossings.size(); k += 2) {
+         int col0 = max(0, (int) ceil(crossings[k] - 0.5));
+         int col1 = min(canvas.numCols() - 1, (int) ceil(crossings[k + 1] - 0.5) - 1);
+         for (int col = col0; col <= col1; col++) {
+            plot(canvas, col, row, argb);
+         }
+      }
+   }
+}
+
+static void drawSegment(Grid<int> & canvas, const GPoint & p0, const GPoint & p1,
+                        int argb, double lineWidth) {
+   int x0 = (int) floor(p0.getX() + 0.5), y0 = (int) floor(p0.getY() + 0.5);
+   int x1 = (int) floor(p1.getX() + 0.5), y1 = (int) floor(p1.getY() + 0.5);
+   int size = max(1, (int) floor(lineWidth + 0.5));
+   int offset = size / 2;
+   int dx = abs(x1 - x0), sx = (x0 < x1) ? 1 : -1;
+   int dy = -abs(y1 - y0), sy = (y0 < y1) ? 1 : -1;
+   int err = dx + dy;
+   while (true) {
+      for (int i = 0; i < size; i++) {
+         for (int j = 0; j < size; j++) {
+            plot(canvas, x0 + j - offset, y0 + i - offset, argb);
+         }
+      }
+      if (x0 == x1 && y0 == y1) break;
+      int e2 = 2 * err;
+      if (e2 >= dy) {
+         err += dy;
+         x0 += sx;
+      }
+      if (e2 <= dx) {
+         err += dx;
+         y0 += sy;
+      }
+   }
+}
+
+static void strokePath(Grid<int> & canvas, const vector<GPoint> & path,
+                       bool closed, int argb, double lineWidth) {
+   size_t n = path.size();
+   for (size_t i = 0; i + 1 < n; i++) {
+      drawSegment(canvas, path[i], path[i + 1], argb, lineWidth);
+   }
+   if (closed && n > 2) drawSegment(canvas, path[n - 1], path[0], argb, lineWidth);
+}
+
+static void render(Grid<int> & canvas, const HeadlessObject *obj,
+                   const Affine & parent) {
+   if (!obj->visible) return;
+   int fillColor = (obj->hasFillColor) ? obj->fillColor : obj->color;
+   Affine t = parent.compose(localTransform(obj));
+   vector<GPoint> path;
+   switch (obj->type) {
+   case H_COMPOUND:
+      for (const HeadlessObject *child : obj->children) {
+         render(canvas, child, t);
+      }
+      break;
+   case H_INTERACTOR:
+      break;
+   case H_BUFFERED_IMAGE: {
+      GPoint origin = t.apply(0, 0);
+      int x0 = (int) floor(origin.getX() + 0.5);
+      int y0 = (int) floor(origin.getY() + 0.5);
+      for (int row = 0; row < obj->pixels.numRows(); row++) {
+         for (int col = 0; col < obj->pixels.numCols(); col++) {
+            plot(canvas, x0 + col, y0 + row, obj->pixels[row][col] | 0xFF000000);
+         }
+      }
+      break;
+   }
+   case H_LABEL: {
+      double advance = fontAdvance(obj->fontSize);
+      double top = -floor(0.7 * fontAscent(obj->fontSize) + 0.5);
+      int i = 0;
+      for (size_t k = 0; k < obj->text.length(); k++) {
+         if ((obj->text[k] & 0xC0) == 0x80) continue;
+         if (!isspace(obj->text[k])) {
+            path.clear();
+            appendRect(path, t, i * advance + 1, top, max(1.0, advance - 2), -top);
+            fillPath(canvas, path, obj->color);
+         }
+         i++;
+      }
+      break;
+   }
+   case H_ARC:
+      getOutline(obj, t, path);
+      if (obj->filled) {
+         fillPath(canvas, path, fillColor);
+         path.erase(path.begin());
+      }
+      strokePath(canvas, path, false, obj->color, obj->lineWidth);
+      break;
+   default: {
+      bool closed = getOutline(obj, t, path);
+      if (obj->filled && closed) fillPath(canvas, path, fillColor);
+      strokePath(canvas, path, closed, obj->color, obj->lineWidth);
+      break;
+   }
+   }
+}
+
+/* Scanning the arguments of a command */
+
+static string nextArg(TokenScanner & scanner) {
+   string token = scanner.nextToken();
+   while (token == "(" || token == "," || token == ")") {
+      token = scanner.nextToken();
+   }
+   if (token == "-") token += scanner.nextToken();
+   return token;
+}
+
+static string nextString(TokenScanner & scanner) {
+   string token = nextArg(scanner);
+   if (!token.empty() && token[0] == '"') return scanner.getStringValue(token);
+   return token;
+}
+
+static double nextDouble(TokenScanner & scanner) {
+   return strtod(nextArg(scanner).c_str(), NULL);
+}
+
+static int nextInt(TokenScanner & scanner) {
+   return (int) strtoll(nextArg(scanner).c_str(), NULL, 10);
+}
+
+static bool nextBoolean(TokenScanner & scanner) {
+   return nextArg(scanner) == "true";
+}
+
+static int parseColor(const string & name, int defaultColor) {
+   if (name.empty()) return defaultColor;
+   int argb = convertColorToRGB(name);
+   if (name[0] != '#') argb |= 0xFF000000;
+   return argb;
+}
+
+static string formatDimension(double width, double height) {
+   ostringstream os;
+   os << "GDimension(" << width << ", " << height << ")";
+   return os.str();
+}
+
+/* Implementation of HeadlessBackEnd */
+
+HeadlessBackEnd::HeadlessBackEnd() {
+   replyStart = 0;
+   now = (double) chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+}
+
+HeadlessBackEnd::~HeadlessBackEnd() {
+   for (string id : objects) {
+      delete objects[id];
+   }
+   for (string id : windows) {
+      delete windows[id];
+   }
+   for (string id : timers) {
+      delete timers[id];
+   }
+}
+
+void HeadlessBackEnd::sendCommands(const char *data, size_t length) {
+   const char *end = data + length;
+   while (data < end) {
+      const char *newline = (const char *) memchr(data, '\n', end - data);
+      if (newline == NULL) {
+         partialLine.append(data, end - data);
+         break;
+      }
+      partialLine.append(data, newline - data);
+      execute(partialLine);
+      partialLine.clear();
+      data = newline + 1;
+   }
+}
+
+size_t HeadlessBackEnd::readReplies(char *buffer, size_t size) {
+   size_t available = replies.length() - replyStart;
+   if (available == 0) error("HeadlessBackEnd: No reply is pending");
+   size_t n = min(size, available);
+   memcpy(buffer, replies.data() + replyStart, n);
+   replyStart += n;
+   if (replyStart == replies.length()) {
+      replies.clear();
+      replyStart = 0;
+   }
+   return n;
+}
+
+bool HeadlessBackEnd::repliesReady() {
+   return replyStart < replies.length();
+}
+
+void HeadlessBackEnd::terminate() {
+   /* Empty */
+}
+
+Grid<int> HeadlessBackEnd::getPixels(const string & windowId) {
+   if (!windows.containsKey(windowId)) {
+      error("HeadlessBackEnd::getPixels: No window with that id");
+   }
+   HeadlessWindow *hw = windows[windowId];
+   Grid<int> canvas = hw->background;
+   render(canvas, hw->top, Affine());
+   return canvas;
+}
+
+void HeadlessBackEnd::reply(const string & line) {
+   replies += line;
+   replies += '\n';
+}
+
+void HeadlessBackEnd::result(const string & value) {
+   reply("result:" + value);
+}
+
+HeadlessObject *HeadlessBackEnd::getObject(const string & id) {
+   return objects.get(id);
+}
+
+HeadlessObject *HeadlessBackEnd::createObject(const string & id, int type) {
+   if (objects.containsKey(id)) deleteObject(id);
+   HeadlessObject *obj = new HeadlessObject(type);
+   objects.put(id, obj);
+   return obj;
+}
+
+static void detach(HeadlessObject *obj) {
+   HeadlessObject *parent = obj->parent;
+   if (parent == NULL) return;
+   vector<HeadlessObject *> & siblings = parent->children;
+   siblings.erase(find(siblings.begin(), siblings.end(), obj));
+   obj->parent = NULL;
+}
+
+void HeadlessBackEnd::deleteObject(const string & id) {
+   HeadlessObject *obj = objects.get(id);
+   if (obj == NULL) return;
+   detach(obj);
+   for (HeadlessObject *child : obj->children) {
+      child->parent = NULL;
+   }
+   objects.remove(id);
+   delete obj;
+}
+
+/*
+ * Implementation notes: nextEvent
+ * -------------------------------
+ * Timers are the only source of events.  The earliest running timer that
+ * the mask allows ticks next, and the clock advances to its tick.  When
+ * no such timer exists, getNextEvent reports that no event is waiting,
+ * and waitForEvent ends the program the way closing the last window
+ * would, since nothing could ever wake it up.
+ */
+
+void HeadlessBackEnd::nextEvent(int mask, bool wait) {
+   string firstId;
+   HeadlessTimer *first = NULL;
+   if (mask & TIMER_EVENT) {
+      for (string id : timers) {
+         HeadlessTimer *timer = timers[id];
+         if (timer->running && (first == NULL || timer->next < first->next
+               || (timer->next == first->next && timer->serial < first->serial))) {
+            first = timer;
+            firstId = id;
+         }
+      }
+   }
+   if (first != NULL) {
+      now = max(now, first->next);
+      first->next = now + first->delay;
+      ostringstream os;
+      os << "event:timerTicked(\"" << firstId << "\", " << (long long) now << ")";
+      reply(os.str());
+      result("___jbe___ack___");
+   } else if (wait) {
+      reply("event:lastWindowClosed");
+   } else {
+      result("___jbe___ack___");
+   }
+}
+
+void HeadlessBackEnd::execute(const string & line) {
+   TokenScanner scanner(line);
+   scanner.ignoreWhitespace();
+   scanner.scanNumbers();
+   scanner.scanStrings();
+   scanner.addWordCharacters(".");
+   string cmd = scanner.nextToken();
+   if (startsWith(cmd, "GObject.")) {
+      string id = nextString(scanner);
+      HeadlessObject *obj = getObject(id);
+      if (obj == NULL) {
+         if (cmd == "GObject.getBounds" || cmd == "GObject.contains") {
+            reply("error:" + cmd + ": No object with that id");
+         }
+         return;
+      }
+      if (cmd == "GObject.setLocation") {
+         obj->x = nextDouble(scanner);
+         obj->y = nextDouble(scanner);
+      } else if (cmd == "GObject.setSize") {
+         obj->width = nextDouble(scanner);
+         obj->height = nextDouble(scanner);
+      } else if (cmd == "GObject.setColor") {
+         obj->color = parseColor(nextString(scanner), obj->color);
+      } else if (cmd == "GObject.setFillColor") {
+         string color = nextString(scanner);
+         obj->hasFillColor = !color.empty();
+         obj->fillColor = parseColor(color, obj->color);
+      } else if (cmd == "GObject.setFilled") {
+         obj->filled = nextBoolean(scanner);
+      } else if (cmd == "GObject.setVisible") {
+         obj->visible = nextBoolean(scanner);
+      } else if (cmd == "GObject.setLineWidth") {
+         obj->lineWidth = nextDouble(scanner);
+      } else if (cmd == "GObject.setState") {
+         int flags = nextInt(scanner);
+         if (flags & STATE_LOCATION) {
+            obj->x = nextDouble(scanner);
+            obj->y = nextDouble(scanner);
+         }
+         if (flags & STATE_SIZE) {
+            obj->width = nextDouble(scanner);
+            obj->height = nextDouble(scanner);
+         }
+         if (flags & STATE_COLOR) {
+            obj->color = parseColor(nextString(scanner), obj->color);
+         }
+         if (flags & STATE_FILL_COLOR) {
+            string color = nextString(scanner);
+            obj->hasFillColor = !color.empty();
+            obj->fillColor = parseColor(color, obj->color);
+         }
+         if (flags & STATE_FILLED) obj->filled = nextBoolean(scanner);
+         if (flags & STATE_VISIBLE) obj->visible = nextBoolean(scanner);
+         if (flags & STATE_LINE_WIDTH) obj->lineWidth = nextDouble(scanner);
+      } else if (cmd == "GObject.remove") {
+         detach(obj);
+      } else if (cmd == "GObject.delete") {
+         deleteObject(id);
+      } else if (cmd == "GObject.rotate" || cmd == "GObject.scale") {
+         double m[4];
+         if (cmd == "GObject.rotate") {
+            double theta = nextDouble(scanner) * M_PI / 180;
+            m[0] = m[3] = cos(theta);
+            m[1] = -sin(theta);
+            m[2] = sin(theta);
+         } else {
+            m[0] = nextDouble(scanner);
+            m[3] = nextDouble(scanner);
+            m[1] = m[2] = 0;
+         }
+         double *o = obj->matrix;
+         double r[4] = { o[0] * m[0] + o[2] * m[1], o[1] * m[0] + o[3] * m[1],
+                         o[0] * m[2] + o[2] * m[3], o[1] * m[2] + o[3] * m[3] };
+         copy(r, r + 4, o);
+      } else if (cmd == "GObject.sendToFront" || cmd == "GObject.sendToBack"
+                 || cmd == "GObject.sendForward" || cmd == "GObject.sendBackward") {
+         if (obj->parent == NULL) return;
+         vector<HeadlessObject *> & siblings = obj->parent->children;
+         size_t i = find(siblings.begin(), siblings.end(), obj) - siblings.begin();
+         if (cmd == "GObject.sendToFront") {
+            siblings.erase(siblings.begin() + i);
+            siblings.push_back(obj);
+         } else if (cmd == "GObject.sendToBack") {
+            siblings.erase(siblings.begin() + i);
+            siblings.insert(siblings.begin(), obj);
+         } else if (cmd == "GObject.sendForward") {
+            if (i + 1 < siblings.size()) swap(siblings[i], siblings[i + 1]);
+         } else if (i > 0) {
+            swap(siblings[i], siblings[i - 1]);
+         }
+      } else if (cmd == "GObject.getBounds") {
+         vector<GPoint> points;
+         collectPoints(obj, localTransform(obj), points);
+         double x0 = obj->x, y0 = obj->y, x1 = obj->x, y1 = obj->y;
+         if (!points.empty()) {
+            x0 = y0 = INFINITY;
+            x1 = y1 = -INFINITY;
+            for (const GPoint & pt : points) {
+               x0 = min(x0, pt.getX());
+               y0 = min(y0, pt.getY());
+               x1 = max(x1, pt.getX());
+               y1 = max(y1, pt.getY());
+            }
+         }
+         ostringstream os;
+         os << "GRectangle(" << x0 << ", " << y0 << ", " << (x1 - x0)
+            << ", " << (y1 - y0) << ")";
+         result(os.str());
+      } else if (cmd == "GObject.contains") {
+         double x = nextDouble(scanner);
+         double y = nextDouble(scanner);
+         result(containsPoint(obj, localTransform(obj), x, y) ? "true" : "false");
+      }
+   } else if (cmd == "GWindow.create") {
+      string id = nextString(scanner);
+      HeadlessWindow *hw = new HeadlessWindow;
+      hw->width = (int) nextDouble(scanner);
+      hw->height = (int) nextDouble(scanner);
+      hw->background.resize(hw->height, hw->width);
+      hw->background.fill(WHITE);
+      hw->top = createObject(nextString(scanner), H_COMPOUND);
+      if (windows.containsKey(id)) delete windows[id];
+      windows.put(id, hw);
+      result("ok");
+   } else if (cmd == "GWindow.delete" || cmd == "GWindow.close") {
+      string id = nextString(scanner);
+      if (windows.containsKey(id)) {
+         delete windows[id];
+         windows.remove(id);
+      }
+   } else if (cmd == "GWindow.clear") {
+      HeadlessWindow *hw = windows.get(nextString(scanner));
+      if (hw != NULL) hw->background.fill(WHITE);
+   } else if (cmd == "GWindow.draw") {
+      HeadlessWindow *hw = windows.get(nextString(scanner));
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (hw != NULL && obj != NULL) render(hw->background, obj, Affine());
+   } else if (cmd == "GWindow.drawLine" || cmd == "GWindow.drawRect"
+              || cmd == "GWindow.drawOval") {
+      HeadlessWindow *hw = windows.get(nextString(scanner));
+      if (hw == NULL) return;
+      HeadlessObject obj((cmd == "GWindow.drawLine") ? H_LINE
+                         : (cmd == "GWindow.drawRect") ? H_RECT : H_OVAL);
+      obj.x = nextDouble(scanner);
+      obj.y = nextDouble(scanner);
+      if (obj.type == H_LINE) {
+         obj.dx = nextDouble(scanner) - obj.x;
+         obj.dy = nextDouble(scanner) - obj.y;
+      } else {
+         obj.width = nextDouble(scanner);
+         obj.height = nextDouble(scanner);
+      }
+      obj.color = parseColor(nextString(scanner), obj.color);
+      if (obj.type != H_LINE) obj.filled = nextBoolean(scanner);
+      render(hw->background, &obj, Affine());
+   } else if (cmd == "GWindow.drawLines") {
+      HeadlessWindow *hw = windows.get(nextString(scanner));
+      if (hw == NULL) return;
+      int color = parseColor(nextString(scanner), 0xFF000000);
+      int n = nextInt(scanner);
+      vector<GPoint> path;
+      for (int i = 0; i < n; i++) {
+         double x = nextDouble(scanner);
+         double y = nextDouble(scanner);
+         path.push_back(GPoint(x, y));
+      }
+      strokePath(hw->background, path, false, color, 1);
+   } else if (cmd == "GWindow.getCanvasWidth" || cmd == "GWindow.getCanvasHeight") {
+      HeadlessWindow *hw = windows.get(nextString(scanner));
+      if (hw == NULL) {
+         reply("error:" + cmd + ": No window with that id");
+      } else {
+         int size = (cmd == "GWindow.getCanvasWidth") ? hw->width : hw->height;
+         result(integerToString(size));
+      }
+   } else if (cmd == "GWindow.getScreenWidth") {
+      result(integerToString(SCREEN_WIDTH));
+   } else if (cmd == "GWindow.getScreenHeight") {
+      result(integerToString(SCREEN_HEIGHT));
+   } else if (cmd == "GCompound.create") {
+      createObject(nextString(scanner), H_COMPOUND);
+   } else if (cmd == "GCompound.add") {
+      HeadlessObject *compound = getObject(nextString(scanner));
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (compound != NULL && obj != NULL) {
+         detach(obj);
+         compound->children.push_back(obj);
+         obj->parent = compound;
+      }
+   } else if (cmd == "GRect.create" || cmd == "GOval.create"
+              || cmd == "GRoundRect.create" || cmd == "G3DRect.create") {
+      string id = nextString(scanner);
+      int type = (cmd == "GRect.create") ? H_RECT
+               : (cmd == "GOval.create") ? H_OVAL
+               : (cmd == "GRoundRect.create") ? H_ROUND_RECT : H_3D_RECT;
+      HeadlessObject *obj = createObject(id, type);
+      obj->width = nextDouble(scanner);
+      obj->height = nextDouble(scanner);
+      if (type == H_ROUND_RECT) obj->corner = nextDouble(scanner);
+   } else if (cmd == "GArc.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_ARC);
+      obj->width = nextDouble(scanner);
+      obj->height = nextDouble(scanner);
+      obj->start = nextDouble(scanner);
+      obj->sweep = nextDouble(scanner);
+   } else if (cmd == "GArc.setStartAngle" || cmd == "GArc.setSweepAngle"
+              || cmd == "GArc.setFrameRectangle") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      if (cmd == "GArc.setStartAngle") {
+         obj->start = nextDouble(scanner);
+      } else if (cmd == "GArc.setSweepAngle") {
+         obj->sweep = nextDouble(scanner);
+      } else {
+         obj->x = nextDouble(scanner);
+         obj->y = nextDouble(scanner);
+         obj->width = nextDouble(scanner);
+         obj->height = nextDouble(scanner);
+      }
+   } else if (cmd == "GLine.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_LINE);
+      obj->x = nextDouble(scanner);
+      obj->y = nextDouble(scanner);
+      obj->dx = nextDouble(scanner) - obj->x;
+      obj->dy = nextDouble(scanner) - obj->y;
+   } else if (cmd == "GLine.setStartPoint" || cmd == "GLine.setEndPoint") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      double x = nextDouble(scanner);
+      double y = nextDouble(scanner);
+      if (cmd == "GLine.setStartPoint") {
+         obj->dx += obj->x - x;
+         obj->dy += obj->y - y;
+         obj->x = x;
+         obj->y = y;
+      } else {
+         obj->dx = x - obj->x;
+         obj->dy = y - obj->y;
+      }
+   } else if (cmd == "GPolygon.create") {
+      createObject(nextString(scanner), H_POLYGON);
+   } else if (cmd == "GPolygon.addVertex") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      double x = nextDouble(scanner);
+      double y = nextDouble(scanner);
+      obj->vertices.push_back(GPoint(x, y));
+   } else if (cmd == "GPolygon.addVertices") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      int n = nextInt(scanner);
+      for (int i = 0; i < n; i++) {
+         double x = nextDouble(scanner);
+         double y = nextDouble(scanner);
+         obj->vertices.push_back(GPoint(x, y));
+      }
+   } else if (cmd == "GLabel.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_LABEL);
+      obj->text = nextString(scanner);
+   } else if (cmd == "GLabel.setLabel" || cmd == "GLabel.setFont") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      if (cmd == "GLabel.setLabel") {
+         obj->text = nextString(scanner);
+      } else {
+         obj->fontSize = parseFontSize(nextString(scanner));
+      }
+   } else if (cmd == "GLabel.getFontAscent" || cmd == "GLabel.getFontDescent"
+              || cmd == "GLabel.getGLabelSize") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) {
+         reply("error:" + cmd + ": No label with that id");
+      } else if (cmd == "GLabel.getFontAscent") {
+         result(integerToString(fontAscent(obj->fontSize)));
+      } else if (cmd == "GLabel.getFontDescent") {
+         result(integerToString(fontDescent(obj->fontSize)));
+      } else {
+         result(formatDimension(countChars(obj->text) * fontAdvance(obj->fontSize),
+                                fontAscent(obj->fontSize) + fontDescent(obj->fontSize)));
+      }
+   } else if (cmd == "GLabel.getFontMetrics") {
+      double size = parseFontSize(nextString(scanner));
+      ostringstream os;
+      os << fontAscent(size) << " " << fontDescent(size) << " "
+         << fontAscent(size) + fontDescent(size);
+      for (int ch = FIRST_FONT_CHAR; ch <= LAST_FONT_CHAR; ch++) {
+         os << " " << fontAdvance(size);
+      }
+      result(os.str());
+   } else if (cmd == "GImage.create") {
+      reply("error:GImage.create: Images require the Java back end");
+   } else if (cmd == "GBufferedImage.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_BUFFERED_IMAGE);
+      obj->x = nextDouble(scanner);
+      obj->y = nextDouble(scanner);
+      obj->width = nextInt(scanner);
+      obj->height = nextInt(scanner);
+      obj->background = nextInt(scanner) & 0xFFFFFF;
+      obj->pixels.resize((int) obj->height, (int) obj->width);
+      obj->pixels.fill(obj->background);
+   } else if (startsWith(cmd, "GBufferedImage.")) {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL || obj->type != H_BUFFERED_IMAGE) {
+         reply("error:" + cmd + ": invalid GBufferedImage");
+      } else if (cmd == "GBufferedImage.updateRegion") {
+         int x = nextInt(scanner);
+         int y = nextInt(scanner);
+         int width = nextInt(scanner);
+         int height = nextInt(scanner);
+         string data = Base64::decode(nextString(scanner));
+         for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+               size_t i = 3 * (row * width + col);
+               if (i + 3 > data.length()) return;
+               if (obj->pixels.inBounds(y + row, x + col)) {
+                  obj->pixels[y + row][x + col] = (unsigned char) data[i] << 16
+                                                | (unsigned char) data[i + 1] << 8
+                                                | (unsigned char) data[i + 2];
+               }
+            }
+         }
+      } else if (cmd == "GBufferedImage.updateRegions") {
+         int count = nextInt(scanner);
+         vector<int> rects;
+         for (int i = 0; i < 4 * count; i++) {
+            rects.push_back(nextInt(scanner));
+         }
+         string data = Base64::decode(nextString(scanner));
+         size_t i = 0;
+         for (int k = 0; k < count; k++) {
+            int x = rects[4 * k];
+            int y = rects[4 * k + 1];
+            for (int row = 0; row < rects[4 * k + 3]; row++) {
+               for (int col = 0; col < rects[4 * k + 2]; col++) {
+                  if (i + 3 > data.length()) return;
+                  if (obj->pixels.inBounds(y + row, x + col)) {
+                     obj->pixels[y + row][x + col] = (unsigned char) data[i] << 16
+                                                   | (unsigned char) data[i + 1] << 8
+                                                   | (unsigned char) data[i + 2];
+                  }
+                  i += 3;
+               }
+            }
+         }
+      } else if (cmd == "GBufferedImage.fill") {
+         obj->pixels.fill(nextInt(scanner) & 0xFFFFFF);
+      } else if (cmd == "GBufferedImage.fillRegion") {
+         int x = nextInt(scanner);
+         int y = nextInt(scanner);
+         int width = nextInt(scanner);
+         int height = nextInt(scanner);
+         int rgb = nextInt(scanner) & 0xFFFFFF;
+         for (int row = max(0, y); row < min(y + height, obj->pixels.numRows()); row++) {
+            for (int col = max(0, x); col < min(x + width, obj->pixels.numCols()); col++) {
+               obj->pixels[row][col] = rgb;
+            }
+         }
+      } else if (cmd == "GBufferedImage.resize") {
+         obj->width = nextInt(scanner);
+         obj->height = nextInt(scanner);
+         bool retain = nextBoolean(scanner);
+         obj->pixels.resize((int) obj->height, (int) obj->width, retain);
+         if (!retain) obj->pixels.fill(obj->background);
+      } else if (cmd == "GBufferedImage.load") {
+         reply("error:GBufferedImage.load: Images require the Java back end");
+      } else if (cmd == "GBufferedImage.save") {
+         result("GBufferedImage.save: Images require the Java back end");
+      }
+   } else if (cmd == "GButton.create" || cmd == "GCheckBox.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_INTERACTOR);
+      obj->text = nextString(scanner);
+      obj->width = countChars(obj->text) * fontAdvance(DEFAULT_FONT_SIZE) + 32;
+      obj->height = 26;
+   } else if (cmd == "GSlider.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_INTERACTOR);
+      nextInt(scanner);
+      nextInt(scanner);
+      obj->value = nextInt(scanner);
+      obj->width = 200;
+      obj->height = 16;
+   } else if (cmd == "GTextField.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_INTERACTOR);
+      obj->width = nextInt(scanner) * fontAdvance(DEFAULT_FONT_SIZE) + 6;
+      obj->height = 20;
+   } else if (cmd == "GChooser.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_INTERACTOR);
+      obj->width = 120;
+      obj->height = 24;
+   } else if (cmd == "GTextArea.create") {
+      HeadlessObject *obj = createObject(nextString(scanner), H_INTERACTOR);
+      obj->width = nextDouble(scanner);
+      obj->height = nextDouble(scanner);
+   } else if (cmd == "GInteractor.getSize" || cmd == "GCheckBox.isSelected"
+              || cmd == "GSlider.getValue" || cmd == "GTextField.getText"
+              || cmd == "GTextArea.getText" || cmd == "GChooser.getSelectedItem") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) {
+         reply("error:" + cmd + ": No interactor with that id");
+      } else if (cmd == "GInteractor.getSize") {
+         result(formatDimension(obj->width, obj->height));
+      } else if (cmd == "GCheckBox.isSelected") {
+         result(obj->selected ? "true" : "false");
+      } else if (cmd == "GSlider.getValue") {
+         result(integerToString(obj->value));
+      } else if (cmd == "GTextArea.getText") {
+         result(Base64::encode(obj->text));
+      } else {
+         result(obj->text);
+      }
+   } else if (cmd == "GCheckBox.setSelected" || cmd == "GSlider.setValue"
+              || cmd == "GTextField.setText" || cmd == "GTextArea.setText"
+              || cmd == "GChooser.addItem" || cmd == "GChooser.setSelectedItem") {
+      HeadlessObject *obj = getObject(nextString(scanner));
+      if (obj == NULL) return;
+      if (cmd == "GCheckBox.setSelected") {
+         obj->selected = nextBoolean(scanner);
+      } else if (cmd == "GSlider.setValue") {
+         obj->value = nextInt(scanner);
+      } else if (cmd == "GChooser.addItem") {
+         obj->items.add(nextString(scanner));
+         if (obj->items.size() == 1) obj->text = obj->items[0];
+      } else {
+         obj->text = nextString(scanner);
+      }
+   } else if (cmd == "GTimer.create") {
+      string id = nextString(scanner);
+      HeadlessTimer *timer = timers.get(id);
+      if (timer == NULL) {
+         timer = new HeadlessTimer;
+         timers.put(id, timer);
+      }
+      timer->delay = nextDouble(scanner);
+      timer->running = false;
+      timer->serial = timers.size();
+   } else if (cmd == "GTimer.startTimer" || cmd == "GTimer.stopTimer") {
+      HeadlessTimer *timer = timers.get(nextString(scanner));
+      if (timer == NULL) return;
+      timer->running = cmd == "GTimer.startTimer";
+      timer->next = now + timer->delay;
+   } else if (cmd == "GTimer.deleteTimer") {
+      string id = nextString(scanner);
+      if (timers.containsKey(id)) {
+         delete timers[id];
+         timers.remove(id);
+      }
+   } else if (cmd == "GTimer.pause") {
+      now += nextDouble(scanner);
+      result("ok");
+   } else if (cmd == "GEvent.getNextEvent" || cmd == "GEvent.waitForEvent") {
+      nextEvent(nextInt(scanner), cmd == "GEvent.waitForEvent");
+   } else if (cmd == "JBEConsole.print") {
+      string str = nextString(scanner);
+      FILE *out = (nextArg(scanner) == "true") ? stderr : stdout;
+      fputs(str.c_str(), out);
+      fflush(out);
+   } else if (cmd == "JBEConsole.println") {
+      fputs("\n", stdout);
+      fflush(stdout);
+   } else if (cmd == "JBEConsole.getLine") {
+      string str;
+      int ch;
+      while ((ch = getc(stdin)) != EOF && ch != '\n') {
+         str += char(ch);
+      }
+      result(str);
+   } else if (cmd == "JBE.setProtocol") {
+      result("text");
+   } else if (cmd == "Sound.create") {
+      result("ok");
+   } else if (cmd == "File.openFileDialog" || cmd == "GOptionPane.showInputDialog"
+              || cmd == "GOptionPane.showMessageDialog") {
+      result("");
+   } else if (cmd == "GOptionPane.showConfirmDialog"
+              || cmd == "GOptionPane.showOptionDialog") {
+      result("-1");
+   }
+}
@@ -0,0 +1,84 @@
+/**
+ * @file headless.h
+ *
+ * @brief
+ * This file exports functions for programs that run with the headless
+ * back end, which draws graphics windows in memory instead of on the
+ * screen.
+ *
+ * The headless back end is selected by setting the environment variable
+ * <code>JBEBACKEND</code> to <code>headless</code> before the program
+ * starts.  It needs neither Java nor a display, which makes it suitable
+ * for automated tests and benchmarks of graphical programs.  Console
+ * output goes to standard output and console input comes from standard
+ * input.  There is no user, so dialogs return as if they had been
+ * cancelled, and time passes only when the program pauses or waits for
+ * an event, at which point the next timer event arrives at once.  A
+ * program that waits for an event that can never occur exits as if its
+ * last window had been closed.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _headless_h
+#define _headless_h
+
+#include <string>
+#include "grid.h"
+#include "gwindow.h"
+
+/**
+ * Returns <code>true</code> if the program is running with the headless
+ * back end.
+ *
+ * Sample usage:
+ *
+ *     if (isHeadless()) ...
+ */
+bool isHeadless();
+
+
+/**
+ * Returns the contents of the canvas of the window <code>gw</code> as a
+ * grid of <code>0xrrggbb</code> values, indexed by row and column.  The
+ * canvas shows what the program has drawn on the window and the objects
+ * it contains.  Interactors are not drawn, and labels are drawn as one
+ * solid block per character, which shows where text is but not what it
+ * says.  This function is available only with the headless back end.
+ *
+ * Sample usage:
+ *
+ *     Grid<int> pixels = getWindowPixels(gw);
+ */
+Grid<int> getWindowPixels(const GWindow & gw);
+
+
+/**
+ * Writes the contents of the canvas of the window <code>gw</code>, as
+ * returned by \ref getWindowPixels, to the specified file in binary
+ * PPM format.  This function is available only with the headless back
+ * end.
+ *
+ * Sample usage:
+ *
+ *     saveWindowImage(gw, filename);
+ */
+void saveWindowImage(const GWindow & gw, std::string filename);
+
+#endif
@@ -0,0 +1,1133 @@
+/*
+ * File: imagecodec.cpp
+ * --------------------
+ * This file implements the image codecs declared in private/imagecodec.h.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "error.h"
+#include "filelib.h"
+#include "strlib.h"
+#include "private/imagecodec.h"
+using namespace std;
+
+/* Private section */
+
+/*
+ * Implementation notes: image codecs
+ * ----------------------------------
+ * The decoders accept the forms of each format that image programs
+ * commonly write:
+ *
+ *  - PNG files of every color type and bit depth, interlaced or not.
+ *    Ancillary chunks are skipped after their checksums are verified.
+ *  - PPM and PGM files in both the plain (P3, P2) and the raw (P6, P5)
+ *    forms, with sample values up to 65535.
+ *  - BMP files with a core or info header, at 1, 4, 8, 16, 24, or 32
+ *    bits per pixel, uncompressed or with bit-field masks.  Run-length
+ *    compressed files are rejected.
+ *
+ * The encoders write 8-bit RGB PNG files, raw PPM (P6) files, and 24-bit
+ * uncompressed BMP files.  Each PNG row is filtered with the filter that
+ * minimizes the sum of the absolute values of the filtered bytes, and
+ * the filtered data is compressed with LZ77 matching over hash chains and
+ * the fixed Huffman codes of deflate, which costs some compression
+ * against zlib but keeps the code small.
+ *
+ * The inflater follows RFC 1951.  It keeps up to 64 bits of input in a
+ * buffer and decodes Huffman codes of up to FAST_BITS bits with a single
+ * table lookup, falling back on the canonical-code loop only for longer
+ * codes.
+ */
+
+static const int MAX_PIXELS = 1 << 28;
+
+static void decodeError(const string & msg) {
+   error("GBufferedImage::load: " + msg);
+}
+
+static int checkSize(int64_t width, int64_t height, const string & format) {
+   if (width <= 0 || height <= 0) decodeError(format + " image has no pixels");
+   if (width * height > MAX_PIXELS) decodeError(format + " image is too large");
+   return (int) (width * height);
+}
+
+static uint32_t getInt32BE(const unsigned char *p) {
+   return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+        | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static uint32_t getInt32LE(const unsigned char *p) {
+   return ((uint32_t) p[3] << 24) | ((uint32_t) p[2] << 16)
+        | ((uint32_t) p[1] << 8) | p[0];
+}
+
+static int getInt16LE(const unsigned char *p) {
+   return (p[1] << 8) | p[0];
+}
+
+static void putInt32BE(string & out, uint32_t n) {
+   out += char(n >> 24);
+   out += char(n >> 16);
+   out += char(n >> 8);
+   out += char(n);
+}
+
+static void putInt32LE(string & out, uint32_t n) {
+   out += char(n);
+   out += char(n >> 8);
+   out += char(n >> 16);
+   out += char(n >> 24);
+}
+
+static void putInt16LE(string & out, int n) {
+   out += char(n);
+   out += char(n >> 8);
+}
+
+/* Tables from RFC 1951 */
+
+static const short LENGTH_BASE[29] = {
+   3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const short LENGTH_EXTRA[29] = {
+   0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short DIST_BASE[30] = {
+   1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+   257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+   8193, 12289, 16385, 24577
+};
+
+static const short DIST_EXTRA[30] = {
+   0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const short CODE_LENGTH_ORDER[19] = {
+   16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static const int MAX_CODE_BITS = 15;
+static const int FAST_BITS = 10;
+
+/*
+ * Class: Huffman
+ * --------------
+ * A canonical Huffman code built from a list of code lengths.  The fast
+ * table is indexed by the next FAST_BITS bits of input, in the order in
+ * which they arrive, and holds (length << 9) | symbol for the codes that
+ * fit, or 0 for the longer ones.
+ */
+
+struct Huffman {
+   short count[MAX_CODE_BITS + 1];
+   short symbol[288];
+   unsigned short fast[1 << FAST_BITS];
+
+   void build(const short *lengths, int n) {
+      memset(count, 0, sizeof count);
+      memset(fast, 0, sizeof fast);
+      for (int i = 0; i < n; i++) {
+         count[lengths[i]]++;
+      }
+      count[0] = 0;
+      int left = 1;
+      for (int len = 1; len <= MAX_CODE_BITS; len++) {
+         left = 2 * left - count[len];
+         if (left < 0) decodeError("PNG data is damaged (bad Huffman code)");
+      }
+      short offset[MAX_CODE_BITS + 2];
+      int next[MAX_CODE_BITS + 1];
+      offset[1] = 0;
+      next[1] = 0;
+      for (int len = 1; len < MAX_CODE_BITS; len++) {
+         offset[len + 1] = offset[len] + count[len];
+         next[len + 1] = (next[len] + count[len]) << 1;
+      }
+      for (int sym = 0; sym < n; sym++) {
+         int len = lengths[sym];
+         if (len == 0) continue;
+         symbol[offset[len]++] = sym;
+         int code = next[len]++;
+         if (len <= FAST_BITS) {
+            int reversed = 0;
+            for (int i = 0; i < len; i++) {
+               reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            for (int i = reversed; i < (1 << FAST_BITS); i += 1 << len) {
+               fast[i] = (unsigned short) ((len << 9) | sym);
+            }
+         }
+      }
+   }
+};
+
+/*
+ * Class: Inflater
+ * ---------------
+ * Decompresses a deflate stream, appending the result to a string.  The
+ * stream is rejected as soon as the output would grow past the limit,
+ * which a PNG decoder knows from the image header.
+ */
+
+class Inflater {
+public:
+   Inflater(const unsigned char *data, size_t size, size_t limit) {
+      this->data = data;
+      this->size = size;
+      this->limit = limit;
+      pos = 0;
+      bitBuffer = 0;
+      bitCount = 0;
+   }
+
+   void inflate(string & out) {
+      bool last;
+      do {
+         last = bits(1) != 0;
+         int type = bits(2);
+         if (type == 0) {
+            stored(out);
+         } else if (type == 1) {
+            static Huffman fixedLit, fixedDist;
+            static bool initialized = false;
+            if (!initialized) {
+               short lengths[288];
+               for (int i = 0; i < 288; i++) {
+                  lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+               }
+               fixedLit.build(lengths, 288);
+               for (int i = 0; i < 30; i++) {
+                  lengths[i] = 5;
+               }
+               fixedDist.build(lengths, 30);
+               initialized = true;
+            }
+            codes(out, fixedLit, fixedDist);
+         } else if (type == 2) {
+            dynamic(out);
+         } else {
+            damaged();
+         }
+      } while (!last);
+   }
+
+private:
+   const unsigned char *data;
+   size_t size;
+   size_t limit;
+   size_t pos;
+   uint64_t bitBuffer;
+   int bitCount;
+
+   static void damaged() {
+      decodeError("PNG data is damaged (bad compressed data)");
+   }
+
+   static void tooLong() {
+      decodeError("PNG data is damaged (too much image data)");
+   }
+
+   void refill() {
+      while (bitCount <= 56 && pos < size) {
+         bitBuffer |= (uint64_t) data[pos++] << bitCount;
+         bitCount += 8;
+      }
+   }
+
+   int bits(int n) {
+      if (bitCount < n) {
+         refill();
+         if (bitCount < n) damaged();
+      }
+      int value = (int) (bitBuffer & ((1u << n) - 1));
+      bitBuffer >>= n;
+      bitCount -= n;
+      return value;
+   }
+
+   int decode(const Huffman & h) {
+      if (bitCount < MAX_CODE_BITS) refill();
+      int entry = h.fast[bitBuffer & ((1 << FAST_BITS) - 1)];
+      if (entry != 0 && (entry >> 9) <= bitCount) {
+         bitBuffer >>= entry >> 9;
+         bitCount -= entry >> 9;
+         return entry & 511;
+      }
+      int code = 0;
+      int first = 0;
+      int index = 0;
+      for (int len = 1; len <= MAX_CODE_BITS; len++) {
+         code |= bits(1);
+         int count = h.count[len];
+         if (code - count < first) return h.symbol[index + (code - first)];
+         index += count;
+         first = (first + count) << 1;
+         code <<= 1;
+      }
+      damaged();
+      return 0;
+   }
+
+   void stored(string & out) {
+      bits(bitCount & 7);
+      int length = bits(16);
+      if (bits(16) != (~length & 0xFFFF)) damaged();
+      if (out.length() + length > limit) tooLong();
+      while (length > 0 && bitCount >= 8) {
+         out += char(bits(8));
+         length--;
+      }
+      if ((size_t) length > size - pos) damaged();
+      out.append((const char *) data + pos, length);
+      pos += length;
+   }
+
+   void codes(string & out, const Huffman & lit, const Huffman & dist) {
+      while (true) {
+         int sym = decode(lit);
+         if (sym < 256) {
+            if (out.length() >= limit) tooLong();
+            out += char(sym);
+         } else if (sym == 256) {
+            return;
+         } else {
+            sym -= 257;
+            if (sym >= 29) damaged();
+            int length = LENGTH_BASE[sym] + bits(LENGTH_EXTRA[sym]);
+            int d = decode(dist);
+            if (d >= 30) damaged();
+            size_t distance = DIST_BASE[d] + bits(DIST_EXTRA[d]);
+            size_t end = out.length();
+            if (distance > end) damaged();
+            if (end + length > limit) tooLong();
+            out.resize(end + length);
+            char *p = &out[0];
+            for (int i = 0; i < length; i++) {
+               p[end + i] = p[end - distance + i];
+            }
+         }
+      }
+   }
+
+   void dynamic(string & out) {
+      int nlen = bits(5) + 257;
+      int ndist = bits(5) + 1;
+      int ncode = bits(4) + 4;
+      if (nlen > 286 || ndist > 30) damaged();
+      short lengths[320];
+      memset(lengths, 0, sizeof lengths);
+      for (int i = 0; i < ncode; i++) {
+         lengths[CODE_LENGTH_ORDER[i]] = bits(3);
+      }
+      Huffman lencode;
+      lencode.build(lengths, 19);
+      int index = 0;
+      while (index < nlen + ndist) {
+         int sym = decode(lencode);
+         if (sym < 16) {
+            lengths[index++] = sym;
+         } else {
+            int len = 0;
+            int repeat;
+            if (sym == 16) {
+               if (index == 0) damaged();
+               len = lengths[index - 1];
+               repeat = 3 + bits(2);
+            } else if (sym == 17) {
+               repeat = 3 + bits(3);
+            } else {
+               repeat = 11 + bits(7);
+            }
+            if (index + repeat > nlen + ndist) damaged();
+            while (repeat-- > 0) {
+               lengths[index++] = len;
+            }
+         }
+      }
+      if (lengths[256] == 0) damaged();
+      Huffman lit, dist;
+      lit.build(lengths, nlen);
+      dist.build(lengths + nlen, ndist);
+      codes(out, lit, dist);
+   }
+};
+
+/*
+ * Function: crc32
+ * Usage: crc = crc32(crc, data, length);
+ * --------------------------------------
+ * Updates a PNG chunk checksum with the specified bytes.
+ */
+
+static uint32_t crc32(uint32_t crc, const char *data, size_t length) {
+   static uint32_t table[256];
+   static bool initialized = false;
+   if (!initialized) {
+      for (uint32_t n = 0; n < 256; n++) {
+         uint32_t c = n;
+         for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+         }
+         table[n] = c;
+      }
+      initialized = true;
+   }
+   crc = ~crc;
+   for (size_t i = 0; i < length; i++) {
+      crc = table[(crc ^ (unsigned char) data[i]) & 0xFF] ^ (crc >> 8);
+   }
+   return ~crc;
+}
+
+/*
+ * Function: adler32
+ * Usage: checksum = adler32(data);
+ * --------------------------------
+ * Returns the zlib checksum of data.
+ */
+
+static uint32_t adler32(const string & data) {
+   uint32_t a = 1;
+   uint32_t b = 0;
+   size_t i = 0;
+   while (i < data.length()) {
+      size_t end = min(data.length(), i + 5552);
+      for (; i < end; i++) {
+         a += (unsigned char) data[i];
+         b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+   }
+   return (b << 16) | a;
+}
+
+/*
+ * Class: BitWriter
+ * ----------------
+ * Accumulates a deflate stream, in which bits are packed starting with
+ * the least significant bit of each byte.
+ */
+
+class BitWriter {
+public:
+   BitWriter(string & out) : out(out) {
+      bitBuffer = 0;
+      bitCount = 0;
+   }
+
+   void write(uint32_t value, int n) {
+      bitBuffer |= (uint64_t) value << bitCount;
+      bitCount += n;
+      while (bitCount >= 8) {
+         out += char(bitBuffer);
+         bitBuffer >>= 8;
+         bitCount -= 8;
+      }
+   }
+
+   void finish() {
+      if (bitCount > 0) out += char(bitBuffer);
+      bitBuffer = 0;
+      bitCount = 0;
+   }
+
+private:
+   string & out;
+   uint64_t bitBuffer;
+   int bitCount;
+};
+
+/*
+ * Function: deflate
+ * Usage: deflate(out, data);
+ * --------------------------
+ * Appends a zlib stream holding data to out.  The stream is a single
+ * block with the fixed Huffman codes.  Matches are found through hash
+ * chains over three-byte prefixes; at most MAX_CHAIN earlier positions
+ * are tried at each point, and the longest match wins.
+ */
+
+static const int WINDOW_SIZE = 32768;
+static const int HASH_BITS = 15;
+static const int MAX_CHAIN = 32;
+static const int MIN_MATCH = 3;
+static const int MAX_MATCH = 258;
+
+static void deflate(string & out, const string & data) {
+   static uint32_t litCode[288];
+   static int litBits[288];
+   static bool initialized = false;
+   if (!initialized) {
+      for (int sym = 0; sym < 288; sym++) {
+         int code, len;
+         if (sym < 144) {
+            code = 0x30 + sym;
+            len = 8;
+         } else if (sym < 256) {
+            code = 0x190 + sym - 144;
+            len = 9;
+         } else if (sym < 280) {
+            code = sym - 256;
+            len = 7;
+         } else {
+            code = 0xC0 + sym - 280;
+            len = 8;
+         }
+         uint32_t reversed = 0;
+         for (int i = 0; i < len; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+         }
+         litCode[sym] = reversed;
+         litBits[sym] = len;
+      }
+      initialized = true;
+   }
+   out += char(0x78);
+   out += char(0x9C);
+   BitWriter writer(out);
+   writer.write(1, 1);
+   writer.write(1, 2);
+   const unsigned char *p = (const unsigned char *) data.data();
+   int n = (int) data.length();
+   vector<int> head(1 << HASH_BITS, -1);
+   vector<int> prev(WINDOW_SIZE, -1);
+   int i = 0;
+   while (i < n) {
+      int bestLength = 0;
+      int bestDistance = 0;
+      if (i + MIN_MATCH <= n) {
+         uint32_t hash = ((p[i] << 16) | (p[i + 1] << 8) | p[i + 2]) * 2654435761u
+                         >> (32 - HASH_BITS);
+         int limit = min(MAX_MATCH, n - i);
+         int candidate = head[hash];
+         for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN; chain++) {
+            if (i - candidate > WINDOW_SIZE) break;
+            if (p[candidate + bestLength] == p[i + bestLength]) {
+               int len = 0;
+               while (len < limit && p[candidate + len] == p[i + len]) {
+                  len++;
+               }
+               if (len > bestLength) {
+                  bestLength = len;
+                  bestDistance = i - candidate;
+                  if (len == limit) break;
+               }
+            }
+            candidate = prev[candidate % WINDOW_SIZE];
+         }
+         prev[i % WINDOW_SIZE] = head[hash];
+         head[hash] = i;
+      }
+      if (bestLength >= MIN_MATCH) {
+         int code = 28;
+         while (LENGTH_BASE[code] > bestLength) {
+            code--;
+         }
+         writer.write(litCode[257 + code], litBits[257 + code]);
+         writer.write(bestLength - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+         int dcode = 29;
+         while (DIST_BASE[dcode] > bestDistance) {
+            dcode--;
+         }
+         uint32_t reversed = 0;
+         for (int b = 0; b < 5; b++) {
+            reversed = (reversed << 1) | ((dcode >> b) & 1);
+         }
+         writer.write(reversed, 5);
+         writer.write(bestDistance - DIST_BASE[dcode], DIST_EXTRA[dcode]);
+         int end = i + bestLength;
+         for (i++; i < end; i++) {
+            if (i + MIN_MATCH <= n) {
+               uint32_t hash = ((p[i] << 16) | (p[i + 1] << 8) | p[i + 2]) * 2654435761u
+                               >> (32 - HASH_BITS);
+               prev[i % WINDOW_SIZE] = head[hash];
+               head[hash] = i;
+            }
+         }
+      } else {
+         writer.write(litCode[p[i]], litBits[p[i]]);
+         i++;
+      }
+   }
+   writer.write(litCode[256], litBits[256]);
+   writer.finish();
+   putInt32BE(out, adler32(data));
+}
+
+/* PNG */
+
+static const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1A\n";
+
+static int paeth(int a, int b, int c) {
+   int p = a + b - c;
+   int pa = abs(p - a);
+   int pb = abs(p - b);
+   int pc = abs(p - c);
+   if (pa <= pb && pa <= pc) return a;
+   return (pb <= pc) ? b : c;
+}
+
+static void unfilter(int type, unsigned char *row, const unsigned char *prev,
+                     int length, int bpp) {
+   switch (type) {
+   case 0:
+      break;
+   case 1:
+      for (int i = bpp; i < length; i++) {
+         row[i] += row[i - bpp];
+      }
+      break;
+   case 2:
+      for (int i = 0; i < length; i++) {
+         row[i] += prev[i];
+      }
+      break;
+   case 3:
+      for (int i = 0; i < length; i++) {
+         row[i] += ((i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1;
+      }
+      break;
+   case 4:
+      for (int i = 0; i < length; i++) {
+         row[i] += (i >= bpp) ? paeth(row[i - bpp], prev[i], prev[i - bpp])
+                              : paeth(0, prev[i], 0);
+      }
+      break;
+   default:
+      decodeError("PNG data is damaged (bad filter type)");
+   }
+}
+
+static int getSample(const unsigned char *row, int index, int depth) {
+   switch (depth) {
+   case 8:
+      return row[index];
+   case 16:
+      return row[2 * index];
+   default:
+      int bit = index * depth;
+      int value = (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+      return value * 255 / ((1 << depth) - 1);
+   }
+}
+
+static void decodePNG(const string & data, Grid<int> & pixels) {
+   const unsigned char *bytes = (const unsigned char *) data.data();
+   size_t pos = 8;
+   int width = 0;
+   int height = 0;
+   int depth = 0;
+   int colorType = -1;
+   int interlace = 0;
+   vector<int> palette;
+   string compressed;
+   while (pos + 12 <= data.length()) {
+      uint32_t length = getInt32BE(bytes + pos);
+      string type = data.substr(pos + 4, 4);
+      const unsigned char *chunk = bytes + pos + 8;
+      if (length > data.length() - pos - 12) {
+         decodeError("PNG data is damaged (truncated " + type + " chunk)");
+      }
+      if (crc32(0, data.data() + pos + 4, length + 4) != getInt32BE(chunk + length)) {
+         decodeError("PNG data is damaged (bad checksum in " + type + " chunk)");
+      }
+      if (type == "IHDR") {
+         if (length < 13) decodeError("PNG data is damaged (short header)");
+         checkSize(getInt32BE(chunk), getInt32BE(chunk + 4), "PNG");
+         width = getInt32BE(chunk);
+         height = getInt32BE(chunk + 4);
+         depth = chunk[8];
+         colorType = chunk[9];
+         interlace = chunk[12];
+         bool valid;
+         switch (colorType) {
+         case 0: valid = depth == 1 || depth == 2 || depth == 4 || depth == 8
+                         || depth == 16; break;
+         case 3: valid = depth == 1 || depth == 2 || depth == 4 || depth == 8; break;
+         case 2: case 4: case 6: valid = depth == 8 || depth == 16; break;
+         default: valid = false; break;
+         }
+         if (!valid || chunk[10] != 0 || chunk[11] != 0 || interlace > 1) {
+            decodeError("PNG format variant is not supported");
+         }
+      } else if (type == "PLTE") {
+         palette.clear();
+         for (uint32_t i = 0; i + 3 <= length; i += 3) {
+            palette.push_back((chunk[i] << 16) | (chunk[i + 1] << 8) | chunk[i + 2]);
+         }
+      } else if (type == "IDAT") {
+         compressed.append((const char *) chunk, length);
+      } else if (type == "IEND") {
+         break;
+      }
+      pos += length + 12;
+   }
+   if (colorType < 0) decodeError("PNG data is damaged (missing header)");
+   if (colorType == 3 && palette.empty()) {
+      decodeError("PNG data is damaged (missing palette)");
+   }
+   if (compressed.length() < 2 || (((unsigned char) compressed[0] << 8)
+                                   | (unsigned char) compressed[1]) % 31 != 0
+                               || (compressed[0] & 0x0F) != 8 || (compressed[1] & 0x20)) {
+      decodeError("PNG data is damaged (bad zlib header)");
+   }
+   int channels = (colorType == 2) ? 3 : (colorType == 4) ? 2 : (colorType == 6) ? 4 : 1;
+   int bitsPerPixel = channels * depth;
+   int bpp = max(1, bitsPerPixel / 8);
+
+   static const int ADAM7[7][4] = {
+      { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+      { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }
+   };
+   static const int NO_INTERLACE[1][4] = { { 0, 0, 1, 1 } };
+   const int (*passes)[4] = (interlace) ? ADAM7 : NO_INTERLACE;
+   int npasses = (interlace) ? 7 : 1;
+   uint64_t expected = 0;
+   for (int pass = 0; pass < npasses; pass++) {
+      int64_t passWidth = (width - passes[pass][0] + passes[pass][2] - 1) / passes[pass][2];
+      int64_t passHeight = (height - passes[pass][1] + passes[pass][3] - 1) / passes[pass][3];
+      if (passWidth <= 0 || passHeight <= 0) continue;
+      expected += passHeight * (1 + (passWidth * bitsPerPixel + 7) / 8);
+   }
+   string raw;
+   Inflater((const unsigned char *) compressed.data() + 2,
+            compressed.length() - 2, expected).inflate(raw);
+   if (raw.length() < expected) decodeError("PNG data is damaged (missing pixels)");
+   Grid<int> result(height, width);
+   size_t rawPos = 0;
+   for (int pass = 0; pass < npasses; pass++) {
+      int x0 = passes[pass][0];
+      int y0 = passes[pass][1];
+      int dx = passes[pass][2];
+      int dy = passes[pass][3];
+      int passWidth = (width - x0 + dx - 1) / dx;
+      int passHeight = (height - y0 + dy - 1) / dy;
+      if (passWidth <= 0 || passHeight <= 0) continue;
+      int rowBytes = (int) (((int64_t) passWidth * bitsPerPixel + 7) / 8);
+      vector<unsigned char> prev(rowBytes, 0);
+      vector<unsigned char> row(rowBytes);
+      for (int r = 0; r < passHeight; r++) {
+         if (raw.length() - rawPos < (size_t) rowBytes + 1) {
+            decodeError("PNG data is damaged (missing pixels)");
+         }
+         int filter = (unsigned char) raw[rawPos];
+         memcpy(row.data(), raw.data() + rawPos + 1, rowBytes);
+         rawPos += rowBytes + 1;
+         unfilter(filter, row.data(), prev.data(), rowBytes, bpp);
+         int y = y0 + r * dy;
+         for (int c = 0; c < passWidth; c++) {
+            int rgb;
+            switch (colorType) {
+            case 0: case 4: {
+               int gray = getSample(row.data(), c * channels, depth);
+               rgb = (gray << 16) | (gray << 8) | gray;
+               break;
+            }
+            case 3: {
+               int bit = c * depth;
+               int index = (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+               if (index >= (int) palette.size()) {
+                  decodeError("PNG data is damaged (bad palette index)");
+               }
+               rgb = palette[index];
+               break;
+            }
+            default:
+               rgb = (getSample(row.data(), c * channels, depth) << 16)
+                   | (getSample(row.data(), c * channels + 1, depth) << 8)
+                   | getSample(row.data(), c * channels + 2, depth);
+               break;
+            }
+            result[y][x0 + c * dx] = rgb;
+         }
+         row.swap(prev);
+      }
+   }
+   pixels.swap(result);
+}
+
+static string encodePNG(const Grid<int> & pixels) {
+   int width = pixels.numCols();
+   int height = pixels.numRows();
+   int rowBytes = 3 * width;
+   string filtered;
+   filtered.reserve((size_t) height * (rowBytes + 1));
+   vector<unsigned char> prev(rowBytes, 0);
+   vector<unsigned char> row(rowBytes);
+   vector<unsigned char> best(rowBytes);
+   vector<unsigned char> trial(rowBytes);
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         int rgb = pixels[y][x];
+         row[3 * x] = (unsigned char) (rgb >> 16);
+         row[3 * x + 1] = (unsigned char) (rgb >> 8);
+         row[3 * x + 2] = (unsigned char) rgb;
+      }
+      int bestType = 0;
+      long bestScore = -1;
+      for (int type = 0; type < 5; type++) {
+         memcpy(trial.data(), row.data(), rowBytes);
+         switch (type) {
+         case 1:
+            for (int i = 3; i < rowBytes; i++) {
+               trial[i] -= row[i - 3];
+            }
+            break;
+         case 2:
+            for (int i = 0; i < rowBytes; i++) {
+               trial[i] -= prev[i];
+            }
+            break;
+         case 3:
+            for (int i = 0; i < rowBytes; i++) {
+               trial[i] -= ((i >= 3 ? row[i - 3] : 0) + prev[i]) >> 1;
+            }
+            break;
+         case 4:
+            for (int i = 0; i < rowBytes; i++) {
+               trial[i] -= (i >= 3) ? paeth(row[i - 3], prev[i], prev[i - 3])
+                                    : paeth(0, prev[i], 0);
+            }
+            break;
+         }
+         long score = 0;
+         for (int i = 0; i < rowBytes; i++) {
+            score += (trial[i] < 128) ? trial[i] : 256 - trial[i];
+         }
+         if (bestScore < 0 || score < bestScore) {
+            bestScore = score;
+            bestType = type;
+            best.swap(trial);
+         }
+      }
+      filtered += char(bestType);
+      filtered.append((const char *) best.data(), rowBytes);
+      row.swap(prev);
+   }
+
+   string ihdr = "IHDR";
+   putInt32BE(ihdr, width);
+   putInt32BE(ihdr, height);
+   ihdr += char(8);
+   ihdr += char(2);
+   ihdr += string(3, '\0');
+   string idat = "IDAT";
+   deflate(idat, filtered);
+   string iend = "IEND";
+   string out(PNG_SIGNATURE, 8);
+   for (const string *chunk : { &ihdr, &idat, &iend }) {
+      putInt32BE(out, chunk->length() - 4);
+      out += *chunk;
+      putInt32BE(out, crc32(0, chunk->data(), chunk->length()));
+   }
+   return out;
+}
+
+/* PPM */
+
+static int readPPMNumber(const string & data, size_t & pos) {
+   while (pos < data.length()) {
+      if (data[pos] == '#') {
+         while (pos < data.length() && data[pos] != '\n' && data[pos] != '\r') {
+            pos++;
+         }
+      } else if (isspace((unsigned char) data[pos])) {
+         pos++;
+      } else {
+         break;
+      }
+   }
+   if (pos >= data.length() || !isdigit((unsigned char) data[pos])) {
+      decodeError("PPM data is damaged (expected a number)");
+   }
+   int64_t value = 0;
+   while (pos < data.length() && isdigit((unsigned char) data[pos])) {
+      value = 10 * value + (data[pos++] - '0');
+      if (value > 0x7FFFFFFF) decodeError("PPM data is damaged (number too large)");
+   }
+   return (int) value;
+}
+
+static void decodePPM(const string & data, Grid<int> & pixels) {
+   char kind = data[1];
+   bool color = (kind == '3' || kind == '6');
+   bool plain = (kind == '2' || kind == '3');
+   size_t pos = 2;
+   int width = readPPMNumber(data, pos);
+   int height = readPPMNumber(data, pos);
+   int maxval = readPPMNumber(data, pos);
+   int count = checkSize(width, height, "PPM");
+   if (maxval <= 0 || maxval > 65535) decodeError("PPM data is damaged (bad maximum value)");
+   int channels = color ? 3 : 1;
+   int sampleBytes = (maxval < 256) ? 1 : 2;
+   if (plain) {
+      if ((data.length() - pos + 1) / 2 / channels < (size_t) count) {
+         decodeError("PPM data is damaged (missing pixels)");
+      }
+   } else {
+      pos++;
+      if (data.length() < pos || (data.length() - pos) / channels / sampleBytes
+                                 < (size_t) count) {
+         decodeError("PPM data is damaged (missing pixels)");
+      }
+   }
+   const unsigned char *bytes = (const unsigned char *) data.data();
+   Grid<int> result(height, width);
+   for (int & rgb : result) {
+      int sample[3];
+      for (int k = 0; k < channels; k++) {
+         int value;
+         if (plain) {
+            value = readPPMNumber(data, pos);
+         } else if (sampleBytes == 1) {
+            value = bytes[pos++];
+         } else {
+            value = (bytes[pos] << 8) | bytes[pos + 1];
+            pos += 2;
+         }
+         if (value > maxval) decodeError("PPM data is damaged (sample too large)");
+         sample[k] = (maxval == 255) ? value : (value * 255 + maxval / 2) / maxval;
+      }
+      if (!color) sample[1] = sample[2] = sample[0];
+      rgb = (sample[0] << 16) | (sample[1] << 8) | sample[2];
+   }
+   pixels.swap(result);
+}
+
+static string encodePPM(const Grid<int> & pixels) {
+   string out = "P6\n" + integerToString(pixels.numCols()) + " "
+              + integerToString(pixels.numRows()) + "\n255\n";
+   out.reserve(out.length() + 3 * (size_t) pixels.numRows() * pixels.numCols());
+   for (int rgb : pixels) {
+      out += char(rgb >> 16);
+      out += char(rgb >> 8);
+      out += char(rgb);
+   }
+   return out;
+}
+
+/* BMP */
+
+/*
+ * Class: BitField
+ * ---------------
+ * Extracts one color component of a 16- or 32-bit BMP pixel and scales
+ * it to the range 0 to 255.
+ */
+
+struct BitField {
+   uint32_t mask;
+   int shift;
+   uint32_t max;
+
+   BitField(uint32_t mask) {
+      this->mask = mask;
+      shift = 0;
+      max = 0;
+      if (mask != 0) {
+         while (((mask >> shift) & 1) == 0) {
+            shift++;
+         }
+         max = mask >> shift;
+      }
+   }
+
+   int get(uint32_t px) const {
+      if (max == 0) return 0;
+      return (int) (((px & mask) >> shift) * 255 / max);
+   }
+};
+
+static void decodeBMP(const string & data, Grid<int> & pixels) {
+   const unsigned char *bytes = (const unsigned char *) data.data();
+   size_t size = data.length();
+   if (size < 26) decodeError("BMP data is damaged (short header)");
+   uint32_t offset = getInt32LE(bytes + 10);
+   uint32_t headerSize = getInt32LE(bytes + 14);
+   int64_t width;
+   int64_t height;
+   int bitCount;
+   uint32_t compression = 0;
+   uint32_t colorsUsed = 0;
+   int paletteEntrySize = 4;
+   if (headerSize == 12) {
+      width = getInt16LE(bytes + 18);
+      height = getInt16LE(bytes + 20);
+      bitCount = getInt16LE(bytes + 24);
+      paletteEntrySize = 3;
+   } else if (headerSize >= 40 && size >= 14 + 40) {
+      width = (int32_t) getInt32LE(bytes + 18);
+      height = (int32_t) getInt32LE(bytes + 22);
+      bitCount = getInt16LE(bytes + 28);
+      compression = getInt32LE(bytes + 30);
+      colorsUsed = getInt32LE(bytes + 46);
+   } else {
+      decodeError("BMP format variant is not supported");
+      return;
+   }
+   bool topDown = height < 0;
+   if (topDown) height = -height;
+   checkSize(width, height, "BMP");
+   uint32_t masks[3];
+   if (bitCount == 16) {
+      masks[0] = 0x7C00;
+      masks[1] = 0x03E0;
+      masks[2] = 0x001F;
+   } else {
+      masks[0] = 0xFF0000;
+      masks[1] = 0x00FF00;
+      masks[2] = 0x0000FF;
+   }
+   size_t paletteStart = 14 + headerSize;
+   if (compression == 3) {
+      if (bitCount != 16 && bitCount != 32) {
+         decodeError("BMP data is damaged (bit fields with " + integerToString(bitCount)
+                     + " bits per pixel)");
+      }
+      size_t maskStart = 14 + 40;
+      if (size < maskStart + 12) decodeError("BMP data is damaged (missing masks)");
+      for (int k = 0; k < 3; k++) {
+         masks[k] = getInt32LE(bytes + maskStart + 4 * k);
+      }
+      if (headerSize == 40) paletteStart += 12;
+   } else if (compression != 0) {
+      decodeError("compressed BMP files are not supported");
+   }
+   vector<int> palette;
+   if (bitCount <= 8) {
+      if (bitCount != 1 && bitCount != 4 && bitCount != 8) {
+         decodeError("BMP format variant is not supported");
+      }
+      uint32_t entries = (colorsUsed == 0 || colorsUsed > (1u << bitCount))
+                       ? 1u << bitCount : colorsUsed;
+      for (uint32_t i = 0; i < entries; i++) {
+         size_t p = paletteStart + i * paletteEntrySize;
+         if (p + 3 > size) break;
+         palette.push_back((bytes[p + 2] << 16) | (bytes[p + 1] << 8) | bytes[p]);
+      }
+   } else if (bitCount != 16 && bitCount != 24 && bitCount != 32) {
+      decodeError("BMP format variant is not supported");
+   }
+   BitField red(masks[0]);
+   BitField green(masks[1]);
+   BitField blue(masks[2]);
+   size_t stride = (size_t) ((width * bitCount + 31) / 32) * 4;
+   if (offset > size || (size - offset) / stride < (size_t) height) {
+      decodeError("BMP data is damaged (missing pixels)");
+   }
+   Grid<int> result((int) height, (int) width);
+   for (int y = 0; y < height; y++) {
+      const unsigned char *row = bytes + offset
+                               + stride * (size_t) (topDown ? y : height - 1 - y);
+      for (int x = 0; x < width; x++) {
+         int rgb;
+         if (bitCount <= 8) {
+            int bit = x * bitCount;
+            int index = (row[bit >> 3] >> (8 - bitCount - (bit & 7))) & ((1 << bitCount) - 1);
+            rgb = (index < (int) palette.size()) ? palette[index] : 0;
+         } else if (bitCount == 24) {
+            rgb = (row[3 * x + 2] << 16) | (row[3 * x + 1] << 8) | row[3 * x];
+         } else {
+            uint32_t px = (bitCount == 16) ? (uint32_t) getInt16LE(row + 2 * x)
+                                           : getInt32LE(row + 4 * x);
+            rgb = (red.get(px) << 16) | (green.get(px) << 8) | blue.get(px);
+         }
+         result[y][x] = rgb;
+      }
+   }
+   pixels.swap(result);
+}
+
+static string encodeBMP(const Grid<int> & pixels) {
+   int width = pixels.numCols();
+   int height = pixels.numRows();
+   int stride = (3 * width + 3) & ~3;
+   uint32_t imageSize = (uint32_t) stride * height;
+   string out = "BM";
+   putInt32LE(out, 14 + 40 + imageSize);
+   putInt32LE(out, 0);
+   putInt32LE(out, 14 + 40);
+   putInt32LE(out, 40);
+   putInt32LE(out, width);
+   putInt32LE(out, height);
+   putInt16LE(out, 1);
+   putInt16LE(out, 24);
+   putInt32LE(out, 0);
+   putInt32LE(out, imageSize);
+   putInt32LE(out, 2835);
+   putInt32LE(out, 2835);
+   putInt32LE(out, 0);
+   putInt32LE(out, 0);
+   string row(stride, '\0');
+   for (int y = height - 1; y >= 0; y--) {
+      for (int x = 0; x < width; x++) {
+         int rgb = pixels[y][x];
+         row[3 * x] = char(rgb);
+         row[3 * x + 1] = char(rgb >> 8);
+         row[3 * x + 2] = char(rgb >> 16);
+      }
+      out += row;
+   }
+   return out;
+}
+
+/* Implementation of the exported functions */
+
+bool decodeImage(const string & data, Grid<int> & pixels) {
+   if (data.compare(0, 8, PNG_SIGNATURE, 8) == 0) {
+      decodePNG(data, pixels);
+   } else if (data.length() >= 3 && data[0] == 'P' && data[1] >= '2' && data[1] <= '6'
+              && data[1] != '4' && isspace((unsigned char) data[2])) {
+      decodePPM(data, pixels);
+   } else if (data.compare(0, 2, "BM") == 0) {
+      decodeBMP(data, pixels);
+   } else {
+      return false;
+   }
+   return true;
+}
+
+bool isEncodableImageFile(const string & filename) {
+   string ext = toLowerCase(getExtension(filename));
+   return ext == ".png" || ext == ".ppm" || ext == ".pnm" || ext == ".bmp";
+}
+
+string encodeImage(const Grid<int> & pixels, const string & filename) {
+   string ext = toLowerCase(getExtension(filename));
+   if (ext == ".png") return encodePNG(pixels);
+   if (ext == ".bmp") return encodeBMP(pixels);
+   if (ext == ".ppm" || ext == ".pnm") return encodePPM(pixels);
+   error("GBufferedImage::save: unsupported image file format: " + filename);
+   return "";
+}
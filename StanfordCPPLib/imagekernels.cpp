@@ -0,0 +1,578 @@
+/*
+ * File: imagekernels.cpp
+ * ----------------------
+ * This file implements the pixel loops declared in private/imagekernels.h.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "thread.h"
+#include "private/imagekernels.h"
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Private section */
+
+/*
+ * Implementation notes: image kernels
+ * -----------------------------------
+ * Each span kernel has an SSE2 loop over blocks of four pixels, followed
+ * by a scalar loop that finishes the span and does all of the work when
+ * SSE2 is not available.  SSE2 is part of every x86-64 processor, so
+ * only the older 32-bit compilers and other processors use the scalar
+ * loops, which are written simply enough for their optimizers to
+ * vectorize.  The comparisons and selections work on whole 32-bit
+ * pixels.  The arithmetic widens each 8-bit component to 16 bits and
+ * then narrows the results again with saturation.  Luminance is
+ * (77 * red + 150 * green + 29 * blue + 128) / 256, which the SSE2 loop
+ * computes with two multiply-add instructions on the red/blue and green
+ * halves of each pixel.
+ *
+ * The box blur is separable: it averages each row and then each column,
+ * keeping a running sum of the window so that the cost per pixel does not
+ * depend on the radius.  The components of a sum are held in one SSE2
+ * register of four floats, which represent the sums exactly for any
+ * radius that fits in memory, so the running sums do not drift.  The
+ * column pass works down the image one row at a time, so it reads the
+ * memory in order.  It overwrites each row as it goes and saves the
+ * original rows that the window still needs in a ring of radius + 1 rows.
+ * The Gaussian blur applies three box blurs whose widths are chosen to
+ * match the variance of the Gaussian, which is within a few percent of
+ * the true Gaussian and costs the same for every sigma.
+ *
+ * Resampling is also separable.  The first pass scales each row of the
+ * source to the new width, and the second scales the columns of the
+ * result to the new height.  For each pass, the taps, which are the
+ * source indices and weights that make up each destination pixel, are
+ * computed once and shared by every row or column.  The column pass
+ * forms each destination row from the source rows named by its taps,
+ * reading each of them in order.  When every destination pixel has a
+ * single tap, as in nearest-neighbor scaling or along an axis whose size
+ * does not change, a pass just copies pixels.  Large passes are divided
+ * into bands of rows that run on separate threads, one per processor.
+ */
+
+/*
+ * Returns the address of the first element of the grid, whose elements
+ * are stored contiguously in row-major order.
+ */
+
+static int *gridData(const Grid<int> & grid) {
+   return &*grid.begin();
+}
+
+static int luminance(int rgb) {
+   return (77 * ((rgb >> 16) & 0xFF) + 150 * ((rgb >> 8) & 0xFF)
+           + 29 * (rgb & 0xFF) + 128) >> 8;
+}
+
+#ifdef USE_SSE2
+
+static __m128i load4(const int *p) {
+   return _mm_loadu_si128((const __m128i *) p);
+}
+
+static void store4(int *p, __m128i v) {
+   _mm_storeu_si128((__m128i *) p, v);
+}
+
+static __m128i luminance4(__m128i pixels) {
+   __m128i redBlue = _mm_and_si128(pixels, _mm_set1_epi32(0xFF00FF));
+   __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xFF));
+   __m128i sum = _mm_add_epi32(_mm_madd_epi16(redBlue, _mm_set1_epi32((77 << 16) | 29)),
+                               _mm_madd_epi16(green, _mm_set1_epi32(150)));
+   return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+
+/* Returns (mask & a) | (~mask & b) */
+
+static __m128i select4(__m128i mask, __m128i a, __m128i b) {
+   return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+#endif
+
+bool isRGBSpan(const int *pixels, int n) {
+   int bits = 0;
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i acc = _mm_setzero_si128();
+   for (; i + 4 <= n; i += 4) {
+      acc = _mm_or_si128(acc, load4(pixels + i));
+   }
+   acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+   acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+   bits = _mm_cvtsi128_si32(acc);
+#endif
+   for (; i < n; i++) {
+      bits |= pixels[i];
+   }
+   return (bits & 0xFF000000) == 0;
+}
+
+void fillSpan(int *dst, int n, int rgb) {
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i value = _mm_set1_epi32(rgb);
+   for (; i + 4 <= n; i += 4) {
+      store4(dst + i, value);
+   }
+#endif
+   for (; i < n; i++) {
+      dst[i] = rgb;
+   }
+}
+
+int countDiffSpan(const int *a, const int *b, int n) {
+   int count = 0;
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i equal = _mm_setzero_si128();
+   for (; i + 4 <= n; i += 4) {
+      equal = _mm_sub_epi32(equal, _mm_cmpeq_epi32(load4(a + i), load4(b + i)));
+   }
+   int lanes[4];
+   store4(lanes, equal);
+   count = i - (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+   for (; i < n; i++) {
+      if (a[i] != b[i]) count++;
+   }
+   return count;
+}
+
+void diffSpan(const int *a, const int *b, int *dst, int n,
+              int same, int different) {
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i sameValue = _mm_set1_epi32(same);
+   __m128i differentValue = _mm_set1_epi32(different);
+   for (; i + 4 <= n; i += 4) {
+      __m128i equal = _mm_cmpeq_epi32(load4(a + i), load4(b + i));
+      store4(dst + i, select4(equal, sameValue, differentValue));
+   }
+#endif
+   for (; i < n; i++) {
+      dst[i] = (a[i] == b[i]) ? same : different;
+   }
+}
+
+void blendSpan(const int *src, int *dst, int n, int alpha) {
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i zero = _mm_setzero_si128();
+   __m128i srcWeight = _mm_set1_epi16((short) alpha);
+   __m128i dstWeight = _mm_set1_epi16((short) (256 - alpha));
+   __m128i half = _mm_set1_epi16(128);
+   for (; i + 4 <= n; i += 4) {
+      __m128i s = load4(src + i);
+      __m128i d = load4(dst + i);
+      __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), srcWeight),
+                                 _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), dstWeight));
+      __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), srcWeight),
+                                 _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), dstWeight));
+      lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+      hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+      store4(dst + i, _mm_packus_epi16(lo, hi));
+   }
+#endif
+   for (; i < n; i++) {
+      int result = 0;
+      for (int shift = 0; shift < 24; shift += 8) {
+         int s = (src[i] >> shift) & 0xFF;
+         int d = (dst[i] >> shift) & 0xFF;
+         result |= ((s * alpha + d * (256 - alpha) + 128) >> 8) << shift;
+      }
+      dst[i] = result;
+   }
+}
+
+void grayscaleSpan(const int *src, int *dst, int n) {
+   int i = 0;
+#ifdef USE_SSE2
+   for (; i + 4 <= n; i += 4) {
+      __m128i gray = luminance4(load4(src + i));
+      gray = _mm_or_si128(gray, _mm_slli_epi32(gray, 8));
+      gray = _mm_or_si128(gray, _mm_slli_epi32(gray, 8));
+      store4(dst + i, gray);
+   }
+#endif
+   for (; i < n; i++) {
+      dst[i] = luminance(src[i]) * 0x010101;
+   }
+}
+
+void thresholdSpan(const int *src, int *dst, int n, int level,
+                   int dark, int light) {
+   int i = 0;
+#ifdef USE_SSE2
+   __m128i levelValue = _mm_set1_epi32(level);
+   __m128i darkValue = _mm_set1_epi32(dark);
+   __m128i lightValue = _mm_set1_epi32(light);
+   for (; i + 4 <= n; i += 4) {
+      __m128i below = _mm_cmplt_epi32(luminance4(load4(src + i)), levelValue);
+      store4(dst + i, select4(below, darkValue, lightValue));
+   }
+#endif
+   for (; i < n; i++) {
+      dst[i] = (luminance(src[i]) < level) ? dark : light;
+   }
+}
+
+/*
+ * Channel sums for the blur.  A Channels value holds the blue, green, and
+ * red components of a pixel, or sums of them, as floats.
+ */
+
+#ifdef USE_SSE2
+
+typedef __m128 Channels;
+
+static Channels unpackChannels(int rgb) {
+   __m128i zero = _mm_setzero_si128();
+   __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(rgb), zero);
+   return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+static int packChannels(Channels c) {
+   __m128i v = _mm_cvtps_epi32(c);
+   v = _mm_packs_epi32(v, v);
+   return _mm_cvtsi128_si32(_mm_packus_epi16(v, v)) & 0xFFFFFF;
+}
+
+static Channels loadChannels(const float *p) {
+   return _mm_loadu_ps(p);
+}
+
+static void storeChannels(float *p, Channels c) {
+   _mm_storeu_ps(p, c);
+}
+
+static Channels addChannels(Channels a, Channels b) {
+   return _mm_add_ps(a, b);
+}
+
+static Channels subtractChannels(Channels a, Channels b) {
+   return _mm_sub_ps(a, b);
+}
+
+static Channels scaleChannels(Channels c, float k) {
+   return _mm_mul_ps(c, _mm_set1_ps(k));
+}
+
+#else
+
+struct Channels {
+   float c[4];
+};
+
+static Channels unpackChannels(int rgb) {
+   Channels result = { { float(rgb & 0xFF), float((rgb >> 8) & 0xFF),
+                         float((rgb >> 16) & 0xFF), 0 } };
+   return result;
+}
+
+static int packChannels(Channels c) {
+   int rgb = 0;
+   for (int i = 0; i < 3; i++) {
+      rgb |= min(int(c.c[i] + 0.5f), 255) << (8 * i);
+   }
+   return rgb;
+}
+
+static Channels loadChannels(const float *p) {
+   Channels result = { { p[0], p[1], p[2], p[3] } };
+   return result;
+}
+
+static void storeChannels(float *p, Channels c) {
+   memcpy(p, c.c, sizeof c.c);
+}
+
+static Channels addChannels(Channels a, Channels b) {
+   for (int i = 0; i < 4; i++) {
+      a.c[i] += b.c[i];
+   }
+   return a;
+}
+
+static Channels subtractChannels(Channels a, Channels b) {
+   for (int i = 0; i < 4; i++) {
+      a.c[i] -= b.c[i];
+   }
+   return a;
+}
+
+static Channels scaleChannels(Channels c, float k) {
+   for (int i = 0; i < 4; i++) {
+      c.c[i] *= k;
+   }
+   return c;
+}
+
+#endif
+
+static int clamp(int value, int low, int high) {
+   return max(low, min(value, high));
+}
+
+/*
+ * Blurs the n pixels of src horizontally into dst, which must not be the
+ * same span.
+ */
+
+static void blurRow(const int *src, int *dst, int n, int radius) {
+   float scale = 1.0f / (2 * radius + 1);
+   Channels sum = unpackChannels(0);
+   for (int k = -radius; k <= radius; k++) {
+      sum = addChannels(sum, unpackChannels(src[clamp(k, 0, n - 1)]));
+   }
+   for (int x = 0; x < n; x++) {
+      dst[x] = packChannels(scaleChannels(sum, scale));
+      sum = addChannels(sum, unpackChannels(src[min(x + radius + 1, n - 1)]));
+      sum = subtractChannels(sum, unpackChannels(src[max(x - radius, 0)]));
+   }
+}
+
+/*
+ * Blurs the columns of the width-by-height pixels at base in place.
+ */
+
+static void blurColumns(int *base, int width, int height, int radius) {
+   float scale = 1.0f / (2 * radius + 1);
+   int ringRows = min(radius + 1, height);
+   vector<int> ring(ringRows * width);
+   vector<float> sums(4 * width);
+   for (int x = 0; x < width; x++) {
+      Channels sum = unpackChannels(0);
+      for (int k = -radius; k <= radius; k++) {
+         sum = addChannels(sum, unpackChannels(base[clamp(k, 0, height - 1) * width + x]));
+      }
+      storeChannels(&sums[4 * x], sum);
+   }
+   for (int y = 0; y < height; y++) {
+      int *row = base + y * width;
+      int *saved = &ring[(y % ringRows) * width];
+      memcpy(saved, row, width * sizeof(int));
+      int in = min(y + radius + 1, height - 1);
+      int out = max(y - radius, 0);
+      const int *inRow = (in > y) ? base + in * width : &ring[(in % ringRows) * width];
+      const int *outRow = &ring[(out % ringRows) * width];
+      for (int x = 0; x < width; x++) {
+         Channels sum = loadChannels(&sums[4 * x]);
+         row[x] = packChannels(scaleChannels(sum, scale));
+         sum = addChannels(sum, unpackChannels(inRow[x]));
+         storeChannels(&sums[4 * x], subtractChannels(sum, unpackChannels(outRow[x])));
+      }
+   }
+}
+
+void boxBlurImage(Grid<int> & pixels, int radius) {
+   int width = pixels.numCols();
+   int height = pixels.numRows();
+   if (radius <= 0 || width == 0 || height == 0) return;
+   radius = min(radius, max(width, height));
+   int *base = gridData(pixels);
+   vector<int> row(width);
+   for (int y = 0; y < height; y++) {
+      memcpy(&row[0], base + y * width, width * sizeof(int));
+      blurRow(&row[0], base + y * width, width, radius);
+   }
+   blurColumns(base, width, height, radius);
+}
+
+void gaussianBlurImage(Grid<int> & pixels, double sigma) {
+   const int PASSES = 3;
+   double variance = 12 * sigma * sigma;
+   int lower = (int) floor(sqrt(variance / PASSES + 1));
+   if (lower % 2 == 0) lower--;
+   int lowerPasses = (int) floor((variance - PASSES * (lower * lower + 4 * lower + 3))
+                                 / (-4.0 * (lower + 1)) + 0.5);
+   for (int i = 0; i < PASSES; i++) {
+      int width = (i < lowerPasses) ? lower : lower + 2;
+      boxBlurImage(pixels, (width - 1) / 2);
+   }
+}
+
+/*
+ * The taps of a resampling pass.  Each destination pixel is the sum of
+ * size source pixels times their weights, which are stored in index and
+ * weight at positions size * i through size * i + size - 1.
+ */
+
+struct Taps {
+   int size;
+   vector<int> index;
+   vector<float> weight;
+};
+
+static Taps computeTaps(int src, int dst, ResampleFilter filter) {
+   Taps taps;
+   double scale = double(src) / dst;
+   if (src == dst || filter == RESAMPLE_NEAREST) {
+      taps.size = 1;
+   } else if (filter == RESAMPLE_AREA && dst < src) {
+      taps.size = (int) ceil(scale) + 1;
+   } else {
+      taps.size = 2;
+   }
+   taps.index.resize(taps.size * dst);
+   taps.weight.resize(taps.size * dst);
+   for (int i = 0; i < dst; i++) {
+      int *index = &taps.index[taps.size * i];
+      float *weight = &taps.weight[taps.size * i];
+      if (taps.size == 1) {
+         index[0] = min((int) ((i + 0.5) * scale), src - 1);
+         weight[0] = 1;
+      } else if (filter == RESAMPLE_AREA && dst < src) {
+         double left = i * scale;
+         double right = left + scale;
+         for (int k = 0; k < taps.size; k++) {
+            int j = (int) left + k;
+            index[k] = min(j, src - 1);
+            weight[k] = (j < src) ? max(0.0, min(right, j + 1.0) - max(left, (double) j)) / scale : 0;
+         }
+      } else {
+         double center = (i + 0.5) * scale - 0.5;
+         int j = (int) floor(center);
+         index[0] = clamp(j, 0, src - 1);
+         index[1] = clamp(j + 1, 0, src - 1);
+         weight[1] = (float) (center - j);
+         weight[0] = 1 - weight[1];
+      }
+   }
+   return taps;
+}
+
+/*
+ * A resampling pass from src to dst, which have the given widths.  A
+ * horizontal pass scales each row to the width of dst; a vertical pass
+ * makes each row of dst from rows of src.
+ */
+
+struct ResamplePass {
+   const int *src;
+   int srcWidth;
+   int *dst;
+   int dstWidth;
+   const Taps *taps;
+   bool horizontal;
+};
+
+struct ResampleBand {
+   const ResamplePass *pass;
+   int first;
+   int last;
+};
+
+static void resampleRow(const ResamplePass & pass, int y) {
+   const Taps & taps = *pass.taps;
+   int *dst = pass.dst + y * pass.dstWidth;
+   if (pass.horizontal) {
+      const int *src = pass.src + y * pass.srcWidth;
+      for (int x = 0; x < pass.dstWidth; x++) {
+         const int *index = &taps.index[taps.size * x];
+         if (taps.size == 1) {
+            dst[x] = src[index[0]];
+         } else {
+            const float *weight = &taps.weight[taps.size * x];
+            Channels sum = unpackChannels(0);
+            for (int k = 0; k < taps.size; k++) {
+               sum = addChannels(sum, scaleChannels(unpackChannels(src[index[k]]), weight[k]));
+            }
+            dst[x] = packChannels(sum);
+         }
+      }
+   } else {
+      const int *index = &taps.index[taps.size * y];
+      const float *weight = &taps.weight[taps.size * y];
+      if (taps.size == 1) {
+         memcpy(dst, pass.src + index[0] * pass.srcWidth, pass.dstWidth * sizeof(int));
+         return;
+      }
+      vector<const int *> rows(taps.size);
+      for (int k = 0; k < taps.size; k++) {
+         rows[k] = pass.src + index[k] * pass.srcWidth;
+      }
+      for (int x = 0; x < pass.dstWidth; x++) {
+         Channels sum = unpackChannels(0);
+         for (int k = 0; k < taps.size; k++) {
+            sum = addChannels(sum, scaleChannels(unpackChannels(rows[k][x]), weight[k]));
+         }
+         dst[x] = packChannels(sum);
+      }
+   }
+}
+
+static void resampleBand(ResampleBand & band) {
+   for (int y = band.first; y < band.last; y++) {
+      resampleRow(*band.pass, y);
+   }
+}
+
+/*
+ * Runs the pass for the given number of destination rows, dividing them
+ * among threads if there is enough work to pay for starting them.
+ */
+
+static void runPass(const ResamplePass & pass, int rows) {
+   const double MIN_BAND_WORK = 1 << 18;
+   double work = (double) rows * pass.dstWidth * pass.taps->size;
+   int bands = (int) max(1u, thread::hardware_concurrency());
+   bands = (int) min((double) min(bands, rows), max(1.0, work / MIN_BAND_WORK));
+   vector<ResampleBand> band(bands);
+   for (int i = 0; i < bands; i++) {
+      band[i].pass = &pass;
+      band[i].first = (int) ((long long) rows * i / bands);
+      band[i].last = (int) ((long long) rows * (i + 1) / bands);
+   }
+   vector<Thread> children;
+   for (int i = 1; i < bands; i++) {
+      children.push_back(fork(resampleBand, band[i]));
+   }
+   resampleBand(band[0]);
+   for (Thread & child : children) {
+      join(child);
+   }
+}
+
+void resampleImage(const Grid<int> & src, Grid<int> & dst,
+                   int width, int height, ResampleFilter filter) {
+   int srcWidth = src.numCols();
+   int srcHeight = src.numRows();
+   dst.resize(height, width);
+   if (width == 0 || height == 0 || srcWidth == 0 || srcHeight == 0) return;
+   Taps columns = computeTaps(srcWidth, width, filter);
+   Taps rows = computeTaps(srcHeight, height, filter);
+   vector<int> tmp(srcHeight * width);
+   ResamplePass horizontal = { gridData(src), srcWidth, &tmp[0], width, &columns, true };
+   runPass(horizontal, srcHeight);
+   ResamplePass vertical = { &tmp[0], width, gridData(dst), width, &rows, false };
+   runPass(vertical, height);
+}
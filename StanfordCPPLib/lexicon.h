@@ -298,7 +298,7 @@ public:
       std::string currentSetWord;
       std::string tmpWord;
       Edge *edgePtr;
-      Stack<Edge *> stack;
+      Stack<Edge *,16> stack;
       Set<std::string>::iterator setIterator;
       Set<std::string>::iterator setEnd;
 
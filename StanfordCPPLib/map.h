@@ -14,6 +14,7 @@
 #include <sstream>
 #include "hashcode.h"
 #include "stack.h"
+#include "private/nodevalue.h"
 
 
 /**
@@ -242,11 +243,14 @@ private:
    static const int BST_IN_BALANCE = 0;
    static const int BST_RIGHT_HEAVY = +1;
 
-/* Type definition for nodes in the binary search tree */
+/*
+ * Type definition for nodes in the binary search tree.  The value is
+ * inherited from NodeValue so that the KeyOnly maps used by Set do not
+ * store one.
+ */
 
-   struct BSTNode {
+   struct BSTNode : public NodeValue<ValueType> {
       KeyType key;             /* The key stored in this node         */
-      ValueType value;         /* The corresponding value             */
       BSTNode *left;           /* Subtree containing all smaller keys */
       BSTNode *right;          /* Subtree containing all larger keys  */
       int bf;                  /* AVL balance factor                  */
@@ -323,7 +327,7 @@ private:
    ValueType *findNode(BSTNode *t, const KeyType & key) const {
       if (t == NULL)  return NULL;
       int sign = compareKeys(key, t->key);
-      if (sign == 0) return &t->value;
+      if (sign == 0) return &t->getValue();
       if (sign < 0) {
          return findNode(t->left, key);
       } else {
@@ -348,15 +352,15 @@ private:
       if (t == NULL)  {
          t = new BSTNode();
          t->key = key;
-         t->value = ValueType();
+         t->setValue(ValueType());
          t->bf = BST_IN_BALANCE;
          t->left = t->right = NULL;
          heightFlag = true;
          nodeCount++;
-         return &t->value;
+         return &t->getValue();
       }
       int sign = compareKeys(key, t->key);
-      if (sign == 0) return &t->value;
+      if (sign == 0) return &t->getValue();
       ValueType *vp = NULL;
       int bfDelta = BST_IN_BALANCE;
       if (sign < 0) {
@@ -423,7 +427,7 @@ private:
             successor = successor->right;
          }
          t->key = successor->key;
-         t->value = successor->value;
+         t->setValue(successor->getValue());
          if (removeNode(t->left, successor->key)) {
             updateBF(t, BST_RIGHT_HEAVY);
             return (t->bf == BST_IN_BALANCE);
@@ -582,7 +586,7 @@ private:
    void mapAll(BSTNode *t, void (*fn)(KeyType, ValueType)) const {
       if (t != NULL) {
          mapAll(t->left, fn);
-         fn(t->key, t->value);
+         fn(t->key, t->getValue());
          mapAll(t->right, fn);
       }
    }
@@ -591,7 +595,7 @@ private:
                void (*fn)(const KeyType &, const ValueType &)) const {
       if (t != NULL) {
          mapAll(t->left, fn);
-         fn(t->key, t->value);
+         fn(t->key, t->getValue());
          mapAll(t->right, fn);
       }
    }
@@ -600,7 +604,7 @@ private:
    void mapAll(BSTNode *t, FunctorType fn) const {
       if (t != NULL) {
          mapAll(t->left, fn);
-         fn(t->key, t->value);
+         fn(t->key, t->getValue());
          mapAll(t->right, fn);
       }
    }
@@ -615,7 +619,7 @@ private:
       if (t == NULL) return NULL;
       BSTNode *np = new BSTNode();
       np->key = t->key;
-      np->value = t->value;
+      np->setValue(t->getValue());
       np->bf = t->bf;
       np->left = copyTree(t->left);
       np->right = copyTree(t->right);
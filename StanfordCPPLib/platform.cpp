@@ -25,10 +25,13 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cstdint>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -47,21 +50,27 @@
 #define inline
 #  include <sys/types.h>
 #  include <sys/stat.h>
+#  include <sys/mman.h>
 #  include <dirent.h>
 #  include <errno.h>
+#  include <fcntl.h>
+#  include <poll.h>
 #  include <pwd.h>
 #  include <unistd.h>
 #  include <signal.h>
 #endif
 
+#include "base64.h"
 #include "error.h"
 #include "filelib.h"
+#include "gbufferedimage.h"
 #include "gevents.h"
 #include "gtimer.h"
 #include "gtypes.h"
 #include "hashmap.h"
 #include "queue.h"
 #include "platform.h"
+#include "private/backend.h"
 #include "stack.h"
 #include "strlib.h"
 #include "tokenscanner.h"
@@ -76,6 +85,9 @@ static int scanInt(TokenScanner & scanner);
 static double scanDouble(TokenScanner & scanner);
 static GDimension scanDimension(const string & str);
 static GRectangle scanRectangle(const string & str);
+static double parseReal(const string & result);
+static bool parseBoolean(const string & result);
+static GRectangle parseBounds(const string & result);
 static void setConsoleProperties();
 
 
@@ -229,6 +241,7 @@ public:
 /* Private data */
 
 static Queue<GEvent> eventQueue;
+static int eventMask = 0;
 static HashMap<string,GTimerData *> timerTable;
 static HashMap<string,GWindowData *> windowTable;
 static HashMap<string,GObject *> sourceTable;
@@ -238,6 +251,453 @@ static ofstream logfile;
 static bool tracePipe;
 static ConsoleStreambuf* cinout_buf;
 
+/*
+ * Implementation notes: back ends
+ * -------------------------------
+ * The commands in pipeBuffer and the replies read into pipeReadBuffer
+ * pass through the BackEnd interface defined in private/backend.h.  The
+ * usual back end is pipeBackEnd, which writes to and reads from the pipes
+ * connected to the Java process.  If the environment variable JBEBACKEND
+ * is "headless", initBackEnd installs a HeadlessBackEnd instead, which
+ * executes the commands inside this process.  Everything above the
+ * transport, including buffering and request pipelining, is the same for
+ * both.
+ */
+
+class PipeBackEnd : public BackEnd {
+public:
+   virtual void sendCommands(const char *data, size_t length);
+   virtual size_t readReplies(char *buffer, size_t size);
+   virtual bool repliesReady();
+   virtual void terminate();
+};
+
+static PipeBackEnd pipeBackEnd;
+static BackEnd *backEnd = &pipeBackEnd;
+static HeadlessBackEnd *headlessBackEnd = NULL;
+
+/*
+ * Implementation notes: pipe output buffer
+ * ----------------------------------------
+ * Commands to the Java back end are collected in pipeBuffer rather than
+ * written one at a time, because each write is a system call and an
+ * animation frame can easily contain thousands of commands.  The buffer
+ * is written out by flushPipe whenever the C++ side is about to wait
+ * for a reply, when it grows past PIPE_FLUSH_THRESHOLD bytes, and at
+ * the natural frame boundaries (repaint, console output, and exit).
+ * Between beginBatch and endBatch only a wait for a reply flushes the
+ * buffer, so that an entire frame reaches the back end in one write.
+ */
+
+static const size_t PIPE_FLUSH_THRESHOLD = 64 * 1024;
+static string pipeBuffer;
+static int batchDepth = 0;
+
+/*
+ * Implementation notes: pipe input buffer
+ * ---------------------------------------
+ * Replies from the back end are read in blocks of PIPE_READ_BUFFER_SIZE
+ * bytes rather than a byte at a time.  getPipe scans the block for the
+ * end of the line with memchr and assembles the line in pipeLine, which
+ * keeps its storage from one call to the next.
+ */
+
+static const size_t PIPE_READ_BUFFER_SIZE = 64 * 1024;
+static char pipeReadBuffer[PIPE_READ_BUFFER_SIZE];
+static size_t pipeReadStart = 0;
+static size_t pipeReadEnd = 0;
+static string pipeLine;
+
+/*
+ * Implementation notes: binary protocol
+ * -------------------------------------
+ * The commands issued most often are sent in binary frames once initPipe
+ * has negotiated the binary protocol with the back end.  A frame is a
+ * four-byte length that counts the bytes after it, a two-byte opcode,
+ * and the arguments, each preceded by a one-byte tag:
+ *
+ *    'h'  object handle, the pointer value as eight bytes
+ *    'd'  double, eight bytes in IEEE 754 format
+ *    'i'  int, four bytes
+ *    'b'  bool, one byte
+ *    's'  string, a four-byte length followed by UTF-8 bytes
+ *    'S'  string in the shared-memory ring, an eight-byte position
+ *         and a four-byte length
+ *
+ * The string tags also carry binary data, such as the packed pixels of
+ * GBufferedImage.updateRegion, which the back end reads as raw bytes.
+ * The text protocol sends the same data in Base64.
+ *
+ * All integers are big-endian.  Commands without an opcode of their own
+ * are sent as OP_TEXT frames that carry the text form of the command.
+ * Replies from the back end remain text lines in either protocol.  The
+ * text protocol is used when JBETRACE is set, so that the trace stays
+ * readable, or when JBEPROTOCOL is "text".  The opcodes must match the
+ * OPCODE_NAMES table in FrameScanner.java.
+ */
+
+enum Opcode {
+   OP_TEXT,
+   OP_SET_LOCATION,
+   OP_SET_SIZE,
+   OP_SET_COLOR,
+   OP_SET_FILL_COLOR,
+   OP_SET_FILLED,
+   OP_SET_VISIBLE,
+   OP_SET_LINE_WIDTH,
+   OP_REMOVE,
+   OP_DELETE,
+   OP_ROTATE,
+   OP_SCALE,
+   OP_SEND_TO_FRONT,
+   OP_SEND_TO_BACK,
+   OP_SEND_FORWARD,
+   OP_SEND_BACKWARD,
+   OP_CREATE_GCOMPOUND,
+   OP_ADD,
+   OP_CREATE_GRECT,
+   OP_CREATE_GOVAL,
+   OP_CREATE_GLINE,
+   OP_SET_START_POINT,
+   OP_SET_END_POINT,
+   OP_CREATE_GLABEL,
+   OP_SET_LABEL,
+   OP_SET_FONT,
+   OP_CREATE_GPOLYGON,
+   OP_ADD_VERTEX,
+   OP_REPAINT,
+   OP_DRAW,
+   OP_SET_TEXT,
+   OP_PRINT,
+   OP_SET_STATE,
+   OP_DRAW_LINE,
+   OP_DRAW_RECT,
+   OP_DRAW_OVAL,
+   OP_DRAW_LINES,
+   OP_UPDATE_REGION,
+   OP_UPDATE_REGIONS,
+   OP_ADD_VERTICES
+};
+
+/* Command names indexed by opcode, used for the protocol statistics */
+
+static const char *const OPCODE_NAMES[] = {
+   "",
+   "GObject.setLocation",
+   "GObject.setSize",
+   "GObject.setColor",
+   "GObject.setFillColor",
+   "GObject.setFilled",
+   "GObject.setVisible",
+   "GObject.setLineWidth",
+   "GObject.remove",
+   "GObject.delete",
+   "GObject.rotate",
+   "GObject.scale",
+   "GObject.sendToFront",
+   "GObject.sendToBack",
+   "GObject.sendForward",
+   "GObject.sendBackward",
+   "GCompound.create",
+   "GCompound.add",
+   "GRect.create",
+   "GOval.create",
+   "GLine.create",
+   "GLine.setStartPoint",
+   "GLine.setEndPoint",
+   "GLabel.create",
+   "GLabel.setLabel",
+   "GLabel.setFont",
+   "GPolygon.create",
+   "GPolygon.addVertex",
+   "GWindow.repaint",
+   "GWindow.draw",
+   "GTextArea.setText",
+   "JBEConsole.print",
+   "GObject.setState",
+   "GWindow.drawLine",
+   "GWindow.drawRect",
+   "GWindow.drawOval",
+   "GWindow.drawLines",
+   "GBufferedImage.updateRegion",
+   "GBufferedImage.updateRegions",
+   "GPolygon.addVertices"
+};
+
+static bool binaryProtocol = false;
+
+/*
+ * Implementation notes: shared memory
+ * -----------------------------------
+ * Long strings and bulk results bypass the pipe when the back end can
+ * map a memory region shared with this process.  initSharedMemory
+ * creates the region as a file in /dev/shm (Java has no shm_open), has
+ * the back end map it, and unlinks the file.  The region consists of a
+ * SHARED_HEADER_SIZE-byte header and two rings of SHARED_RING_SIZE bytes.
+ * The outbound ring holds the strings of 'S' arguments, which the back
+ * end reads in the order the frames arrive; the inbound ring holds the
+ * results that the back end announces with "bulk:pos,len" in place of
+ * "result:".  Positions count the bytes ever written to a ring, and a
+ * block never wraps past the end of the ring; the writer skips to the
+ * start instead.  The reader of each ring stores the position up to
+ * which it has consumed the ring in the header, the back end at
+ * OUT_CONSUMED and this file at IN_CONSUMED, so that the writer knows
+ * which space is free.  A writer that finds too little free space falls
+ * back to sending the data through the pipe.  The layout must match
+ * JBESharedMemory.java.  On Windows, and whenever the binary protocol is
+ * off, the region is not created and everything goes through the pipe.
+ */
+
+static const size_t SHARED_HEADER_SIZE = 64;
+static const size_t SHARED_RING_SIZE = 16 * 1024 * 1024;
+static const size_t SHARED_STRING_MIN = 1024;
+static const size_t OUT_CONSUMED = 0;
+static const size_t IN_CONSUMED = 8;
+static char *sharedRegion = NULL;
+static uint64_t sharedWritten = 0;
+
+static int64_t putShared(const string & text);
+
+/*
+ * Implementation notes: pipelined requests
+ * ----------------------------------------
+ * The back end executes commands in the order they arrive and answers
+ * each query with exactly one result line, so replies can be matched to
+ * requests by counting.  sendRequest numbers each query it sends, and
+ * nextReplyId is the number of the request whose reply is next in the
+ * pipe.  awaitResult reads replies until it reaches the one it needs,
+ * parking the replies to later requests in earlyResults.  getResult,
+ * which serves the synchronous commands, first parks the replies to any
+ * requests still outstanding, so the two styles can be mixed freely.
+ */
+
+static int nextRequestId = 0;
+static int nextReplyId = 0;
+static HashMap<int,string> earlyResults;
+
+/*
+ * Implementation notes: protocol statistics
+ * -----------------------------------------
+ * When statistics are enabled, each command sent to the back end is
+ * counted under its name together with the bytes it occupies in the
+ * pipe, and each wait for a result records the bytes of the reply lines
+ * read and the round-trip time.  Round trips are kept in a histogram
+ * whose bucket k holds the times from 2^k to 2^(k+1) microseconds; the
+ * first bucket also holds anything shorter and the last anything longer.
+ * The round trip of a synchronous command is measured from the moment
+ * getResult starts to wait, which is when the command is flushed, and
+ * that of a pipelined request from the moment sendRequest queues it.
+ * Results are credited to the last command sent or, for pipelined
+ * requests, to the command recorded in pendingStats under the request
+ * id.  The names of consecutive commands are usually the same, so the
+ * last lookup is cached in lastStatsName.  Setting JBESTATS to a filename
+ * enables the statistics from the start and writes them to that file at
+ * exit, as JSON if the name ends in ".json" and as CSV otherwise.  When
+ * the statistics are off, the cost is a test of statsEnabled per command.
+ */
+
+static const int LATENCY_BUCKETS = 24;
+
+struct CommandStats {
+   long long count;                     /* Commands sent                 */
+   long long bytesSent;                 /* Bytes of those commands       */
+   long long results;                   /* Results received              */
+   long long bytesReceived;             /* Bytes of the reply lines      */
+   double totalMicros;                  /* Sum of the round-trip times   */
+   double maxMicros;                    /* Longest round-trip time       */
+   long long histogram[LATENCY_BUCKETS];
+};
+
+struct PendingStats {
+   int id;                              /* Request id                    */
+   CommandStats *stats;                 /* Statistics of the request     */
+   double start;                        /* Time it was queued            */
+};
+
+static bool statsEnabled = false;
+static string statsFilename;
+static HashMap<string,CommandStats *> commandStats;
+static CommandStats *lastStats = NULL;
+static string lastStatsName;
+static Queue<PendingStats> pendingStats;
+static long long replyBytes = 0;
+
+static void countCommand(const char *name, size_t length, size_t bytes);
+static void countFrame(size_t start);
+static void countResult(CommandStats *stats, double start, long long bytes);
+static double statsClock();
+
+/*
+ * Implementation notes: cached sizes
+ * ----------------------------------
+ * The size of an interactor and the size of a window's canvas change
+ * only in response to commands that pass through this file, so the
+ * answers from the back end are remembered until such a command is
+ * sent.  Laying out a control region can move and resize the canvas and
+ * every interactor in the window, so addToRegion, removeFromRegion, and
+ * showing a window discard the cached sizes.  The user can also resize a
+ * window, so the back end reports every resize with a windowResized
+ * event, whatever event mask the program has asked for, and handleEvent
+ * discards the cached sizes when it sees one; the events outside the
+ * mask of the last getNextEvent or waitForEvent are then dropped.  Such
+ * an event may arrive while the program is not waiting for anything, so
+ * the accessors call pollEvents, which processes the events that have
+ * already arrived without blocking, before they trust a cached size.
+ * The back end performs the layout on its event thread before it
+ * answers any later size query, so the next answer is current.
+ */
+
+static HashMap<GObject *,GDimension> interactorSizes;
+
+static void forgetSizes(GWindowData *gwd);
+static void pollEvents();
+
+/*
+ * Implementation notes: command coalescing
+ * ----------------------------------------
+ * The property setters for graphical objects do not send their commands
+ * right away.  They record the new values in pendingObjects, and
+ * flushPending sends the recorded changes just before any other command
+ * and before pipeBuffer is written.  Changes to the same object in the
+ * meantime are merged, so a superseded setLocation never reaches the
+ * back end, and several properties set in a row go out as a single
+ * GObject.setState command that lists only the properties that changed.
+ * Because every other command sends the pending changes first, the back
+ * end sees each object in the right state whenever a command could
+ * observe it, and changes to different objects, which commute, keep the
+ * order in which the objects were first changed.  The create commands
+ * for GRect, GOval, GLine, and GLabel are deferred the same way, so they
+ * travel with the initial properties, and an object that is deleted
+ * before anything else refers to it is never sent at all.  The STATE
+ * flags must match GObject_setState in JBECommand.java.  A GBufferedImage
+ * keeps a short list of the rectangles of pixels it has changed to itself
+ * and marks its entry here, so that flushPending calls its flush method,
+ * which sends all of the rectangles as one GBufferedImage.updateRegions
+ * command.  A double-buffered image does not mark its entry and sends
+ * its changes only when the client calls present.  The vertices added to
+ * a GPolygon are collected in its entry as well and go out together as
+ * one GPolygon.addVertices command, so a polygon built by a loop of
+ * addEdge calls costs a single message.
+ */
+
+enum StateFlag {
+   STATE_LOCATION = 1,
+   STATE_SIZE = 2,
+   STATE_COLOR = 4,
+   STATE_FILL_COLOR = 8,
+   STATE_FILLED = 16,
+   STATE_VISIBLE = 32,
+   STATE_LINE_WIDTH = 64
+};
+
+struct PendingObject {
+   GObject *gobj;               /* The object, or NULL if deleted         */
+   int create;                  /* Deferred create opcode, or OP_TEXT     */
+   double args[4];              /* Arguments of the create command        */
+   string label;                /* Text of a deferred GLabel              */
+   int fields;                  /* STATE flags of the changed properties  */
+   double x, y;
+   double width, height;
+   string color;
+   string fillColor;
+   bool filled;
+   bool visible;
+   double lineWidth;
+   bool pixels;                 /* True if a GBufferedImage has changed   */
+   vector<GPoint> vertices;     /* Vertices added to a GPolygon           */
+};
+
+static vector<PendingObject> pendingObjects;
+static HashMap<GObject *,int> pendingIndex;
+
+static PendingObject & getPending(GObject *gobj);
+static PendingObject & deferCreate(GObject *gobj, int op);
+static void flushPending();
+
+/*
+ * Class: PipeFrame
+ * ----------------
+ * Builds one binary frame in place at the end of pipeBuffer.  The
+ * arguments are appended by chaining calls, as in
+ *
+ *    PipeFrame(OP_SET_LOCATION).handle(gobj).real(x).real(y).send();
+ *
+ * and send fills in the length and applies the usual flush policy.
+ */
+
+class PipeFrame {
+public:
+   PipeFrame(Opcode op) {
+      if (!pendingObjects.empty()) flushPending();
+      start = pipeBuffer.length();
+      putInt32(0);
+      pipeBuffer += char(op >> 8);
+      pipeBuffer += char(op);
+   }
+
+   PipeFrame & handle(const void *ptr) {
+      pipeBuffer += 'h';
+      putInt64((uint64_t) (uintptr_t) ptr);
+      return *this;
+   }
+
+   PipeFrame & real(double x) {
+      uint64_t bits;
+      memcpy(&bits, &x, sizeof bits);
+      pipeBuffer += 'd';
+      putInt64(bits);
+      return *this;
+   }
+
+   PipeFrame & integer(int n) {
+      pipeBuffer += 'i';
+      putInt32((uint32_t) n);
+      return *this;
+   }
+
+   PipeFrame & boolean(bool flag) {
+      pipeBuffer += 'b';
+      pipeBuffer += char(flag ? 1 : 0);
+      return *this;
+   }
+
+   PipeFrame & str(const string & text) {
+      if (sharedRegion != NULL && text.length() >= SHARED_STRING_MIN) {
+         int64_t pos = putShared(text);
+         if (pos >= 0) {
+            pipeBuffer += 'S';
+            putInt64((uint64_t) pos);
+            putInt32((uint32_t) text.length());
+            return *this;
+         }
+      }
+      pipeBuffer += 's';
+      putInt32((uint32_t) text.length());
+      pipeBuffer += text;
+      return *this;
+   }
+
+   PipeFrame & raw(const string & text) {
+      pipeBuffer += text;
+      return *this;
+   }
+
+   void send();
+
+private:
+   size_t start;
+
+   void putInt32(uint32_t n) {
+      char bytes[4] = { char(n >> 24), char(n >> 16), char(n >> 8), char(n) };
+      pipeBuffer.append(bytes, 4);
+   }
+
+   void putInt64(uint64_t n) {
+      putInt32((uint32_t) (n >> 32));
+      putInt32((uint32_t) n);
+   }
+};
+
 #ifdef _WIN32
 static HANDLE rdFromJBE = NULL;
 static HANDLE wrFromJBE = NULL;
@@ -253,12 +713,27 @@ static int child;
 
 /* Prototypes */
 
+static void initBackEnd();
 static void initPipe();
-static void putPipe(string line);
-static string getPipe();
-static string getResult(bool consumeAcks = true);
+static void writePipe(const char *data, size_t length);
+static size_t readPipe(char *buffer, size_t size);
+static bool pollPipe();
+static void initProtocol();
+static void initSharedMemory();
+static void putPipe(const string & line);
+static void flushPipe();
+static void flushPipeAtExit();
+static void writeStatsAtExit();
+static void endFrame();
+static void fillPipe();
+static const string & getPipe();
+static string getResult(bool consumeAcks = true, bool *bulk = NULL);
+static string readResult(bool consumeAcks = true, bool *bulk = NULL);
+static string getBulkResult();
+static string readRequestResult();
 static void getStatus();
 static GEvent parseEvent(string line);
+static void handleEvent(const string & line);
 static GEvent parseMouseEvent(TokenScanner & scanner, EventType type);
 static GEvent parseKeyEvent(TokenScanner & scanner, EventType type);
 static GEvent parseTimerEvent(TokenScanner & scanner, EventType type);
@@ -557,16 +1032,24 @@ void Platform::clear(const GWindow & gw) {
 }
 
 void Platform::repaint(const GWindow & gw) {
+   if (binaryProtocol) {
+      PipeFrame(OP_REPAINT).handle(gw.gwd).send();
+      endFrame();
+      return;
+   }
    ostringstream os;
    os << "GWindow.repaint(\"" << gw.gwd << "\")";
    putPipe(os.str());
+   endFrame();
 }
 
 void Platform::setVisible(const GWindow & gw, bool flag) {
+   forgetSizes(gw.gwd);
    ostringstream os;
    os << boolalpha << "GWindow.setVisible(\"" << gw.gwd << "\", "
                    << flag << ")";
    putPipe(os.str());
+   endFrame();
 }
 
 void Platform::setWindowTitle(const GWindow & gw, string title) {
@@ -578,17 +1061,42 @@ void Platform::setWindowTitle(const GWindow & gw, string title) {
 }
 
 double Platform::getCanvasWidth(const GWindow & gw) {
+  pollEvents();
+  if (!gw.gwd->canvasSizeKnown) fetchCanvasSize(gw);
+  return gw.gwd->canvasWidth;
+}
+
+double Platform::getCanvasHeight(const GWindow & gw) {
+  pollEvents();
+  if (!gw.gwd->canvasSizeKnown) fetchCanvasSize(gw);
+  return gw.gwd->canvasHeight;
+}
+
+/*
+ * Implementation notes: fetchCanvasSize
+ * -------------------------------------
+ * Both dimensions are requested together, since a caller that needs one
+ * usually needs the other.
+ */
+
+void Platform::fetchCanvasSize(const GWindow & gw) {
+  PendingResult<double> width = getCanvasWidthAsync(gw);
+  PendingResult<double> height = getCanvasHeightAsync(gw);
+  gw.gwd->canvasWidth = width.get();
+  gw.gwd->canvasHeight = height.get();
+  gw.gwd->canvasSizeKnown = true;
+}
+
+PendingResult<double> Platform::getCanvasWidthAsync(const GWindow & gw) {
   ostringstream os;
   os << "GWindow.getCanvasWidth(\"" << gw.gwd << "\")";
-  putPipe(os.str());
-  return stringToReal(getResult());
+  return PendingResult<double>(sendRequest(os.str()), parseReal);
 }
 
-double Platform::getCanvasHeight(const GWindow & gw) {
+PendingResult<double> Platform::getCanvasHeightAsync(const GWindow & gw) {
   ostringstream os;
   os << "GWindow.getCanvasHeight(\"" << gw.gwd << "\")";
-  putPipe(os.str());
-  return stringToReal(getResult());
+  return PendingResult<double>(sendRequest(os.str()), parseReal);
 }
 
 double Platform::getScreenWidth() {
@@ -660,18 +1168,38 @@ void Platform::playSound(Sound *sound) {
 }
 
 void Platform::deleteGObject(GObject *gobj) {
+   interactorSizes.remove(gobj);
+   if (pendingIndex.containsKey(gobj)) {
+      PendingObject & pending = pendingObjects[pendingIndex.get(gobj)];
+      bool created = pending.create == OP_TEXT;
+      pending.gobj = NULL;
+      pendingIndex.remove(gobj);
+      if (!created) return;
+   }
+   if (binaryProtocol) {
+      PipeFrame(OP_DELETE).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.delete(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::add(GObject *compound, GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_ADD).handle(compound).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GCompound.add(\"" << compound << "\", \"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::remove(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_REMOVE).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.remove(\"" << gobj << "\")";
    putPipe(os.str());
@@ -686,6 +1214,7 @@ void Platform::setRegionAlignment(const GWindow & gw, string region,
 }
 
 void Platform::addToRegion(const GWindow & gw, GObject *gobj, string region) {
+   forgetSizes(gw.gwd);
    ostringstream os;
    os << "GWindow.addToRegion(\"" << gw.gwd << "\", \"" << gobj << "\", \""
                                    << region << "\")";
@@ -694,6 +1223,7 @@ void Platform::addToRegion(const GWindow & gw, GObject *gobj, string region) {
 
 void Platform::removeFromRegion(const GWindow & gw, GObject *gobj,
                                                     string region) {
+   forgetSizes(gw.gwd);
    ostringstream os;
    os << "GWindow.removeFromRegion(\"" << gw.gwd << "\", \""
                                        << gobj << "\", \"" << region << "\")";
@@ -701,48 +1231,72 @@ void Platform::removeFromRegion(const GWindow & gw, GObject *gobj,
 }
 
 void Platform::sendForward(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SEND_FORWARD).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.sendForward(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::sendToFront(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SEND_TO_FRONT).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.sendToFront(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::sendBackward(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SEND_BACKWARD).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.sendBackward(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::sendToBack(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SEND_TO_BACK).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.sendToBack(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::setVisible(GObject *gobj, bool flag) {
-   ostringstream os;
-   os << boolalpha << "GObject.setVisible(\"" << gobj << "\", " << flag << ")";
-   putPipe(os.str());
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_VISIBLE;
+   pending.visible = flag;
 }
 
 void Platform::setColor(GObject *gobj, string color) {
-   ostringstream os;
-   os << "GObject.setColor(\"" << gobj << "\", \"" << color << "\")";
-   putPipe(os.str());
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_COLOR;
+   pending.color = color;
 }
 
 void Platform::scale(GObject *gobj, double sx, double sy) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SCALE).handle(gobj).real(sx).real(sy).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.scale(\"" << gobj << "\", " << sx << ", " << sy << ")";
    putPipe(os.str());
 }
 
 void Platform::rotate(GObject *gobj, double theta) {
+   if (binaryProtocol) {
+      PipeFrame(OP_ROTATE).handle(gobj).real(theta).send();
+      return;
+   }
    ostringstream os;
    os << "GObject.rotate(\"" << gobj << "\", " << theta << ")";
    putPipe(os.str());
@@ -751,40 +1305,47 @@ void Platform::rotate(GObject *gobj, double theta) {
 // Move this computation into gobjects.cpp
 // (Done for GRect, GOval, GRoundRect, GLine, GPolygon, GImage, GCompound, GLabel by JL)
 bool Platform::contains(const GObject *gobj, double x, double y) {
+   return containsAsync(gobj, x, y).get();
+}
+
+PendingResult<bool> Platform::containsAsync(const GObject *gobj,
+                                            double x, double y) {
    ostringstream os;
    os << "GObject.contains(\"" << gobj << "\", " << x << ", " << y << ")";
-   putPipe(os.str());
-   return getResult() == "true";
+   return PendingResult<bool>(sendRequest(os.str()), parseBoolean);
 }
 
 // Move this computation into gobjects.cpp
 // (Done for GRect, GOval, GRoundRect, GLine, GPolygon, GImage, GCompound, GLabel by JL)
 GRectangle Platform::getBounds(const GObject *gobj) {
+   return getBoundsAsync(gobj).get();
+}
+
+PendingResult<GRectangle> Platform::getBoundsAsync(const GObject *gobj) {
    ostringstream os;
    os << "GObject.getBounds(\"" << gobj << "\")";
-   putPipe(os.str());
-   string result = getResult();
-   if (!startsWith(result, "GRectangle(")) error(std::string("getBounds: unexpected result: ") + result);
-   return scanRectangle(result);
+   return PendingResult<GRectangle>(sendRequest(os.str()), parseBounds);
 }
 
 void Platform::setLineWidth(GObject *gobj, double lineWidth) {
-   ostringstream os;
-   os << "GObject.setLineWidth(\"" << gobj << "\", " << lineWidth << ")";
-   putPipe(os.str());
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_LINE_WIDTH;
+   pending.lineWidth = lineWidth;
 }
 
 void Platform::setLocation(GObject *gobj, double x, double y) {
-   ostringstream os;
-   os << "GObject.setLocation(\"" << gobj << "\", " << x << ", " << y << ")";
-   putPipe(os.str());
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_LOCATION;
+   pending.x = x;
+   pending.y = y;
 }
 
 void Platform::setSize(GObject *gobj, double width, double height) {
-   ostringstream os;
-   os << "GObject.setSize(\"" << gobj << "\", " << width << ", "
-                                                 << height << ")";
-   putPipe(os.str());
+   interactorSizes.remove(gobj);
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_SIZE;
+   pending.width = width;
+   pending.height = height;
 }
 
 void Platform::setFrameRectangle(GObject *gobj, double x, double y,
@@ -797,30 +1358,104 @@ void Platform::setFrameRectangle(GObject *gobj, double x, double y,
 }
 
 void Platform::draw(const GWindow & gw, const GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_DRAW).handle(gw.gwd).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GWindow.draw(\"" << gw.gwd << "\", \"" << gobj << "\")";
    putPipe(os.str());
 }
 
-void Platform::setFilled(GObject *gobj, bool flag) {
+/*
+ * Implementation notes: immediate-mode drawing
+ * --------------------------------------------
+ * The drawing methods of GWindow send one command each, which paints
+ * the shape on the background layer without creating an object in the
+ * back end.  drawLines sends the whole polyline in one command, whose
+ * arguments are the color, the number of points, and the coordinates.
+ */
+
+void Platform::drawLine(const GWindow & gw, double x0, double y0,
+                                            double x1, double y1, string color) {
+   if (binaryProtocol) {
+      PipeFrame(OP_DRAW_LINE).handle(gw.gwd).real(x0).real(y0)
+                             .real(x1).real(y1).str(color).send();
+      return;
+   }
    ostringstream os;
-   os << boolalpha << "GObject.setFilled(\"" << gobj << "\", " << flag << ")";
+   os << "GWindow.drawLine(\"" << gw.gwd << "\", " << x0 << ", " << y0 << ", "
+                         << x1 << ", " << y1 << ", \"" << color << "\")";
    putPipe(os.str());
 }
 
-void Platform::setFillColor(GObject *gobj, string color) {
+void Platform::drawRect(const GWindow & gw, double x, double y, double width,
+                                            double height, string color, bool filled) {
+   if (binaryProtocol) {
+      PipeFrame(OP_DRAW_RECT).handle(gw.gwd).real(x).real(y).real(width)
+                             .real(height).str(color).boolean(filled).send();
+      return;
+   }
    ostringstream os;
-   os << "GObject.setFillColor(\"" << gobj << "\", \"" << color << "\")";
+   os << boolalpha << "GWindow.drawRect(\"" << gw.gwd << "\", " << x << ", "
+      << y << ", " << width << ", " << height << ", \"" << color << "\", "
+      << filled << ")";
    putPipe(os.str());
 }
 
-void Platform::createGRect(GObject *gobj, double width, double height) {
+void Platform::drawOval(const GWindow & gw, double x, double y, double width,
+                                            double height, string color, bool filled) {
+   if (binaryProtocol) {
+      PipeFrame(OP_DRAW_OVAL).handle(gw.gwd).real(x).real(y).real(width)
+                             .real(height).str(color).boolean(filled).send();
+      return;
+   }
    ostringstream os;
-   os << "GRect.create(\"" << gobj << "\", " << width << ", "
-                                              << height << ")";
+   os << boolalpha << "GWindow.drawOval(\"" << gw.gwd << "\", " << x << ", "
+      << y << ", " << width << ", " << height << ", \"" << color << "\", "
+      << filled << ")";
    putPipe(os.str());
 }
 
+void Platform::drawLines(const GWindow & gw, const Vector<GPoint> & points,
+                                             string color) {
+   if (binaryProtocol) {
+      PipeFrame frame(OP_DRAW_LINES);
+      frame.handle(gw.gwd).str(color).integer(points.size());
+      for (const GPoint & pt : points) {
+         frame.real(pt.getX()).real(pt.getY());
+      }
+      frame.send();
+      return;
+   }
+   ostringstream os;
+   os << "GWindow.drawLines(\"" << gw.gwd << "\", \"" << color << "\", "
+                                  << points.size();
+   for (const GPoint & pt : points) {
+      os << ", " << pt.getX() << ", " << pt.getY();
+   }
+   os << ")";
+   putPipe(os.str());
+}
+
+void Platform::setFilled(GObject *gobj, bool flag) {
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_FILLED;
+   pending.filled = flag;
+}
+
+void Platform::setFillColor(GObject *gobj, string color) {
+   PendingObject & pending = getPending(gobj);
+   pending.fields |= STATE_FILL_COLOR;
+   pending.fillColor = color;
+}
+
+void Platform::createGRect(GObject *gobj, double width, double height) {
+   PendingObject & pending = deferCreate(gobj, OP_CREATE_GRECT);
+   pending.args[0] = width;
+   pending.args[1] = height;
+}
+
 void Platform::createGRoundRect(GObject *gobj, double width, double height,
                                                double corner) {
    ostringstream os;
@@ -845,26 +1480,34 @@ void Platform::setRaised(GObject *gobj, bool raised) {
 }
 
 void Platform::createGLabel(GObject *gobj, string label) {
-   ostringstream os;
-   os << "GLabel.create(\"" << gobj << "\", \"" << label << "\")";
-   putPipe(os.str());
+   PendingObject & pending = deferCreate(gobj, OP_CREATE_GLABEL);
+   pending.label = label;
 }
 
 void Platform::createGLine(GObject *gobj, double x1, double y1,
                                           double x2, double y2) {
-   ostringstream os;
-   os << "GLine.create(\"" << gobj << "\", " << x1 << ", " << y1
-                                    << ", " << x2 << ", " << y2 << ")";
-   putPipe(os.str());
+   PendingObject & pending = deferCreate(gobj, OP_CREATE_GLINE);
+   pending.args[0] = x1;
+   pending.args[1] = y1;
+   pending.args[2] = x2;
+   pending.args[3] = y2;
 }
 
 void Platform::setStartPoint(GObject *gobj, double x, double y) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SET_START_POINT).handle(gobj).real(x).real(y).send();
+      return;
+   }
    ostringstream os;
    os << "GLine.setStartPoint(\"" << gobj << "\", " << x << ", " << y << ")";
    putPipe(os.str());
 }
 
 void Platform::setEndPoint(GObject *gobj, double x, double y) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SET_END_POINT).handle(gobj).real(x).real(y).send();
+      return;
+   }
    ostringstream os;
    os << "GLine.setEndPoint(\"" << gobj << "\", " << x << ", " << y << ")";
    putPipe(os.str());
@@ -900,22 +1543,30 @@ GDimension Platform::createGImage(GObject *gobj, string filename) {
 }
 
 void Platform::createGPolygon(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_CREATE_GPOLYGON).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GPolygon.create(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::addVertex(GObject *gobj, double x, double y) {
-   ostringstream os;
-   os << "GPolygon.addVertex(\"" << gobj << "\", " << x << ", " << y << ")";
-   putPipe(os.str());
+   getPending(gobj).vertices.push_back(GPoint(x, y));
+}
+
+void Platform::addVertices(GObject *gobj, const Vector<GPoint> & points) {
+   vector<GPoint> & vertices = getPending(gobj).vertices;
+   for (const GPoint & pt : points) {
+      vertices.push_back(pt);
+   }
 }
 
 void Platform::createGOval(GObject *gobj, double width, double height) {
-   ostringstream os;
-   os << "GOval.create(\"" << gobj << "\", " << width << ", "
-                                              << height << ")";
-   putPipe(os.str());
+   PendingObject & pending = deferCreate(gobj, OP_CREATE_GOVAL);
+   pending.args[0] = width;
+   pending.args[1] = height;
 }
 
 void Platform::setActionCommand(GObject *gobj, string cmd) {
@@ -927,10 +1578,17 @@ void Platform::setActionCommand(GObject *gobj, string cmd) {
 }
 
 GDimension Platform::getSize(GObject *gobj) {
+   pollEvents();
+   if (!interactorSizes.containsKey(gobj)) {
+      interactorSizes.put(gobj, getSizeAsync(gobj).get());
+   }
+   return interactorSizes.get(gobj);
+}
+
+PendingResult<GDimension> Platform::getSizeAsync(GObject *gobj) {
    ostringstream os;
    os << "GInteractor.getSize(\"" << gobj << "\")";
-   putPipe(os.str());
-   return scanDimension(getResult());
+   return PendingResult<GDimension>(sendRequest(os.str()), scanDimension);
 }
 
 void Platform::createGButton(GObject *gobj, string label) {
@@ -963,10 +1621,13 @@ void Platform::createGCheckBox(GObject *gobj, string label) {
 }
 
 bool Platform::isSelected(GObject *gobj) {
+   return isSelectedAsync(gobj).get();
+}
+
+PendingResult<bool> Platform::isSelectedAsync(GObject *gobj) {
    ostringstream os;
    os << "GCheckBox.isSelected(\"" << gobj << "\")";
-   putPipe(os.str());
-   return getResult() == "true";
+   return PendingResult<bool>(sendRequest(os.str()), parseBoolean);
 }
 
 void Platform::setSelected(GObject *gobj, bool state) {
@@ -1033,6 +1694,7 @@ void Platform::createGChooser(GObject *gobj) {
 }
 
 void Platform::addItem(GObject *gobj, string item) {
+   interactorSizes.remove(gobj);
    ostringstream os;
    os << "GChooser.addItem(\"" << gobj << "\", ";
    writeQuotedString(os, item);
@@ -1056,18 +1718,30 @@ void Platform::setSelectedItem(GObject *gobj, string item) {
 }
 
 void Platform::createGCompound(GObject *gobj) {
+   if (binaryProtocol) {
+      PipeFrame(OP_CREATE_GCOMPOUND).handle(gobj).send();
+      return;
+   }
    ostringstream os;
    os << "GCompound.create(\"" << gobj << "\")";
    putPipe(os.str());
 }
 
 void Platform::setFont(GObject *gobj, string font) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SET_FONT).handle(gobj).str(font).send();
+      return;
+   }
    ostringstream os;
    os << "GLabel.setFont(\"" << gobj << "\", \"" << font << "\")";
    putPipe(os.str());
 }
 
 void Platform::setLabel(GObject *gobj, string str) {
+   if (binaryProtocol) {
+      PipeFrame(OP_SET_LABEL).handle(gobj).str(str).send();
+      return;
+   }
    ostringstream os;
    os << "GLabel.setLabel(\"" << gobj << "\", ";
    writeQuotedString(os, str);
@@ -1076,24 +1750,42 @@ void Platform::setLabel(GObject *gobj, string str) {
 }
 
 double Platform::getFontAscent(const GObject *gobj) {
+   return getFontAscentAsync(gobj).get();
+}
+
+double Platform::getFontDescent(const GObject *gobj) {
+   return getFontDescentAsync(gobj).get();
+}
+
+GDimension Platform::getGLabelSize(const GObject *gobj) {
+   return getGLabelSizeAsync(gobj).get();
+}
+
+string Platform::getFontMetrics(string font) {
    ostringstream os;
-   os << "GLabel.getFontAscent(\"" << gobj << "\")";
+   os << "GLabel.getFontMetrics(";
+   writeQuotedString(os, font);
+   os << ")";
    putPipe(os.str());
-   return stringToReal(getResult());
+   return getResult();
 }
 
-double Platform::getFontDescent(const GObject *gobj) {
+PendingResult<double> Platform::getFontAscentAsync(const GObject *gobj) {
+   ostringstream os;
+   os << "GLabel.getFontAscent(\"" << gobj << "\")";
+   return PendingResult<double>(sendRequest(os.str()), parseReal);
+}
+
+PendingResult<double> Platform::getFontDescentAsync(const GObject *gobj) {
    ostringstream os;
    os << "GLabel.getFontDescent(\"" << gobj << "\")";
-   putPipe(os.str());
-   return stringToReal(getResult());
+   return PendingResult<double>(sendRequest(os.str()), parseReal);
 }
 
-GDimension Platform::getGLabelSize(const GObject *gobj) {
+PendingResult<GDimension> Platform::getGLabelSizeAsync(const GObject *gobj) {
    ostringstream os;
    os << "GLabel.getGLabelSize(\"" << gobj << "\")";
-   putPipe(os.str());
-   return scanDimension(getResult());
+   return PendingResult<GDimension>(sendRequest(os.str()), scanDimension);
 }
 
 
@@ -1127,7 +1819,7 @@ std::string Platform::gbufferedimage_load(GObject* gobj, const std::string& file
     writeQuotedString(os, filename);
     os << ")";
     putPipe(os.str());
-    return getResult();
+    return getBulkResult();
 }
 
 void Platform::gbufferedimage_resize(GObject* gobj, double width, double height, bool retain) {
@@ -1146,19 +1838,72 @@ void Platform::gbufferedimage_save(const GObject* const gobj, const std::string&
     getStatus();
 }
 
-std::string Platform::gbufferedimage_scale(const GObject* const gobj, GObject* const gobj2, int w, int h) {
+void Platform::gbufferedimage_markDirty(GObject* gobj) {
+    getPending(gobj).pixels = true;
+}
+
+void Platform::gbufferedimage_updateRegion(GObject* gobj, const Grid<int>& pixels,
+                                           int x, int y, int width, int height) {
+    std::string data;
+    data.reserve(3 * width * height);
+    for (int row = y; row < y + height; row++) {
+        for (int col = x; col < x + width; col++) {
+            int rgb = pixels[row][col];
+            data += char(rgb >> 16);
+            data += char(rgb >> 8);
+            data += char(rgb);
+        }
+    }
+    if (binaryProtocol) {
+        PipeFrame(OP_UPDATE_REGION).handle(gobj).integer(x).integer(y)
+                                   .integer(width).integer(height)
+                                   .str(data).send();
+        return;
+    }
     std::ostringstream os;
-    os << "GBufferedImage.scale(\"" << gobj << "\", \"" << gobj2 << "\", "
-       << w << ", " << h << ")";
+    os << "GBufferedImage.updateRegion(\"" << gobj << "\", " << x << ", " << y
+       << ", " << width << ", " << height << ", \"" << Base64::encode(data) << "\")";
     putPipe(os.str());
-    return getResult();
 }
 
-void Platform::gbufferedimage_setRGB(GObject* gobj, double x, double y,
-                                     int rgb) {
+void Platform::gbufferedimage_updateRegions(GObject* gobj, const Grid<int>& pixels,
+                                            const Vector<GRectangle>& regions) {
+    if (regions.size() == 1) {
+        const GRectangle& r = regions[0];
+        gbufferedimage_updateRegion(gobj, pixels, (int) r.getX(), (int) r.getY(),
+                                    (int) r.getWidth(), (int) r.getHeight());
+        return;
+    }
+    std::string data;
+    for (const GRectangle& r : regions) {
+        int x = (int) r.getX();
+        int y = (int) r.getY();
+        for (int row = y; row < y + (int) r.getHeight(); row++) {
+            for (int col = x; col < x + (int) r.getWidth(); col++) {
+                int rgb = pixels[row][col];
+                data += char(rgb >> 16);
+                data += char(rgb >> 8);
+                data += char(rgb);
+            }
+        }
+    }
+    if (binaryProtocol) {
+        PipeFrame frame(OP_UPDATE_REGIONS);
+        frame.handle(gobj).integer(regions.size());
+        for (const GRectangle& r : regions) {
+            frame.integer((int) r.getX()).integer((int) r.getY())
+                 .integer((int) r.getWidth()).integer((int) r.getHeight());
+        }
+        frame.str(data).send();
+        return;
+    }
     std::ostringstream os;
-    os << "GBufferedImage.setRGB(\"" << gobj << "\", " << (int) x << ", "
-       << (int) y << ", " << rgb << ")";
+    os << "GBufferedImage.updateRegions(\"" << gobj << "\", " << regions.size();
+    for (const GRectangle& r : regions) {
+        os << ", " << (int) r.getX() << ", " << (int) r.getY()
+           << ", " << (int) r.getWidth() << ", " << (int) r.getHeight();
+    }
+    os << ", \"" << Base64::encode(data) << "\")";
     putPipe(os.str());
 }
 
@@ -1249,6 +1994,10 @@ void Platform::gtextarea_create(GObject* gobj, double width, double height) {
 }
 
 void Platform::gtextarea_setText(GObject* gobj, std::string text) {
+    if (binaryProtocol) {
+        PipeFrame(OP_SET_TEXT).handle(gobj).str(text).send();
+        return;
+    }
     ostringstream os;
     os << "GTextArea.setText(\"" << gobj << "\", ";
     writeQuotedString(os, text);
@@ -1260,7 +2009,7 @@ std::string Platform::gtextarea_getText(const GObject* gobj) {
     ostringstream os;
     os << "GTextArea.getText(\"" << gobj << "\")";
     putPipe(os.str());
-    return getResult();
+    return getBulkResult();
 }
 
 void Platform::gtextarea_setFont(GObject* gobj, std::string font) {
@@ -1288,6 +2037,7 @@ void Platform::gtextarea_setBackgroundColor(GObject* gobj, std::string rgb) {
 
 GEvent Platform::getNextEvent(int mask) {
    cout.flush();
+   eventMask = mask;
    if (eventQueue.isEmpty()) {
       putPipe("GEvent.getNextEvent(" + integerToString(mask) + ")");
       getResult(false);
@@ -1298,6 +2048,7 @@ GEvent Platform::getNextEvent(int mask) {
 
 GEvent Platform::waitForEvent(int mask) {
    cout.flush();
+   eventMask = mask;
    while (eventQueue.isEmpty()) {
       putPipe("GEvent.waitForEvent(" + integerToString(mask) + ")");
       getResult(false);
@@ -1309,23 +2060,162 @@ bool Platform::isBlockedForConsoleIO() {
     return cinout_buf && cinout_buf->isBlocked();
 }
 
+bool Platform::isHeadless() {
+   return headlessBackEnd != NULL;
+}
+
+Grid<int> Platform::getWindowPixels(const GWindow & gw) {
+   if (headlessBackEnd == NULL) {
+      error("getWindowPixels: Requires the headless back end");
+   }
+   flushPipe();
+   ostringstream os;
+   os << gw.gwd;
+   return headlessBackEnd->getPixels(os.str());
+}
+
 void Platform::exitGraphics() {
   if (isBlockedForConsoleIO()) {
       // graphical console is blocked waiting for an I/O read;
       // won't be able to exit graphics in the JBE anyway; just kill the JBE and exit
-#ifdef _WIN32
-      // A bit harsh, but seems to work.
-      TerminateProcess(pInfo.hProcess, 0);
-#else
-      kill(child, SIGTERM);
-#endif
+      backEnd->terminate();
       exit(0);
   } else {
       putPipe("GWindow.exitGraphics()");
+      flushPipe();
       exit(0);
   }
 }
 
+void Platform::beginBatch() {
+   batchDepth++;
+}
+
+void Platform::endBatch() {
+   if (batchDepth == 0) error("endBatch: No batch is in progress");
+   batchDepth--;
+   endFrame();
+}
+
+void Platform::flush() {
+   flushPipe();
+}
+
+int Platform::sendRequest(const string & command) {
+   putPipe(command);
+   if (statsEnabled) {
+      PendingStats pending = { nextRequestId, lastStats, statsClock() };
+      pendingStats.enqueue(pending);
+   }
+   return nextRequestId++;
+}
+
+string Platform::awaitResult(int id) {
+   if (earlyResults.containsKey(id)) {
+      string result = earlyResults.get(id);
+      earlyResults.remove(id);
+      return result;
+   }
+   if (id < nextReplyId || id >= nextRequestId) {
+      error("Platform::awaitResult: No request with that id is pending");
+   }
+   while (true) {
+      int replyId = nextReplyId;
+      string result = readRequestResult();
+      if (replyId == id) return result;
+      earlyResults.put(replyId, result);
+   }
+}
+
+void Platform::setProtocolStatsEnabled(bool flag) {
+   statsEnabled = flag;
+   if (!flag) pendingStats.clear();
+}
+
+bool Platform::isProtocolStatsEnabled() {
+   return statsEnabled;
+}
+
+void Platform::resetProtocolStats() {
+   for (string name : commandStats) {
+      delete commandStats[name];
+   }
+   commandStats.clear();
+   lastStats = NULL;
+   lastStatsName.clear();
+   pendingStats.clear();
+}
+
+/*
+ * Implementation notes: getProtocolStats
+ * --------------------------------------
+ * The CSV form has one row per command, sorted by name, with the
+ * histogram in the trailing columns; the heading of each histogram
+ * column gives the upper limit of its bucket in microseconds.  The JSON
+ * form is an object that maps the command names to objects with the
+ * same fields, along with the list of bucket limits.
+ */
+
+string Platform::getProtocolStats(string format) {
+   format = toLowerCase(format);
+   if (format != "csv" && format != "json") {
+      error("getProtocolStats: Unknown format " + format);
+   }
+   Vector<string> names;
+   for (string name : commandStats) {
+      names.add(name);
+   }
+   sort(names.begin(), names.end());
+   ostringstream os;
+   bool json = format == "json";
+   if (json) {
+      os << "{\n  \"bucketLimitsMicros\": [";
+      for (int k = 0; k < LATENCY_BUCKETS - 1; k++) {
+         os << ((k == 0) ? "" : ", ") << (1LL << (k + 1));
+      }
+      os << "],\n  \"commands\": {";
+   } else {
+      os << "command,count,bytesSent,results,bytesReceived,meanMicros,maxMicros";
+      for (int k = 0; k < LATENCY_BUCKETS - 1; k++) {
+         os << ",lt" << (1LL << (k + 1)) << "us";
+      }
+      os << ",ge" << (1LL << (LATENCY_BUCKETS - 1)) << "us\n";
+   }
+   os << fixed << setprecision(1);
+   for (int i = 0; i < names.size(); i++) {
+      CommandStats *stats = commandStats[names[i]];
+      double mean = (stats->results == 0) ? 0 : stats->totalMicros / stats->results;
+      if (json) {
+         os << ((i == 0) ? "\n    " : ",\n    ");
+         writeQuotedString(os, names[i], true);
+         os << ": {\"count\": " << stats->count
+            << ", \"bytesSent\": " << stats->bytesSent
+            << ", \"results\": " << stats->results
+            << ", \"bytesReceived\": " << stats->bytesReceived
+            << ", \"meanMicros\": " << mean
+            << ", \"maxMicros\": " << stats->maxMicros
+            << ", \"histogram\": [";
+      } else {
+         os << names[i] << "," << stats->count << "," << stats->bytesSent
+            << "," << stats->results << "," << stats->bytesReceived
+            << "," << mean << "," << stats->maxMicros;
+      }
+      for (int k = 0; k < LATENCY_BUCKETS; k++) {
+         os << ((json && k == 0) ? "" : (json) ? ", " : ",") << stats->histogram[k];
+      }
+      os << ((json) ? "]}" : "\n");
+   }
+   if (json) os << ((names.isEmpty()) ? "}\n}\n" : "\n  }\n}\n");
+   return os.str();
+}
+
+void Platform::writeProtocolStats(string filename) {
+   ofstream out(filename.c_str());
+   if (out.fail()) error("writeProtocolStats: Can't open " + filename);
+   out << getProtocolStats(endsWith(toLowerCase(filename), ".json") ? "json" : "csv");
+   if (out.fail()) error("writeProtocolStats: Can't write " + filename);
+}
+
 Platform *getPlatform() {
    static Platform gp;
    return &gp;
@@ -1343,7 +2233,7 @@ int startupMain(int argc, char **argv) {
    argvMain = argv;
    exceptions::setProgramNameForStackTrace(argv[0]);
    programName = getRoot(getTail(argv[0]));
-   initPipe();
+   initBackEnd();
    cinout_buf = new ConsoleStreambuf();
    cin.rdbuf(cinout_buf);
    cout.rdbuf(cinout_buf);
@@ -1410,35 +2300,42 @@ static void initPipe() {
    tracePipe = trace != NULL && startsWith(toLowerCase(trace), "t");
    if (tracePipe)
     logfile.open("JBElog.txt");
+   atexit(flushPipeAtExit);
+   initProtocol();
 }
 
-static void putPipe(string line) {
+static void writePipe(const char *data, size_t length) {
+   while (length > 0) {
+      DWORD nch;
+      if (!WriteFile(wrToJBE, data, length, &nch, NULL)) {
+         error("Could not write to JBE");
+      }
+      data += nch;
+      length -= nch;
+   }
+}
+
+static size_t readPipe(char *buffer, size_t size) {
    DWORD nch;
-   if (!WriteFile(wrToJBE, line.c_str(), line.length(), &nch, NULL))
-     error("Could not write to JBE");
-   if (!WriteFile(wrToJBE, "\n", 1, &nch, NULL))
-     error("Could not write to JBE");
-   if (tracePipe) {
-       logfile << "--> " << line << endl; // JL
+   if (!ReadFile(rdFromJBE, buffer, size, &nch, NULL) || nch == 0) {
+      error("Could not read from JBE");
    }
-   //FlushFileBuffers(wrToJBE);
+   return nch;
+}
 
+static bool pollPipe() {
+   DWORD available = 0;
+   return PeekNamedPipe(rdFromJBE, NULL, 0, NULL, &available, NULL)
+       && available > 0;
+}
 
+void PipeBackEnd::terminate() {
+   // A bit harsh, but seems to work.
+   TerminateProcess(pInfo.hProcess, 0);
 }
 
-static string getPipe() {
-   string line = "";
-   DWORD nch;
-   while (true) {
-      char ch;
-      ReadFile(rdFromJBE, &ch, 1, &nch, NULL);
-      if (ch == '\n' || ch == '\r') break;
-      line += ch;
-   }
-   if (tracePipe) {
-       logfile << "<-- " << line << endl; // JL
-   }
-   return line;
+static void initSharedMemory() {
+   /* Bulk data goes through the pipe on Windows */
 }
 
 #else
@@ -1495,7 +2392,7 @@ int startupMain(int argc, char **argv) {
       return Main();
    }
    scanOptions();
-   initPipe();
+   initBackEnd();
    cinout_buf = new ConsoleStreambuf();
    cin.rdbuf(cinout_buf);
    cout.rdbuf(cinout_buf);
@@ -1551,45 +2448,665 @@ static void initPipe() {
       pout = toJBE[1];
       close(fromJBE[1]);
       close(toJBE[0]);
+      atexit(flushPipeAtExit);
+      initProtocol();
    }
 }
 
-static void putPipe(string line) {
-   write(pout, line.c_str(), line.length());
-   write(pout, "\n", 1);
-   if (tracePipe) logfile << "-> " << line << endl;
+static void writePipe(const char *data, size_t length) {
+   while (length > 0) {
+      ssize_t nch = write(pout, data, length);
+      if (nch < 0) {
+         if (errno == EINTR) continue;
+         error("Could not write to JBE");
+      }
+      data += nch;
+      length -= nch;
+   }
 }
 
-static string getPipe() {
-   string line = "";
-   while (true) {
-      char ch;
-      read(pin, &ch, 1);
-      if (ch == '\n') break;
-      line += ch;
+static size_t readPipe(char *buffer, size_t size) {
+   ssize_t nch;
+   do {
+      nch = read(pin, buffer, size);
+   } while (nch < 0 && errno == EINTR);
+   if (nch <= 0) error("Could not read from JBE");
+   return nch;
+}
+
+static bool pollPipe() {
+   struct pollfd fds;
+   fds.fd = pin;
+   fds.events = POLLIN;
+   return poll(&fds, 1, 0) > 0;
+}
+
+void PipeBackEnd::terminate() {
+   kill(child, SIGTERM);
+}
+
+/*
+ * Function: initSharedMemory
+ * Usage: initSharedMemory();
+ * --------------------------
+ * Creates the shared-memory region and asks the back end to map it.  If
+ * any step fails, sharedRegion stays NULL and bulk data goes through the
+ * pipe.  The file is unlinked as soon as both sides have mapped it, so
+ * that it disappears with the processes.
+ */
+
+static void initSharedMemory() {
+   string dir = "/dev/shm";
+   if (!isDirectory(dir)) {
+      char *tmp = getenv("TMPDIR");
+      dir = (tmp == NULL) ? "/tmp" : tmp;
+   }
+   string path = dir + "/spl-" + integerToString(getpid());
+   int fd = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+   if (fd < 0) return;
+   size_t size = SHARED_HEADER_SIZE + 2 * SHARED_RING_SIZE;
+   void *addr = MAP_FAILED;
+   if (ftruncate(fd, size) == 0) {
+      addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   close(fd);
+   if (addr != MAP_FAILED) {
+      ostringstream os;
+      os << "JBE.openSharedMemory(";
+      writeQuotedString(os, path);
+      os << ", " << size << ")";
+      putPipe(os.str());
+      if (getResult() == "ok") {
+         sharedRegion = (char *) addr;
+      } else {
+         munmap(addr, size);
+      }
+   }
+   unlink(path.c_str());
+}
+
+#endif
+
+/*
+ * Function: initProtocol
+ * Usage: initProtocol();
+ * ----------------------
+ * Asks the back end to switch to the binary protocol unless the text
+ * protocol has been requested.  The request itself is sent as text, and
+ * a back end that does not understand it leaves both sides in text mode.
+ */
+
+static void initProtocol() {
+   char *protocol = getenv("JBEPROTOCOL");
+   if (tracePipe || (protocol != NULL && toLowerCase(protocol) == "text")) {
+      return;
+   }
+   putPipe("JBE.setProtocol(\"binary\")");
+   binaryProtocol = getResult() == "binary";
+   if (binaryProtocol) initSharedMemory();
+}
+
+/*
+ * Function: putShared
+ * Usage: int64_t pos = putShared(text);
+ * -------------------------------------
+ * Copies text into the outbound ring and returns its position, or
+ * returns -1 if the ring does not have room for it.
+ */
+
+static int64_t putShared(const string & text) {
+   size_t length = text.length();
+   uint64_t pos = sharedWritten;
+   size_t offset = pos % SHARED_RING_SIZE;
+   if (offset + length > SHARED_RING_SIZE) pos += SHARED_RING_SIZE - offset;
+   uint64_t consumed = *(volatile uint64_t *) (sharedRegion + OUT_CONSUMED);
+   if (pos + length - consumed > SHARED_RING_SIZE) return -1;
+   memcpy(sharedRegion + SHARED_HEADER_SIZE + pos % SHARED_RING_SIZE,
+          text.data(), length);
+   sharedWritten = pos + length;
+   return pos;
+}
+
+void PipeFrame::send() {
+   uint32_t length = pipeBuffer.length() - start - 4;
+   pipeBuffer[start] = char(length >> 24);
+   pipeBuffer[start + 1] = char(length >> 16);
+   pipeBuffer[start + 2] = char(length >> 8);
+   pipeBuffer[start + 3] = char(length);
+   if (statsEnabled) countFrame(start);
+   if (batchDepth == 0 && pipeBuffer.length() >= PIPE_FLUSH_THRESHOLD) {
+      flushPipe();
+   }
+}
+
+static void putPipe(const string & line) {
+   if (!pendingObjects.empty()) flushPending();
+   if (binaryProtocol) {
+      PipeFrame(OP_TEXT).raw(line).send();
+      return;
+   }
+   pipeBuffer += line;
+   pipeBuffer += '\n';
+   if (statsEnabled) {
+      countCommand(line.data(), min(line.find('('), line.length()),
+                   line.length() + 1);
+   }
+   if (tracePipe) {
+#ifdef _WIN32
+      logfile << "--> " << line << endl; // JL
+#else
+      logfile << "-> " << line << endl;
+#endif
+   }
+   if (batchDepth == 0 && pipeBuffer.length() >= PIPE_FLUSH_THRESHOLD) {
+      flushPipe();
    }
-   if (tracePipe) logfile << "<- " << line << endl;
-   return line;
 }
 
+/*
+ * Function: getPipe
+ * Usage: const string & line = getPipe();
+ * ---------------------------------------
+ * Reads the next line from the back end.  The result refers to storage
+ * that is reused by the next call.  A carriage return before the newline
+ * is dropped, since the back end on Windows ends its lines with both.
+ */
+
+static const string & getPipe() {
+   pipeLine.clear();
+   while (true) {
+      if (pipeReadStart == pipeReadEnd) fillPipe();
+      const char *start = pipeReadBuffer + pipeReadStart;
+      size_t available = pipeReadEnd - pipeReadStart;
+      const char *newline = (const char *) memchr(start, '\n', available);
+      if (newline != NULL) {
+         pipeLine.append(start, newline - start);
+         pipeReadStart += newline - start + 1;
+         break;
+      }
+      pipeLine.append(start, available);
+      pipeReadStart = pipeReadEnd;
+   }
+   if (statsEnabled) replyBytes += pipeLine.length() + 1;
+   if (!pipeLine.empty() && pipeLine[pipeLine.length() - 1] == '\r') {
+      pipeLine.erase(pipeLine.length() - 1);
+   }
+   if (tracePipe) {
+#ifdef _WIN32
+      logfile << "<-- " << pipeLine << endl; // JL
+#else
+      logfile << "<- " << pipeLine << endl;
 #endif
+   }
+   return pipeLine;
+}
+
+/*
+ * Function: initBackEnd
+ * Usage: initBackEnd();
+ * ---------------------
+ * Starts the back end selected by the JBEBACKEND environment variable.
+ * The headless back end declines the binary protocol, so initProtocol
+ * leaves the text protocol in place and creates no shared memory.
+ */
+
+static void initBackEnd() {
+   char *stats = getenv("JBESTATS");
+   if (stats != NULL && *stats != '\0') {
+      statsFilename = stats;
+      statsEnabled = true;
+      atexit(writeStatsAtExit);
+   }
+   char *name = getenv("JBEBACKEND");
+   if (name != NULL && toLowerCase(name) == "headless") {
+      headlessBackEnd = new HeadlessBackEnd();
+      backEnd = headlessBackEnd;
+      atexit(flushPipeAtExit);
+      initProtocol();
+   } else {
+      initPipe();
+   }
+}
+
+void PipeBackEnd::sendCommands(const char *data, size_t length) {
+   writePipe(data, length);
+}
+
+size_t PipeBackEnd::readReplies(char *buffer, size_t size) {
+   return readPipe(buffer, size);
+}
+
+bool PipeBackEnd::repliesReady() {
+   return pollPipe();
+}
+
+/*
+ * Function: flushPipe
+ * Usage: flushPipe();
+ * -------------------
+ * Sends the commands in pipeBuffer to the back end.  The buffer is
+ * emptied even if the back end fails, so that the exit handler does not
+ * try to send the same commands again.
+ */
+
+static void flushPipe() {
+   if (!pendingObjects.empty()) flushPending();
+   try {
+      backEnd->sendCommands(pipeBuffer.data(), pipeBuffer.length());
+   } catch (...) {
+      pipeBuffer.clear();
+      throw;
+   }
+   pipeBuffer.clear();
+}
+
+static void fillPipe() {
+   pipeReadStart = 0;
+   pipeReadEnd = backEnd->readReplies(pipeReadBuffer, PIPE_READ_BUFFER_SIZE);
+}
+
+/*
+ * Function: getPending
+ * Usage: PendingObject & pending = getPending(gobj);
+ * -------------------------------------------------
+ * Returns the entry in pendingObjects for gobj, creating it if needed.
+ * The most recently added entry is checked first, since consecutive
+ * changes usually apply to the same object.
+ */
+
+static PendingObject & getPending(GObject *gobj) {
+   if (!pendingObjects.empty() && pendingObjects.back().gobj == gobj) {
+      return pendingObjects.back();
+   }
+   if (pendingIndex.containsKey(gobj)) {
+      return pendingObjects[pendingIndex.get(gobj)];
+   }
+   pendingIndex.put(gobj, pendingObjects.size());
+   pendingObjects.push_back(PendingObject());
+   PendingObject & pending = pendingObjects.back();
+   pending.gobj = gobj;
+   pending.create = OP_TEXT;
+   pending.fields = 0;
+   pending.pixels = false;
+   return pending;
+}
+
+/*
+ * Function: deferCreate
+ * Usage: PendingObject & pending = deferCreate(gobj, op);
+ * -------------------------------------------------------
+ * Returns a new entry for gobj whose create command has the specified
+ * opcode.  The caller fills in the arguments.
+ */
+
+static PendingObject & deferCreate(GObject *gobj, int op) {
+   if (pendingIndex.containsKey(gobj)) flushPending();
+   PendingObject & pending = getPending(gobj);
+   pending.create = op;
+   return pending;
+}
+
+/*
+ * Function: sendCreate
+ * Usage: sendCreate(pending);
+ * ---------------------------
+ * Sends the deferred create command of a pending object.
+ */
+
+static void sendCreate(const PendingObject & pending) {
+   const double *args = pending.args;
+   GObject *gobj = pending.gobj;
+   if (binaryProtocol) {
+      PipeFrame frame((Opcode) pending.create);
+      frame.handle(gobj);
+      if (pending.create == OP_CREATE_GLABEL) {
+         frame.str(pending.label);
+      } else {
+         int nArgs = (pending.create == OP_CREATE_GLINE) ? 4 : 2;
+         for (int i = 0; i < nArgs; i++) {
+            frame.real(args[i]);
+         }
+      }
+      frame.send();
+      return;
+   }
+   ostringstream os;
+   switch (pending.create) {
+   case OP_CREATE_GRECT:
+      os << "GRect.create(\"" << gobj << "\", " << args[0] << ", "
+                                                 << args[1] << ")";
+      break;
+   case OP_CREATE_GOVAL:
+      os << "GOval.create(\"" << gobj << "\", " << args[0] << ", "
+                                                 << args[1] << ")";
+      break;
+   case OP_CREATE_GLINE:
+      os << "GLine.create(\"" << gobj << "\", " << args[0] << ", " << args[1]
+                                       << ", " << args[2] << ", " << args[3] << ")";
+      break;
+   case OP_CREATE_GLABEL:
+      os << "GLabel.create(\"" << gobj << "\", \"" << pending.label << "\")";
+      break;
+   }
+   putPipe(os.str());
+}
 
-static string getResult(bool consumeAcks) {
+/*
+ * Function: sendState
+ * Usage: sendState(pending);
+ * --------------------------
+ * Sends the changed properties of a pending object.  A single property
+ * goes out as its usual command; several go out as GObject.setState,
+ * whose arguments after the flags are those of the individual commands
+ * in the order of the STATE flags.
+ */
+
+static void sendState(const PendingObject & pending) {
+   static const int FLAGS[] = {
+      STATE_LOCATION, STATE_SIZE, STATE_COLOR, STATE_FILL_COLOR,
+      STATE_FILLED, STATE_VISIBLE, STATE_LINE_WIDTH
+   };
+   static const Opcode OPS[] = {
+      OP_SET_LOCATION, OP_SET_SIZE, OP_SET_COLOR, OP_SET_FILL_COLOR,
+      OP_SET_FILLED, OP_SET_VISIBLE, OP_SET_LINE_WIDTH
+   };
+   int fields = pending.fields;
+   Opcode op = OP_SET_STATE;
+   for (int i = 0; i < 7; i++) {
+      if (fields == FLAGS[i]) op = OPS[i];
+   }
+   if (binaryProtocol) {
+      PipeFrame frame(op);
+      frame.handle(pending.gobj);
+      if (op == OP_SET_STATE) frame.integer(fields);
+      if (fields & STATE_LOCATION) frame.real(pending.x).real(pending.y);
+      if (fields & STATE_SIZE) frame.real(pending.width).real(pending.height);
+      if (fields & STATE_COLOR) frame.str(pending.color);
+      if (fields & STATE_FILL_COLOR) frame.str(pending.fillColor);
+      if (fields & STATE_FILLED) frame.boolean(pending.filled);
+      if (fields & STATE_VISIBLE) frame.boolean(pending.visible);
+      if (fields & STATE_LINE_WIDTH) frame.real(pending.lineWidth);
+      frame.send();
+      return;
+   }
+   ostringstream os;
+   os << boolalpha << OPCODE_NAMES[op] << "(\"" << pending.gobj << "\"";
+   if (op == OP_SET_STATE) os << ", " << fields;
+   if (fields & STATE_LOCATION) os << ", " << pending.x << ", " << pending.y;
+   if (fields & STATE_SIZE) os << ", " << pending.width << ", " << pending.height;
+   if (fields & STATE_COLOR) os << ", \"" << pending.color << "\"";
+   if (fields & STATE_FILL_COLOR) os << ", \"" << pending.fillColor << "\"";
+   if (fields & STATE_FILLED) os << ", " << pending.filled;
+   if (fields & STATE_VISIBLE) os << ", " << pending.visible;
+   if (fields & STATE_LINE_WIDTH) os << ", " << pending.lineWidth;
+   os << ")";
+   putPipe(os.str());
+}
+
+/*
+ * Function: sendVertices
+ * Usage: sendVertices(pending);
+ * -----------------------------
+ * Sends the vertices added to a pending GPolygon, using the original
+ * GPolygon.addVertex command when there is only one.
+ */
+
+static void sendVertices(const PendingObject & pending) {
+   const vector<GPoint> & vertices = pending.vertices;
+   if (binaryProtocol) {
+      if (vertices.size() == 1) {
+         PipeFrame(OP_ADD_VERTEX).handle(pending.gobj).real(vertices[0].getX())
+                                 .real(vertices[0].getY()).send();
+         return;
+      }
+      PipeFrame frame(OP_ADD_VERTICES);
+      frame.handle(pending.gobj).integer(vertices.size());
+      for (const GPoint & pt : vertices) {
+         frame.real(pt.getX()).real(pt.getY());
+      }
+      frame.send();
+      return;
+   }
+   ostringstream os;
+   if (vertices.size() == 1) {
+      os << "GPolygon.addVertex(\"" << pending.gobj << "\", "
+         << vertices[0].getX() << ", " << vertices[0].getY() << ")";
+   } else {
+      os << "GPolygon.addVertices(\"" << pending.gobj << "\", " << vertices.size();
+      for (const GPoint & pt : vertices) {
+         os << ", " << pt.getX() << ", " << pt.getY();
+      }
+      os << ")";
+   }
+   putPipe(os.str());
+}
+
+/*
+ * Function: flushPending
+ * Usage: flushPending();
+ * ----------------------
+ * Sends the deferred commands in pendingObjects.  The entries are moved
+ * out of pendingObjects first, so that the commands sent here do not
+ * call flushPending again.
+ */
+
+static void flushPending() {
+   vector<PendingObject> pending;
+   pending.swap(pendingObjects);
+   pendingIndex.clear();
+   for (const PendingObject & entry : pending) {
+      if (entry.gobj == NULL) continue;
+      if (entry.create != OP_TEXT) sendCreate(entry);
+      if (entry.fields != 0) sendState(entry);
+      if (!entry.vertices.empty()) sendVertices(entry);
+      if (entry.pixels) static_cast<GBufferedImage *>(entry.gobj)->flush();
+   }
+   pending.clear();
+   if (pendingObjects.empty()) pending.swap(pendingObjects);
+}
+
+/*
+ * Function: countCommand
+ * Usage: countCommand(name, length, bytes);
+ * -----------------------------------------
+ * Counts a command whose name consists of the first length characters of
+ * name and which occupies the specified number of bytes in the pipe.
+ */
+
+static void countCommand(const char *name, size_t length, size_t bytes) {
+   if (lastStats == NULL || lastStatsName.compare(0, string::npos, name, length) != 0) {
+      lastStatsName.assign(name, length);
+      lastStats = commandStats.get(lastStatsName);
+      if (lastStats == NULL) {
+         lastStats = new CommandStats();
+         commandStats.put(lastStatsName, lastStats);
+      }
+   }
+   lastStats->count++;
+   lastStats->bytesSent += bytes;
+}
+
+/*
+ * Function: countFrame
+ * Usage: countFrame(start);
+ * -------------------------
+ * Counts the binary frame that begins at index start in pipeBuffer.  The
+ * name of an OP_TEXT frame is taken from the text it carries.
+ */
+
+static void countFrame(size_t start) {
+   size_t bytes = pipeBuffer.length() - start;
+   int op = ((unsigned char) pipeBuffer[start + 4] << 8)
+          | (unsigned char) pipeBuffer[start + 5];
+   if (op == OP_TEXT) {
+      const char *text = pipeBuffer.data() + start + 6;
+      const char *paren = (const char *) memchr(text, '(', bytes - 6);
+      countCommand(text, (paren == NULL) ? bytes - 6 : paren - text, bytes);
+   } else {
+      countCommand(OPCODE_NAMES[op], strlen(OPCODE_NAMES[op]), bytes);
+   }
+}
+
+/*
+ * Function: countResult
+ * Usage: countResult(stats, start, bytes);
+ * ----------------------------------------
+ * Records a result of the specified size whose round trip began at the
+ * time start, as returned by statsClock.
+ */
+
+static void countResult(CommandStats *stats, double start, long long bytes) {
+   if (stats == NULL) return;
+   double micros = statsClock() - start;
+   int bucket = 0;
+   while (bucket < LATENCY_BUCKETS - 1 && micros >= (2LL << bucket)) {
+      bucket++;
+   }
+   stats->results++;
+   stats->bytesReceived += bytes;
+   stats->totalMicros += micros;
+   stats->maxMicros = max(stats->maxMicros, micros);
+   stats->histogram[bucket]++;
+}
+
+/*
+ * Function: statsClock
+ * Usage: double micros = statsClock();
+ * ------------------------------------
+ * Returns the time in microseconds from an arbitrary origin.
+ */
+
+static double statsClock() {
+   return chrono::duration<double,micro>(
+             chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Function: writeStatsAtExit
+ * Usage: atexit(writeStatsAtExit);
+ * --------------------------------
+ * Writes the protocol statistics to the file named by JBESTATS.  Errors
+ * are ignored, since the program is already on its way out.
+ */
+
+static void writeStatsAtExit() {
+   try {
+      getPlatform()->writeProtocolStats(statsFilename);
+   } catch (...) {
+      /* Empty */
+   }
+}
+
+/*
+ * Function: flushPipeAtExit
+ * Usage: atexit(flushPipeAtExit);
+ * -------------------------------
+ * Sends any commands still buffered when the program exits.  Errors are
+ * ignored, since the back end may already be gone.
+ */
+
+static void flushPipeAtExit() {
+   try {
+      flushPipe();
+   } catch (...) {
+      /* Empty */
+   }
+}
+
+/*
+ * Function: endFrame
+ * Usage: endFrame();
+ * ------------------
+ * Marks a point at which the user expects the display to be up to date.
+ * The buffered commands are sent unless a batch is in progress.
+ */
+
+static void endFrame() {
+   if (batchDepth == 0) flushPipe();
+}
+
+static string getResult(bool consumeAcks, bool *bulk) {
+   while (nextReplyId < nextRequestId) {
+      int replyId = nextReplyId;
+      earlyResults.put(replyId, readRequestResult());
+   }
+   if (!statsEnabled) return readResult(consumeAcks, bulk);
+   CommandStats *stats = lastStats;
+   double start = statsClock();
+   long long bytes = replyBytes;
+   string result = readResult(consumeAcks, bulk);
+   countResult(stats, start, replyBytes - bytes);
+   return result;
+}
+
+/*
+ * Function: readRequestResult
+ * Usage: string result = readRequestResult();
+ * -------------------------------------------
+ * Reads the result of the pipelined request numbered nextReplyId and
+ * advances nextReplyId.
+ */
+
+static string readRequestResult() {
+   int replyId = nextReplyId++;
+   if (!statsEnabled) return readResult();
+   long long bytes = replyBytes;
+   string result = readResult();
+   while (!pendingStats.isEmpty() && pendingStats.peek().id < replyId) {
+      pendingStats.dequeue();
+   }
+   if (!pendingStats.isEmpty() && pendingStats.peek().id == replyId) {
+      PendingStats pending = pendingStats.dequeue();
+      countResult(pending.stats, pending.start, replyBytes - bytes);
+   }
+   return result;
+}
+
+/*
+ * Function: getBulkResult
+ * Usage: string data = getBulkResult();
+ * -------------------------------------
+ * Waits for the result of a command whose answer may be large.  The
+ * back end sends such a result through the shared-memory ring when it
+ * can, and otherwise in the pipe encoded in Base64.
+ */
+
+static string getBulkResult() {
+   bool bulk = false;
+   string result = getResult(true, &bulk);
+   return (bulk) ? result : Base64::decode(result);
+}
+
+static string readResult(bool consumeAcks, bool *bulk) {
+   flushPipe();
    while (true) {
-      string line = getPipe();
-      if (startsWith(line, "result:")) {
+      // The prefixes are tested in place, since startsWith would copy
+      // what may be a multi-megabyte line.
+      const string & line = getPipe();
+      if (line.compare(0, 7, "result:") == 0) {
           if (!(consumeAcks && line == "result:___jbe___ack___")) {
               // this is just an acknowledgment of some previous event;
               // keep waiting for a real result
               return line.substr(7);
           }
       }
-      if (startsWith(line, "event:")) {
-         eventQueue.enqueue(parseEvent(line.substr(6)));
+      if (line.compare(0, 6, "event:") == 0) {
+         handleEvent(line.substr(6));
       }
-      if (startsWith(line, "error:")) {
+      if (line.compare(0, 6, "error:") == 0) {
           error(string("Java backend: ") + line.substr(6));
       }
+      if (line.compare(0, 5, "bulk:") == 0) {
+         uint64_t pos = 0;
+         size_t length = 0;
+         sscanf(line.c_str() + 5, "%llu,%zu", (unsigned long long *) &pos, &length);
+         string data(sharedRegion + SHARED_HEADER_SIZE + SHARED_RING_SIZE
+                     + pos % SHARED_RING_SIZE, length);
+         *(volatile uint64_t *) (sharedRegion + IN_CONSUMED) = pos + length;
+         if (statsEnabled) replyBytes += length;
+         if (bulk != NULL) *bulk = true;
+         return data;
+      }
    }
 }
 
@@ -1598,6 +3115,49 @@ static void getStatus() {
    if (result != "ok") error(result);
 }
 
+/*
+ * Function: handleEvent
+ * Usage: handleEvent(line);
+ * -------------------------
+ * Parses the event in line, which follows the "event:" prefix, and adds
+ * it to eventQueue unless it is a windowResized event outside the mask
+ * of the last request for events.  The back end sends those regardless
+ * of the mask so that the cached sizes can be discarded.
+ */
+
+static void handleEvent(const string & line) {
+   GEvent e = parseEvent(line);
+   if (e.getEventType() != WINDOW_RESIZED || (eventMask & WINDOW_EVENT) != 0) {
+      eventQueue.enqueue(e);
+   }
+}
+
+/*
+ * Function: pollEvents
+ * Usage: pollEvents();
+ * --------------------
+ * Handles the event lines that the back end has already sent, without
+ * waiting for more.  Processing stops at the first line that is not a
+ * complete event, which is left for the reader that expects it, so the
+ * replies to outstanding requests keep their order.
+ */
+
+static void pollEvents() {
+   while (true) {
+      if (pipeReadStart == pipeReadEnd) {
+         if (!backEnd->repliesReady()) return;
+         fillPipe();
+      }
+      const char *start = pipeReadBuffer + pipeReadStart;
+      size_t available = pipeReadEnd - pipeReadStart;
+      if (available < 6 || memcmp(start, "event:", 6) != 0
+                        || memchr(start, '\n', available) == NULL) {
+         return;
+      }
+      handleEvent(getPipe().substr(6));
+   }
+}
+
 static GEvent parseEvent(string line) {
    TokenScanner scanner(line);
    scanner.ignoreWhitespace();
@@ -1707,7 +3267,9 @@ static GEvent parseWindowEvent(TokenScanner & scanner, EventType type) {
    scanner.verifyToken(",");
    double time = scanDouble(scanner);
    scanner.verifyToken(")");
-   GWindowEvent e(type, GWindow(windowTable.get(id)));
+   GWindowData *gwd = windowTable.get(id);
+   if (type == WINDOW_RESIZED && gwd != NULL) forgetSizes(gwd);
+   GWindowEvent e(type, GWindow(gwd));
    e.setEventTime(time);
    return e;
 }
@@ -1755,6 +3317,11 @@ static string getLineConsole() {
 }
 
 static void putConsole(const string & str, bool isStdErr) {
+   if (binaryProtocol) {
+      PipeFrame(OP_PRINT).str(str).boolean(isStdErr).send();
+      endFrame();
+      return;
+   }
    ostringstream os;
 
    os << "JBEConsole.print(";
@@ -1769,10 +3336,12 @@ static void putConsole(const string & str, bool isStdErr) {
 
    os << "," << boolalpha << isStdErr << ")";
    putPipe(os.str());
+   endFrame();
 }
 
 static void endLineConsole() {
    putPipe("JBEConsole.println()");
+   endFrame();
 }
 
 static int scanInt(TokenScanner & scanner) {
@@ -1817,6 +3386,38 @@ static GRectangle scanRectangle(const string & str) {
    return GRectangle(x, y, width, height);
 }
 
+/*
+ * Function: forgetSizes
+ * Usage: forgetSizes(gwd);
+ * ------------------------
+ * Discards the cached canvas size of the window and the cached
+ * interactor sizes, which a change to its layout may have made stale.
+ */
+
+static void forgetSizes(GWindowData *gwd) {
+   gwd->canvasSizeKnown = false;
+   interactorSizes.clear();
+}
+
+/*
+ * Functions: parseReal, parseBoolean, parseBounds
+ * -----------------------------------------------
+ * Convert the text of a result to the value type of a PendingResult.
+ */
+
+static double parseReal(const string & result) {
+   return stringToReal(result);
+}
+
+static bool parseBoolean(const string & result) {
+   return result == "true";
+}
+
+static GRectangle parseBounds(const string & result) {
+   if (!startsWith(result, "GRectangle(")) error(std::string("getBounds: unexpected result: ") + result);
+   return scanRectangle(result);
+}
+
 /*
  * Sets up console settings like window size, location, exit-on-close, etc.
  * based on compiler options (which may be set in the .pro file).
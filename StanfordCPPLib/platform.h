@@ -30,9 +30,47 @@
 #include <string>
 #include <vector>
 #include "gevents.h"
+#include "grid.h"
 #include "gwindow.h"
 #include "sound.h"
 
+class Platform;
+Platform *getPlatform();
+
+/*
+ * Class: PendingResult<ValueType>
+ * -------------------------------
+ * Holds the reply to a query that has been sent to the back end but not
+ * yet read.  The query is issued when the PendingResult is created; get
+ * waits for the reply and converts it to a ValueType.  Issuing several
+ * queries before calling get on any of them lets the back end answer all
+ * of them in a single round trip:
+ *
+ *    PendingResult<double> width = pp->getCanvasWidthAsync(gw);
+ *    PendingResult<double> height = pp->getCanvasHeightAsync(gw);
+ *    double area = width.get() * height.get();
+ *
+ * Every PendingResult should be collected with get, since the reply is
+ * otherwise kept until the end of the program.
+ */
+
+template <typename ValueType>
+class PendingResult {
+public:
+   typedef ValueType (*ParseFn)(const std::string & result);
+
+   PendingResult(int id, ParseFn parse) {
+      this->id = id;
+      this->parse = parse;
+   }
+
+   ValueType get() const;
+
+private:
+   int id;                        /* Request id assigned by Platform  */
+   ParseFn parse;                 /* Converts the reply to a value    */
+};
+
 class Platform {
 private:
    Platform();
@@ -76,12 +114,27 @@ public:
    void pause(double milliseconds);
    double getCanvasWidth(const GWindow & gw);
    double getCanvasHeight(const GWindow & gw);
+   PendingResult<double> getCanvasWidthAsync(const GWindow & gw);
+   PendingResult<double> getCanvasHeightAsync(const GWindow & gw);
+   void fetchCanvasSize(const GWindow & gw);
    double getScreenWidth();
    double getScreenHeight();
    GEvent waitForEvent(int mask);
    GEvent getNextEvent(int mask);
    bool isBlockedForConsoleIO();
    void exitGraphics();
+   bool isHeadless();
+   Grid<int> getWindowPixels(const GWindow & gw);
+   void setProtocolStatsEnabled(bool flag);
+   bool isProtocolStatsEnabled();
+   void resetProtocolStats();
+   std::string getProtocolStats(std::string format);
+   void writeProtocolStats(std::string filename);
+   void beginBatch();
+   void endBatch();
+   void flush();
+   int sendRequest(const std::string & command);
+   std::string awaitResult(int id);
    void createTimer(const GTimer & timer, double delay);
    void deleteTimer(const GTimer & timer);
    void startTimer(const GTimer & timer);
@@ -106,12 +159,15 @@ public:
    GDimension createGImage(GObject *gobj, std::string filename);
    void createGPolygon(GObject *gobj);
    void addVertex(GObject *gobj, double x, double y);
+   void addVertices(GObject *gobj, const Vector<GPoint> & points);
    void setActionCommand(GObject *gobj, std::string cmd);
    GDimension getSize(GObject *gobj);
+   PendingResult<GDimension> getSizeAsync(GObject *gobj);
    void createGButton(GObject *gobj, std::string label);
    void gbutton_setEnabled(GObject *gobj, bool enabled);
    void createGCheckBox(GObject *gobj, std::string label);
    bool isSelected(GObject *gobj);
+   PendingResult<bool> isSelectedAsync(GObject *gobj);
    void setSelected(GObject *gobj, bool state);
    void createGSlider(GObject *gobj, int min, int max, int value);
    int getValue(GObject *gobj);
@@ -137,12 +193,22 @@ public:
    void rotate(GObject *gobj, double theta);
    GRectangle getBounds(const GObject *gobj);
    bool contains(const GObject *gobj, double x, double y);
+   PendingResult<GRectangle> getBoundsAsync(const GObject *gobj);
+   PendingResult<bool> containsAsync(const GObject *gobj, double x, double y);
    void setLineWidth(GObject *gobj, double lineWidth);
    void setLocation(GObject *gobj, double x, double y);
    void setSize(GObject *gobj, double width, double height);
    void setFrameRectangle(GObject *gobj, double x, double y,
                                          double width, double height);
    void draw(const GWindow & gw, const GObject *gobj);
+   void drawLine(const GWindow & gw, double x0, double y0,
+                                     double x1, double y1, std::string color);
+   void drawRect(const GWindow & gw, double x, double y, double width,
+                                     double height, std::string color, bool filled);
+   void drawOval(const GWindow & gw, double x, double y, double width,
+                                     double height, std::string color, bool filled);
+   void drawLines(const GWindow & gw, const Vector<GPoint> & points,
+                                      std::string color);
    void setFilled(GObject *gobj, bool flag);
    void setFillColor(GObject *gobj, std::string color);
    void setFont(GObject *gobj, std::string font);
@@ -150,14 +216,21 @@ public:
    double getFontAscent(const GObject *gobj);
    double getFontDescent(const GObject *gobj);
    GDimension getGLabelSize(const GObject *gobj);
+   std::string getFontMetrics(std::string font);
+   PendingResult<double> getFontAscentAsync(const GObject *gobj);
+   PendingResult<double> getFontDescentAsync(const GObject *gobj);
+   PendingResult<GDimension> getGLabelSizeAsync(const GObject *gobj);
    void gbufferedimage_constructor(GObject* gobj, double x, double y, double width, double height, int rgb);
    void gbufferedimage_fill(GObject* gobj, int rgb);
    void gbufferedimage_fillRegion(GObject* gobj, double x, double y, double width, double height, int rgb);
    std::string gbufferedimage_load(GObject* gobj, const std::string& filename);
    void gbufferedimage_resize(GObject* gobj, double width, double height, bool retain = true);
    void gbufferedimage_save(const GObject* const gobj, const std::string& filename);
-   std::string gbufferedimage_scale(const GObject* const gobj, GObject* const gobj2, int w, int h);
-   void gbufferedimage_setRGB(GObject* gobj, double x, double y, int rgb);
+   void gbufferedimage_markDirty(GObject* gobj);
+   void gbufferedimage_updateRegion(GObject* gobj, const Grid<int>& pixels,
+                                    int x, int y, int width, int height);
+   void gbufferedimage_updateRegions(GObject* gobj, const Grid<int>& pixels,
+                                     const Vector<GRectangle>& regions);
    int goptionpane_showConfirmDialog(std::string message, std::string title, int type, GWindow *parent);
    std::string goptionpane_showInputDialog(std::string message, std::string title, GWindow *parent);
    void goptionpane_showMessageDialog(std::string message, std::string title, int type, GWindow *parent);
@@ -174,6 +247,9 @@ public:
    void gtextarea_setBackgroundColor(GObject* gobj, std::string rgb);
 };
 
-Platform *getPlatform();
+template <typename ValueType>
+ValueType PendingResult<ValueType>::get() const {
+   return parse(getPlatform()->awaitResult(id));
+}
 
 #endif
@@ -29,7 +29,7 @@
 using namespace std;
 
 int hashCode(const Point & p) {
-    return HASH_MASK & (p.x ^ p.y);
+    return hashFold(hashCombine(hashCode(p.x), hashCode(p.y)));
 }
 
 Point::Point() {
@@ -0,0 +1,114 @@
+/*
+ * File: private/backend.h
+ * -----------------------
+ * This file defines the interface between the Platform class and the
+ * back end that carries out its commands.  The usual back end is the
+ * Java program in spl.jar, reached through a pair of pipes; the
+ * HeadlessBackEnd class defined here stands in for it inside the C++
+ * process when the environment variable JBEBACKEND is "headless".
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _backend_h
+#define _backend_h
+
+#include <cstddef>
+#include <string>
+#include "grid.h"
+#include "hashmap.h"
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Class: BackEnd
+ * --------------
+ * The abstract interface to a back end.  Platform writes the commands it
+ * has buffered with sendCommands and reads the replies with readReplies,
+ * which waits until at least one byte is available.  repliesReady tells
+ * whether readReplies would return without waiting.  Both use the text
+ * lines of the back-end protocol, or the binary frames once the back end
+ * has agreed to them.
+ */
+
+class BackEnd {
+public:
+   virtual ~BackEnd() { }
+   virtual void sendCommands(const char *data, size_t length) = 0;
+   virtual size_t readReplies(char *buffer, size_t size) = 0;
+   virtual bool repliesReady() = 0;
+   virtual void terminate() = 0;
+};
+
+struct HeadlessObject;
+struct HeadlessWindow;
+struct HeadlessTimer;
+
+/*
+ * Class: HeadlessBackEnd
+ * ----------------------
+ * A back end that runs inside the C++ process.  It interprets the text
+ * protocol, keeps the windows and graphical objects in memory, and draws
+ * them into a pixel grid on request, so that graphical programs can run
+ * without Java or a display.  The implementation is in headless.cpp.
+ */
+
+class HeadlessBackEnd : public BackEnd {
+public:
+   HeadlessBackEnd();
+   virtual ~HeadlessBackEnd();
+   virtual void sendCommands(const char *data, size_t length);
+   virtual size_t readReplies(char *buffer, size_t size);
+   virtual bool repliesReady();
+   virtual void terminate();
+
+/*
+ * Method: getPixels
+ * Usage: Grid<int> pixels = headless->getPixels(windowId);
+ * --------------------------------------------------------
+ * Draws the window with the specified id and returns its canvas as a
+ * grid of 0xrrggbb values indexed by row and column.
+ */
+
+   Grid<int> getPixels(const std::string & windowId);
+
+private:
+   std::string partialLine;
+   std::string replies;
+   size_t replyStart;
+   double now;
+   HashMap<std::string,HeadlessObject *> objects;
+   HashMap<std::string,HeadlessWindow *> windows;
+   HashMap<std::string,HeadlessTimer *> timers;
+
+   void execute(const std::string & line);
+   void reply(const std::string & line);
+   void result(const std::string & value);
+   void nextEvent(int mask, bool wait);
+   HeadlessObject *getObject(const std::string & id);
+   HeadlessObject *createObject(const std::string & id, int type);
+   void deleteObject(const std::string & id);
+};
+
+#endif
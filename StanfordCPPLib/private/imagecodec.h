@@ -0,0 +1,76 @@
+/*
+ * File: private/imagecodec.h
+ * --------------------------
+ * This file exports the image file codecs that GBufferedImage uses to
+ * read and write PNG, PPM, and BMP files in the C++ library, without
+ * asking the back end.  Images are grids of 0xrrggbb values indexed by
+ * row and column; an alpha channel in a file is ignored on reading, as
+ * it is by the Java back end.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _imagecodec_h
+#define _imagecodec_h
+
+#include <string>
+#include "grid.h"
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Function: decodeImage
+ * Usage: if (decodeImage(data, pixels)) ...
+ * -----------------------------------------
+ * Decodes the contents of an image file into pixels and returns true, or
+ * returns false without changing pixels if the data is not in one of the
+ * formats supported here, which are recognized by their first bytes.
+ * Calls error if the data is in a supported format but is damaged or uses
+ * a feature that this decoder does not handle.
+ */
+
+bool decodeImage(const std::string & data, Grid<int> & pixels);
+
+/*
+ * Function: isEncodableImageFile
+ * Usage: if (isEncodableImageFile(filename)) ...
+ * ----------------------------------------------
+ * Returns true if encodeImage can produce the format that the extension
+ * of filename calls for: .png, .ppm, .pnm, or .bmp, in either case.
+ */
+
+bool isEncodableImageFile(const std::string & filename);
+
+/*
+ * Function: encodeImage
+ * Usage: string data = encodeImage(pixels, filename);
+ * ---------------------------------------------------
+ * Returns the contents of an image file holding pixels, in the format
+ * that the extension of filename calls for.  Only the file name's
+ * extension is used; the file itself is not touched.
+ */
+
+std::string encodeImage(const Grid<int> & pixels, const std::string & filename);
+
+#endif
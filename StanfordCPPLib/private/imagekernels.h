@@ -0,0 +1,163 @@
+/*
+ * File: private/imagekernels.h
+ * ----------------------------
+ * This file exports the pixel-processing loops behind the image operations
+ * of GBufferedImage.  Most of them work on spans of n contiguous pixels,
+ * such as a row of a Grid<int>, and use SSE2 instructions when the
+ * compiler provides them, so that each step processes four pixels.  Pixels
+ * are 0xrrggbb values.  Unless noted otherwise, a destination span may be
+ * the same as a source span, but spans may not overlap in any other way.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _imagekernels_h
+#define _imagekernels_h
+
+#include "grid.h"
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Function: isRGBSpan
+ * Usage: if (isRGBSpan(pixels, n)) ...
+ * ------------------------------------
+ * Returns true if every value in the span lies between 0x000000 and
+ * 0xffffff.
+ */
+
+bool isRGBSpan(const int *pixels, int n);
+
+/*
+ * Function: fillSpan
+ * Usage: fillSpan(dst, n, rgb);
+ * -----------------------------
+ * Sets every pixel in the span to rgb.
+ */
+
+void fillSpan(int *dst, int n, int rgb);
+
+/*
+ * Function: countDiffSpan
+ * Usage: int count = countDiffSpan(a, b, n);
+ * ------------------------------------------
+ * Returns the number of positions at which the spans a and b differ.
+ */
+
+int countDiffSpan(const int *a, const int *b, int n);
+
+/*
+ * Function: diffSpan
+ * Usage: diffSpan(a, b, dst, n, same, different);
+ * -----------------------------------------------
+ * Sets each pixel of dst to same where a and b agree and to different
+ * where they do not.
+ */
+
+void diffSpan(const int *a, const int *b, int *dst, int n,
+              int same, int different);
+
+/*
+ * Function: blendSpan
+ * Usage: blendSpan(src, dst, n, alpha);
+ * -------------------------------------
+ * Mixes src into dst, giving src the weight alpha / 256 in each color
+ * component.  The alpha value must lie between 0 and 256.
+ */
+
+void blendSpan(const int *src, int *dst, int n, int alpha);
+
+/*
+ * Function: grayscaleSpan
+ * Usage: grayscaleSpan(src, dst, n);
+ * ----------------------------------
+ * Stores the gray with the luminance of each pixel of src in dst, using
+ * the weights 0.30, 0.59, and 0.11 for red, green, and blue.
+ */
+
+void grayscaleSpan(const int *src, int *dst, int n);
+
+/*
+ * Function: thresholdSpan
+ * Usage: thresholdSpan(src, dst, n, level, dark, light);
+ * ------------------------------------------------------
+ * Stores dark in dst for each pixel of src whose luminance, as computed
+ * by grayscaleSpan, is less than level, and light for the others.
+ */
+
+void thresholdSpan(const int *src, int *dst, int n, int level,
+                   int dark, int light);
+
+/*
+ * Function: boxBlurImage
+ * Usage: boxBlurImage(pixels, radius);
+ * ------------------------------------
+ * Replaces each pixel by the average of the square of side 2 * radius + 1
+ * centered on it, where the pixels at the edges of the image extend
+ * outward as far as necessary.  A radius larger than both dimensions of
+ * the image is reduced to the larger of them.
+ */
+
+void boxBlurImage(Grid<int> & pixels, int radius);
+
+/*
+ * Function: gaussianBlurImage
+ * Usage: gaussianBlurImage(pixels, sigma);
+ * ----------------------------------------
+ * Blurs the pixels with an approximation to the Gaussian function with
+ * the standard deviation sigma, treating the edges as boxBlurImage does.
+ */
+
+void gaussianBlurImage(Grid<int> & pixels, double sigma);
+
+/*
+ * Type: ResampleFilter
+ * --------------------
+ * The ways resampleImage can compute the destination pixels:
+ *
+ *  - RESAMPLE_NEAREST copies the source pixel nearest each one.
+ *  - RESAMPLE_BILINEAR interpolates between the two nearest source pixels
+ *    in each direction.
+ *  - RESAMPLE_AREA averages the source pixels that each one covers,
+ *    weighting the partly covered pixels at the edges by their coverage,
+ *    along an axis that shrinks.  Along an axis that grows or stays the
+ *    same, it behaves as RESAMPLE_BILINEAR does.
+ */
+
+enum ResampleFilter { RESAMPLE_NEAREST, RESAMPLE_BILINEAR, RESAMPLE_AREA };
+
+/*
+ * Function: resampleImage
+ * Usage: resampleImage(src, dst, width, height, filter);
+ * ------------------------------------------------------
+ * Resizes dst to the given width and height and fills it with the pixels
+ * of src scaled to that size.  The source pixels are treated as squares
+ * whose centers are sampled.  Large images are processed by several
+ * threads.  The grids src and dst must be different.
+ */
+
+void resampleImage(const Grid<int> & src, Grid<int> & dst,
+                   int width, int height, ResampleFilter filter);
+
+#endif
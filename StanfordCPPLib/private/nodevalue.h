@@ -0,0 +1,92 @@
+/*
+ * File: private/nodevalue.h
+ * -------------------------
+ * This file defines the value slot shared by the nodes of the Map
+ * binary search tree and the cells of the HashMap bucket chains.  The
+ * slot is factored into its own base class so that Set and HashSet,
+ * which need only keys, can instantiate those structures with a
+ * value type that occupies no storage at all.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _nodevalue_h
+#define _nodevalue_h
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Type: KeyOnly
+ * -------------
+ * This empty type is used as the value type of the maps that implement
+ * Set and HashSet.  All instances compare equal, which keeps the
+ * generic map operations (equals, operator==) well defined.
+ */
+
+struct KeyOnly {
+   bool operator==(const KeyOnly &) const { return true; }
+   bool operator!=(const KeyOnly &) const { return false; }
+};
+
+/*
+ * Implementation notes: NodeValue
+ * -------------------------------
+ * Map and HashMap derive their node types from NodeValue<ValueType>
+ * and touch the value only through getValue and setValue.  The general
+ * template stores the value inline.  The KeyOnly specialization is
+ * empty, so the empty-base optimization removes it from the node
+ * entirely; getValue returns a shared dummy, which is safe because
+ * KeyOnly carries no state.
+ */
+
+template <typename ValueType>
+struct NodeValue {
+   ValueType value;
+
+   ValueType & getValue() {
+      return value;
+   }
+
+   const ValueType & getValue() const {
+      return value;
+   }
+
+   void setValue(const ValueType & value) {
+      this->value = value;
+   }
+};
+
+template <>
+struct NodeValue<KeyOnly> {
+   KeyOnly & getValue() const {
+      static KeyOnly dummy;
+      return dummy;
+   }
+
+   void setValue(const KeyOnly &) {
+      /* Empty */
+   }
+};
+
+#endif
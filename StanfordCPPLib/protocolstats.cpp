@@ -0,0 +1,51 @@
+/*
+ * File: protocolstats.cpp
+ * -----------------------
+ * This file implements the protocolstats.h interface.  The statistics
+ * themselves are collected in platform.cpp.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#include <string>
+#include "platform.h"
+#include "protocolstats.h"
+using namespace std;
+
+static Platform *pp = getPlatform();
+
+void setProtocolStatsEnabled(bool flag) {
+   pp->setProtocolStatsEnabled(flag);
+}
+
+bool isProtocolStatsEnabled() {
+   return pp->isProtocolStatsEnabled();
+}
+
+void resetProtocolStats() {
+   pp->resetProtocolStats();
+}
+
+string getProtocolStats(string format) {
+   return pp->getProtocolStats(format);
+}
+
+void writeProtocolStats(string filename) {
+   pp->writeProtocolStats(filename);
+}
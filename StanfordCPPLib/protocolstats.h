@@ -0,0 +1,100 @@
+/**
+ * @file protocolstats.h
+ *
+ * @brief
+ * This file exports functions that measure the traffic between the
+ * program and the back end that carries out its graphics commands.
+ *
+ * When the statistics are enabled, the library counts the commands it
+ * sends under their names, along with the bytes they occupy, and for each
+ * command whose result it waits for, the bytes of the reply and the
+ * round-trip time.  The times are kept in a histogram whose buckets
+ * double in width, starting with the times under two microseconds.
+ * Setting the environment variable <code>JBESTATS</code> to a filename
+ * enables the statistics when the program starts and writes them to
+ * that file when it exits.  Unlike <code>JBETRACE</code>, which logs
+ * every line, the statistics are cheap enough to leave on.
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+#ifndef _protocolstats_h
+#define _protocolstats_h
+
+#include <string>
+
+/**
+ * Turns the collection of protocol statistics on or off.  Turning it off
+ * keeps the statistics collected so far.
+ *
+ * Sample usage:
+ *
+ *     setProtocolStatsEnabled(flag);
+ */
+void setProtocolStatsEnabled(bool flag);
+
+
+/**
+ * Returns <code>true</code> if protocol statistics are being collected.
+ *
+ * Sample usage:
+ *
+ *     if (isProtocolStatsEnabled()) ...
+ */
+bool isProtocolStatsEnabled();
+
+
+/**
+ * Discards the protocol statistics collected so far.
+ *
+ * Sample usage:
+ *
+ *     resetProtocolStats();
+ */
+void resetProtocolStats();
+
+
+/**
+ * Returns the protocol statistics as a string in the specified format,
+ * which is either <code>"csv"</code> or <code>"json"</code>.  The CSV
+ * form has one row for each command with the columns
+ * <code>command</code>, <code>count</code>, <code>bytesSent</code>,
+ * <code>results</code>, <code>bytesReceived</code>,
+ * <code>meanMicros</code>, and <code>maxMicros</code>, followed by one
+ * column per histogram bucket headed by the limit of the bucket.  The
+ * JSON form maps each command name to an object with the same fields.
+ *
+ * Sample usage:
+ *
+ *     string stats = getProtocolStats("json");
+ */
+std::string getProtocolStats(std::string format);
+
+
+/**
+ * Writes the protocol statistics to the specified file, in JSON if the
+ * filename ends in <code>.json</code> and in CSV otherwise.
+ *
+ * Sample usage:
+ *
+ *     writeProtocolStats(filename);
+ */
+void writeProtocolStats(std::string filename);
+
+#endif
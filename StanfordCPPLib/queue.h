@@ -28,7 +28,9 @@
 #ifndef _queue_h
 #define _queue_h
 
+#include <algorithm>
 #include <sstream>
+#include <utility>
 #include "hashcode.h"
 #include "vector.h"
 
@@ -57,6 +59,21 @@ public:
    Queue();
 
 
+/**
+ * Creates a new empty queue with room for \em capacity values.  If
+ * \em fixedCapacity is \c true, the queue never grows: it performs no
+ * allocation after construction, and adding a value to a full queue
+ * is an error.  Otherwise the queue grows as needed, and \em capacity
+ * only avoids the early reallocations.
+ *
+ * Sample usage:
+ *
+ *     Queue<ValueType> queue(capacity);
+ *     Queue<ValueType> queue(capacity, true);
+ */
+   explicit Queue(int capacity, bool fixedCapacity = false);
+
+
 /**
  * Frees any heap storage associated with this queue.
  */
@@ -118,6 +135,17 @@ public:
    bool isEmpty() const;
 
 
+/**
+ * Returns \c true if this queue has fixed capacity and contains as
+ * many values as it can hold.  A growable queue is never full.
+ *
+ * Sample usage:
+ *
+ *     if (queue.isFull()) ...
+ */
+   bool isFull() const;
+
+
 /**
  * Removes all elements from this queue.
  *
@@ -129,14 +157,30 @@ public:
 
 
 /**
- * Adds a value to the end of this queue.
+ * Adds a value to the end of this queue.  The second form moves
+ * \em value into the queue instead of copying it.
  *
  * Sample usage:
  *
  *     queue.enqueue(value);
  */
+   void enqueue(const ValueType & value);
+   void enqueue(ValueType && value);
 
-   void enqueue(ValueType value);
+
+/**
+ * Adds every value in \em values, in iteration order, to the end of
+ * this queue.  The collection may be any type that supports the
+ * range-based for statement.  The queue grows at most once, and a
+ * fixed-capacity queue that lacks room for all of the values reports
+ * an error without adding any of them.
+ *
+ * Sample usage:
+ *
+ *     queue.enqueueAll(vec);
+ */
+   template <typename CollectionType>
+   void enqueueAll(const CollectionType & values);
 
 
 /**
@@ -149,6 +193,19 @@ public:
    ValueType dequeue();
 
 
+/**
+ * Removes up to \em n values from the front of this queue and moves
+ * them, in order, into the array \em buffer, which must have room for
+ * \em n values.  Returns the number of values removed, which is less
+ * than \em n only if the queue runs out.
+ *
+ * Sample usage:
+ *
+ *     int nRead = queue.dequeueInto(buffer, n);
+ */
+   int dequeueInto(ValueType *buffer, int n);
+
+
 /**
  * Returns the first value in this queue, without removing it.  For
  * compatibility with the STL `queue` class, the Stanford-Whittier
@@ -232,15 +289,31 @@ private:
 
 /* Instance variables */
 
-   Vector<ValueType> ringBuffer;
-   int count;
-   int capacity;
-   int head;
-   int tail;
+   ValueType *ringBuffer;              /* Dynamic array of queue slots    */
+   int count;                          /* Number of values in the queue   */
+   int capacity;                       /* Allocated size of ringBuffer    */
+   int head;                           /* Index of the first value        */
+   int tail;                           /* Index of the next free slot     */
+   bool fixedCapacity;                 /* True if the queue may not grow  */
 
 /* Private functions */
 
-   void expandRingBufferCapacity();
+   void ensureCapacity(int n);
+   void expandRingBufferCapacity(int minCapacity);
+   void deepCopy(const Queue & src);
+
+public:
+
+/*
+ * Deep copying support
+ * --------------------
+ * This copy constructor and operator= are defined to make a
+ * deep copy, making it possible to pass/return queues by value
+ * and assign from one queue to another.
+ */
+
+   Queue(const Queue & src);
+   Queue & operator=(const Queue & src);
 
 };
 
@@ -275,19 +348,30 @@ const int INITIAL_CAPACITY = 10;
 
 template <typename ValueType>
 Queue<ValueType>::Queue() {
-   clear();
+   capacity = INITIAL_CAPACITY;
+   ringBuffer = new ValueType[capacity];
+   head = tail = count = 0;
+   fixedCapacity = false;
+}
+
+template <typename ValueType>
+Queue<ValueType>::Queue(int capacity, bool fixedCapacity) {
+   if (capacity <= 0) error("Queue::Queue: Capacity must be positive");
+   this->capacity = capacity;
+   ringBuffer = new ValueType[capacity];
+   head = tail = count = 0;
+   this->fixedCapacity = fixedCapacity;
 }
 
 /*
  * Implementation notes: ~Queue destructor
  * ---------------------------------------
- * All of the dynamic memory is allocated in the Vector class,
- * so no work is required at this level.
+ * The destructor frees the ring buffer array.
  */
 
 template <typename ValueType>
 Queue<ValueType>::~Queue() {
-   /* Empty */
+   delete[] ringBuffer;
 }
 
 template <typename ValueType>
@@ -305,23 +389,82 @@ bool Queue<ValueType>::isEmpty() const {
    return count == 0;
 }
 
+template <typename ValueType>
+bool Queue<ValueType>::isFull() const {
+   return fixedCapacity && count == capacity;
+}
+
+/*
+ * Implementation notes: clear
+ * ---------------------------
+ * A growable queue returns to its initial capacity.  A fixed-capacity
+ * queue keeps its array, so the old values are overwritten with
+ * default values to release any storage they own.
+ */
+
 template <typename ValueType>
 void Queue<ValueType>::clear() {
-   capacity = INITIAL_CAPACITY;
-   ringBuffer = Vector<ValueType>(capacity);
+   if (fixedCapacity) {
+      std::fill(ringBuffer, ringBuffer + capacity, ValueType());
+   } else {
+      delete[] ringBuffer;
+      capacity = INITIAL_CAPACITY;
+      ringBuffer = new ValueType[capacity];
+   }
    head = 0;
    tail = 0;
    count = 0;
 }
 
+/*
+ * Implementation notes: enqueue
+ * -----------------------------
+ * If the queue has to grow, value is copied first, because it might
+ * refer to an element of the ring buffer that is about to be freed.
+ */
+
 template <typename ValueType>
-void Queue<ValueType>::enqueue(ValueType value) {
-   if (count >= capacity - 1) expandRingBufferCapacity();
+void Queue<ValueType>::enqueue(const ValueType & value) {
+   if (count == capacity) {
+      enqueue(ValueType(value));
+      return;
+   }
    ringBuffer[tail] = value;
    tail = (tail + 1) % capacity;
    count++;
 }
 
+template <typename ValueType>
+void Queue<ValueType>::enqueue(ValueType && value) {
+   if (count == capacity) ensureCapacity(count + 1);
+   ringBuffer[tail] = std::move(value);
+   tail = (tail + 1) % capacity;
+   count++;
+}
+
+/*
+ * Implementation notes: enqueueAll
+ * --------------------------------
+ * The first pass counts the values so that the queue can grow (or
+ * reject the request) once, up front.  The second pass copies the
+ * values into the free slots.
+ */
+
+template <typename ValueType>
+template <typename CollectionType>
+void Queue<ValueType>::enqueueAll(const CollectionType & values) {
+   int n = 0;
+   for (auto it = values.begin(); it != values.end(); ++it) {
+      n++;
+   }
+   ensureCapacity(count + n);
+   for (const ValueType & value : values) {
+      ringBuffer[tail] = value;
+      tail = (tail + 1) % capacity;
+   }
+   count += n;
+}
+
 template <typename ValueType>
 bool Queue<ValueType>::equals(const Queue<ValueType>& queue2) const {
     if (this == &queue2) {
@@ -330,14 +473,13 @@ bool Queue<ValueType>::equals(const Queue<ValueType>& queue2) const {
     if (size() != queue2.size()) {
         return false;
     }
-    Queue<ValueType> copy1 = *this;
-    Queue<ValueType> copy2 = queue2;
-    while (!copy1.isEmpty() && !copy2.isEmpty()) {
-        if (!(copy1.dequeue() == copy2.dequeue())) {
+    for (int i = 0; i < count; i++) {
+        if (!(ringBuffer[(head + i) % capacity]
+              == queue2.ringBuffer[(queue2.head + i) % queue2.capacity])) {
             return false;
         }
     }
-    return copy1.isEmpty() == copy2.isEmpty();
+    return true;
 }
 
 /*
@@ -350,16 +492,36 @@ bool Queue<ValueType>::equals(const Queue<ValueType>& queue2) const {
 template <typename ValueType>
 ValueType Queue<ValueType>::dequeue() {
    if (count == 0) error("Queue::dequeue: Attempting to dequeue an empty queue");
-   ValueType result = ringBuffer[head];
+   ValueType result = std::move(ringBuffer[head]);
    head = (head + 1) % capacity;
    count--;
    return result;
 }
 
+/*
+ * Implementation notes: dequeueInto
+ * ---------------------------------
+ * The values to remove occupy at most two contiguous runs of the ring
+ * buffer, one from head toward the end of the array and one from the
+ * start of the array, so each run is moved with a single std::move.
+ */
+
+template <typename ValueType>
+int Queue<ValueType>::dequeueInto(ValueType *buffer, int n) {
+   if (n < 0) error("Queue::dequeueInto: Count must not be negative");
+   if (n > count) n = count;
+   int firstRun = std::min(n, capacity - head);
+   std::move(ringBuffer + head, ringBuffer + head + firstRun, buffer);
+   std::move(ringBuffer, ringBuffer + (n - firstRun), buffer + firstRun);
+   head = (head + n) % capacity;
+   count -= n;
+   return n;
+}
+
 template <typename ValueType>
 ValueType Queue<ValueType>::peek() const {
    if (count == 0) error("Queue::peek: Attempting to peek at an empty queue");
-   return ringBuffer.get(head);
+   return ringBuffer[head];
 }
 
 template <typename ValueType>
@@ -384,24 +546,76 @@ ValueType & Queue<ValueType>::back() {
    return ringBuffer[(tail + capacity - 1) % capacity];
 }
 
+/*
+ * Implementation notes: ensureCapacity
+ * ------------------------------------
+ * This private method makes room for n values, reporting an error if
+ * the queue has fixed capacity and n values will not fit.
+ */
+
+template <typename ValueType>
+void Queue<ValueType>::ensureCapacity(int n) {
+   if (n <= capacity) return;
+   if (fixedCapacity) {
+      error("Queue::enqueue: Attempting to enqueue onto a full fixed-capacity queue");
+   }
+   expandRingBufferCapacity(n);
+}
+
 /*
  * Implementation notes: expandRingBufferCapacity
  * ----------------------------------------------
- * This private method doubles the capacity of the ringBuffer vector.
- * Note that this implementation also shifts all the elements back to
- * the beginning of the vector.
+ * This private method at least doubles the capacity of the ring
+ * buffer.  The values occupy at most two contiguous runs of the old
+ * array, which are moved (not copied) to the beginning of the new one.
  */
 
 template <typename ValueType>
-void Queue<ValueType>::expandRingBufferCapacity() {
-   Vector<ValueType> copy = ringBuffer;
-   ringBuffer = Vector<ValueType>(2 * capacity);
-   for (int i = 0; i < count; i++) {
-      ringBuffer[i] = copy[(head + i) % capacity];
-   }
+void Queue<ValueType>::expandRingBufferCapacity(int minCapacity) {
+   int newCapacity = std::max(2 * capacity, minCapacity);
+   ValueType *newBuffer = new ValueType[newCapacity];
+   int firstRun = std::min(count, capacity - head);
+   std::move(ringBuffer + head, ringBuffer + head + firstRun, newBuffer);
+   std::move(ringBuffer, ringBuffer + (count - firstRun), newBuffer + firstRun);
+   delete[] ringBuffer;
+   ringBuffer = newBuffer;
+   capacity = newCapacity;
    head = 0;
    tail = count;
-   capacity *= 2;
+}
+
+/*
+ * Implementation notes: copy constructor and assignment operator
+ * --------------------------------------------------------------
+ * The copy gets an array of the same capacity with the values moved
+ * to the front, which keeps a fixed-capacity queue fixed.
+ */
+
+template <typename ValueType>
+void Queue<ValueType>::deepCopy(const Queue & src) {
+   capacity = src.capacity;
+   fixedCapacity = src.fixedCapacity;
+   ringBuffer = new ValueType[capacity];
+   for (int i = 0; i < src.count; i++) {
+      ringBuffer[i] = src.ringBuffer[(src.head + i) % src.capacity];
+   }
+   count = src.count;
+   head = 0;
+   tail = count % capacity;
+}
+
+template <typename ValueType>
+Queue<ValueType>::Queue(const Queue & src) {
+   deepCopy(src);
+}
+
+template <typename ValueType>
+Queue<ValueType> & Queue<ValueType>::operator=(const Queue & src) {
+   if (this != &src) {
+      delete[] ringBuffer;
+      deepCopy(src);
+   }
+   return *this;
 }
 
 template <typename ValueType>
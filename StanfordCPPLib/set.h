@@ -342,7 +342,7 @@ public:
 
 private:
 
-   Map<ValueType,bool> map;            /* Map used to store the element     */
+   Map<ValueType,KeyOnly> map;         /* Key-only map storing the elements */
    bool removeFlag;                    /* Flag to differentiate += and -=   */
 
 public:
@@ -359,7 +359,7 @@ public:
 /* Extended constructors */
 
    template <typename CompareType>
-   explicit Set(CompareType cmp) : map(Map<ValueType,bool>(cmp)) {
+   explicit Set(CompareType cmp) : map(Map<ValueType,KeyOnly>(cmp)) {
       /* Empty */
    }
 
@@ -384,7 +384,7 @@ public:
 
    private:
 
-      typename Map<ValueType,bool>::iterator mapit;  /* Iterator for the map */
+      typename Map<ValueType,KeyOnly>::iterator mapit;  /* Iterator for the map */
 
    public:
 
@@ -392,7 +392,7 @@ public:
               /* Empty */
       }
 
-      iterator(typename Map<ValueType,bool>::iterator it) : mapit(it) {
+      iterator(typename Map<ValueType,KeyOnly>::iterator it) : mapit(it) {
          /* Empty */
       }
 
@@ -484,12 +484,12 @@ bool Set<ValueType>::isEmpty() const {
 
 template <typename ValueType>
 void Set<ValueType>::add(const ValueType & value) {
-   map.put(value, true);
+   map.put(value, KeyOnly());
 }
 
 template <typename ValueType>
 void Set<ValueType>::insert(const ValueType & value) {
-   map.put(value, true);
+   map.put(value, KeyOnly());
 }
 
 template <typename ValueType>
@@ -638,18 +638,24 @@ std::string Set<ValueType>::toString() {
 
 template <typename ValueType>
 void Set<ValueType>::mapAll(void (*fn)(ValueType)) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 template <typename ValueType>
 void Set<ValueType>::mapAll(void (*fn)(const ValueType &)) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 template <typename ValueType>
 template <typename FunctorType>
 void Set<ValueType>::mapAll(FunctorType fn) const {
-   map.mapAll(fn);
+   for (ValueType value : *this) {
+      fn(value);
+   }
 }
 
 /**
@@ -27,7 +27,9 @@
 #ifndef _stack_h
 #define _stack_h
 
+#include <algorithm>
 #include <sstream>
+#include <utility>
 #include "hashcode.h"
 #include "vector.h"
 
@@ -41,9 +43,15 @@
  * that is the defining feature of stacks.  The fundamental stack
  * operations are \ref push (add to top) and \ref pop
  * (remove from top).
+ *
+ * The optional second template argument reserves room for that many
+ * values inside the stack object itself, so that a stack that never
+ * grows beyond it never allocates heap storage:
+ *
+ *     Stack<ValueType,16> stack;
  */
 
-template <typename ValueType>
+template <typename ValueType, int InlineCapacity = 0>
 class Stack {
 
 public:
@@ -114,21 +122,24 @@ public:
  * Sample usage:
  *     if (stack.equals(stack2)) ...
  */
-      bool equals(const Stack<ValueType>& s) const;
+   bool equals(const Stack& s) const;
 
 
 /**
- * Pushes the specified value onto this stack.
+ * Pushes the specified value onto this stack.  The second form moves
+ * \em value onto the stack instead of copying it.
  *
  * Sample usage:
  *
  *     stack.push(value);
  */
-   void push(ValueType value);
+   void push(const ValueType & value);
+   void push(ValueType && value);
 
 
 /**
- * Removes the top element from this stack and returns it.  This
+ * Removes the top element from this stack and returns it.  The
+ * element is moved out of the stack rather than copied.  This
  * method signals an error if this stack is empty.
  *
  * Sample usage:
@@ -206,17 +217,64 @@ public:
 /*
  * Implementation notes: Stack data structure
  * ------------------------------------------
- * The easiest way to implement a stack is to store the elements in a
- * Vector.  Doing so means that the problems of dynamic memory allocation
- * and copy assignment are already solved by the implementation of the
- * underlying Vector class.
+ * The elements are stored in a dynamic array, as in the Vector class.
+ * The array starts out as the inline buffer, which holds the first
+ * InlineCapacity elements inside the object.  Only when the stack
+ * outgrows that buffer does it move to a heap array, which then
+ * doubles in size each time it fills.  With the default inline
+ * capacity of zero the stack behaves like a Vector.
  */
 
-   template <typename T>
-   friend int hashCode(const Stack<T>& s);
+   template <typename T, int N>
+   friend int hashCode(const Stack<T,N>& s);
 
 private:
-   Vector<ValueType> elements;
+
+/*
+ * Type: InlineBuffer
+ * ------------------
+ * Holds the inline elements.  The specialization for a capacity of
+ * zero is empty, since C++ does not allow zero-length arrays.
+ */
+
+   template <int N, typename Dummy = void>
+   struct InlineBuffer {
+      ValueType elements[N];
+      ValueType *data() { return elements; }
+      const ValueType *data() const { return elements; }
+   };
+
+   template <typename Dummy>
+   struct InlineBuffer<0, Dummy> {
+      ValueType *data() { return NULL; }
+      const ValueType *data() const { return NULL; }
+   };
+
+/* Instance variables */
+
+   ValueType *elements;                /* Inline buffer or heap array     */
+   int count;                          /* Number of elements in the stack */
+   int capacity;                       /* Allocated size of elements      */
+   InlineBuffer<InlineCapacity> inlineBuffer;
+
+/* Private methods */
+
+   bool isInline() const;
+   void expandCapacity();
+   void deepCopy(const Stack & src);
+
+public:
+
+/*
+ * Deep copying support
+ * --------------------
+ * This copy constructor and operator= are defined to make a
+ * deep copy, making it possible to pass/return stacks by value
+ * and assign from one stack to another.
+ */
+
+   Stack(const Stack & src);
+   Stack & operator=(const Stack & src);
 
 };
 
@@ -225,68 +283,99 @@ extern void error(std::string msg);
 /*
  * Stack class implementation
  * --------------------------
- * The Stack is internally managed using a Vector.  This layered design
- * makes the implementation extremely simple, to the point that most
- * methods can be implemented in as single line.
+ * The Stack manages its own array so that the first elements can live
+ * in the inline buffer.  The growth strategy is the same as Vector's.
  */
 
-template <typename ValueType>
-Stack<ValueType>::Stack() {
-   /* Empty */
+template <typename ValueType, int InlineCapacity>
+Stack<ValueType,InlineCapacity>::Stack() {
+   elements = inlineBuffer.data();
+   count = 0;
+   capacity = InlineCapacity;
+}
+
+template <typename ValueType, int InlineCapacity>
+Stack<ValueType,InlineCapacity>::~Stack() {
+   if (!isInline()) delete[] elements;
 }
 
-template <typename ValueType>
-Stack<ValueType>::~Stack() {
-   /* Empty */
+template <typename ValueType, int InlineCapacity>
+int Stack<ValueType,InlineCapacity>::size() const {
+   return count;
 }
 
-template <typename ValueType>
-int Stack<ValueType>::size() const {
-   return elements.size();
+template <typename ValueType, int InlineCapacity>
+bool Stack<ValueType,InlineCapacity>::isEmpty() const {
+   return count == 0;
 }
 
-template <typename ValueType>
-bool Stack<ValueType>::isEmpty() const {
-   return size() == 0;
+/*
+ * Implementation notes: push
+ * --------------------------
+ * If the stack has to grow, value is copied first, because it might
+ * refer to an element of the array that is about to be freed.
+ */
+
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::push(const ValueType & value) {
+   if (count == capacity) {
+      push(ValueType(value));
+      return;
+   }
+   elements[count++] = value;
 }
 
-template <typename ValueType>
-void Stack<ValueType>::push(ValueType value) {
-   elements.add(value);
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::push(ValueType && value) {
+   if (count == capacity) expandCapacity();
+   elements[count++] = std::move(value);
 }
 
-template <typename ValueType>
-ValueType Stack<ValueType>::pop() {
+template <typename ValueType, int InlineCapacity>
+ValueType Stack<ValueType,InlineCapacity>::pop() {
    if (isEmpty()) error("Stack::pop: Attempting to pop an empty stack");
-   ValueType top = elements[elements.size() - 1];
-   elements.remove(elements.size() - 1);
-   return top;
+   return std::move(elements[--count]);
 }
 
-template <typename ValueType>
-ValueType Stack<ValueType>::peek() const {
+template <typename ValueType, int InlineCapacity>
+ValueType Stack<ValueType,InlineCapacity>::peek() const {
    if (isEmpty()) error("Stack::peek: Attempting to peek at an empty stack");
-   return elements.get(elements.size() - 1);
+   return elements[count - 1];
 }
 
-template <typename ValueType>
-ValueType & Stack<ValueType>::top() {
+template <typename ValueType, int InlineCapacity>
+ValueType & Stack<ValueType,InlineCapacity>::top() {
    if (isEmpty()) error("Stack::top: Attempting to read top of an empty stack");
-   return elements[elements.size() - 1];
+   return elements[count - 1];
 }
 
-template <typename ValueType>
-void Stack<ValueType>::add(const ValueType& value) {
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::add(const ValueType& value) {
     push(value);
 }
 
-template <typename ValueType>
-void Stack<ValueType>::clear() {
-   elements.clear();
+/*
+ * Implementation notes: clear
+ * ---------------------------
+ * Clearing a stack frees any heap array and returns the stack to its
+ * inline buffer.  The inline elements are reset to default values so
+ * that they release any storage they own.
+ */
+
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::clear() {
+   if (isInline()) {
+      std::fill(elements, elements + count, ValueType());
+   } else {
+      delete[] elements;
+      elements = inlineBuffer.data();
+      capacity = InlineCapacity;
+   }
+   count = 0;
 }
 
-template <typename ValueType>
-bool Stack<ValueType>::equals(const Stack<ValueType>& stack2) const {
+template <typename ValueType, int InlineCapacity>
+bool Stack<ValueType,InlineCapacity>::equals(const Stack& stack2) const {
     if (this == &stack2) {
         return true;
     }
@@ -301,21 +390,83 @@ bool Stack<ValueType>::equals(const Stack<ValueType>& stack2) const {
     return true;
 }
 
-template <typename ValueType>
-std::string Stack<ValueType>::toString() {
+template <typename ValueType, int InlineCapacity>
+std::string Stack<ValueType,InlineCapacity>::toString() {
    std::ostringstream os;
    os << *this;
    return os.str();
 }
 
-template <typename ValueType>
-bool Stack<ValueType>::operator ==(const Stack& stack2) const {
-    return elements == stack2.elements;
+template <typename ValueType, int InlineCapacity>
+bool Stack<ValueType,InlineCapacity>::operator ==(const Stack& stack2) const {
+    return equals(stack2);
+}
+
+template <typename ValueType, int InlineCapacity>
+bool Stack<ValueType,InlineCapacity>::operator !=(const Stack & stack2) const {
+    return !equals(stack2);
+}
+
+template <typename ValueType, int InlineCapacity>
+bool Stack<ValueType,InlineCapacity>::isInline() const {
+   return elements == inlineBuffer.data();
+}
+
+/*
+ * Implementation notes: expandCapacity
+ * ------------------------------------
+ * This function doubles the array capacity, moves the old elements
+ * into the new heap array, and then frees the old one if it was not
+ * the inline buffer.
+ */
+
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::expandCapacity() {
+   int newCapacity = std::max(1, capacity * 2);
+   ValueType *array = new ValueType[newCapacity];
+   std::move(elements, elements + count, array);
+   if (isInline()) {
+      std::fill(elements, elements + count, ValueType());
+   } else {
+      delete[] elements;
+   }
+   elements = array;
+   capacity = newCapacity;
+}
+
+/*
+ * Implementation notes: copy constructor and assignment operator
+ * --------------------------------------------------------------
+ * A copy uses its own inline buffer if the elements fit there and a
+ * heap array of exactly the right size otherwise.
+ */
+
+template <typename ValueType, int InlineCapacity>
+void Stack<ValueType,InlineCapacity>::deepCopy(const Stack & src) {
+   if (src.count <= InlineCapacity) {
+      elements = inlineBuffer.data();
+      capacity = InlineCapacity;
+   } else {
+      elements = new ValueType[src.count];
+      capacity = src.count;
+   }
+   std::copy(src.elements, src.elements + src.count, elements);
+   count = src.count;
+}
+
+template <typename ValueType, int InlineCapacity>
+Stack<ValueType,InlineCapacity>::Stack(const Stack & src) {
+   deepCopy(src);
 }
 
-template <typename ValueType>
-bool Stack<ValueType>::operator !=(const Stack & stack2) const {
-    return elements != stack2.elements;
+template <typename ValueType, int InlineCapacity>
+Stack<ValueType,InlineCapacity> &
+Stack<ValueType,InlineCapacity>::operator=(const Stack & src) {
+   if (this != &src) {
+      clear();
+      deepCopy(src);
+   }
+   return *this;
 }
 
 /**
@@ -326,11 +477,12 @@ bool Stack<ValueType>::operator !=(const Stack & stack2) const {
  *
  *     cout << stack;
  */
-template <typename ValueType>
-std::ostream & operator<<(std::ostream & os, const Stack<ValueType> & stack) {
+template <typename ValueType, int InlineCapacity>
+std::ostream & operator<<(std::ostream & os,
+                          const Stack<ValueType,InlineCapacity> & stack) {
    os << "{";
-   Stack<ValueType> copy = stack;
-   Stack<ValueType> reversed;
+   Stack<ValueType,InlineCapacity> copy = stack;
+   Stack<ValueType,InlineCapacity> reversed;
    while (!copy.isEmpty()) {
       reversed.push(copy.pop());
    }
@@ -342,8 +494,9 @@ std::ostream & operator<<(std::ostream & os, const Stack<ValueType> & stack) {
    return os << "}";
 }
 
-template <typename ValueType>
-std::istream & operator>>(std::istream & is, Stack<ValueType> & stack) {
+template <typename ValueType, int InlineCapacity>
+std::istream & operator>>(std::istream & is,
+                          Stack<ValueType,InlineCapacity> & stack) {
    char ch;
    is >> ch;
    if (ch != '{') error("Stack::operator >>: Missing {");
@@ -369,9 +522,13 @@ std::istream & operator>>(std::istream & is, Stack<ValueType> & stack) {
  * Template hash function for stacks.
  * Requires the element type in the Stack to have a hashCode function.
  */
-template <typename T>
-int hashCode(const Stack<T>& s) {
-    return hashCode(s.elements);
+template <typename T, int N>
+int hashCode(const Stack<T,N>& s) {
+    int code = HASH_SEED;
+    for (int i = 0; i < s.count; i++) {
+        code = HASH_MULTIPLIER * code + hashCode(s.elements[i]);
+    }
+    return (code & HASH_MASK);
 }
 
 #endif
@@ -0,0 +1,193 @@
+/*
+ * FrameScanner.java
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+package edu.stanford.cs.java.spl;
+
+import edu.stanford.cs.java.tokenscanner.TokenScanner;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.Charset;
+
+/**
+ * Presents the arguments of a binary command frame to the JBECommand
+ * classes.  A frame from the C++ side consists of a four-byte length, a
+ * two-byte opcode, and a sequence of tagged arguments in network byte
+ * order.  Opcode 0 carries a text command line; the other opcodes name
+ * the commands in OPCODE_NAMES.  The commands read their arguments with
+ * the nextInt, nextDouble, nextString, nextBytes, and nextBoolean methods
+ * of JBECommand, which take them from this scanner when it is active, and
+ * the punctuation tokens they verify are simply absent.
+ */
+
+public class FrameScanner extends TokenScanner {
+
+	/** Opcode of a frame that carries one line of the text protocol. */
+	public static final int TEXT = 0;
+
+	/**
+	 * Command names indexed by opcode.  This table must match the Opcode
+	 * enumeration in platform.cpp.
+	 */
+	public static final String[] OPCODE_NAMES = {
+		null,
+		"GObject.setLocation",
+		"GObject.setSize",
+		"GObject.setColor",
+		"GObject.setFillColor",
+		"GObject.setFilled",
+		"GObject.setVisible",
+		"GObject.setLineWidth",
+		"GObject.remove",
+		"GObject.delete",
+		"GObject.rotate",
+		"GObject.scale",
+		"GObject.sendToFront",
+		"GObject.sendToBack",
+		"GObject.sendForward",
+		"GObject.sendBackward",
+		"GCompound.create",
+		"GCompound.add",
+		"GRect.create",
+		"GOval.create",
+		"GLine.create",
+		"GLine.setStartPoint",
+		"GLine.setEndPoint",
+		"GLabel.create",
+		"GLabel.setLabel",
+		"GLabel.setFont",
+		"GPolygon.create",
+		"GPolygon.addVertex",
+		"GWindow.repaint",
+		"GWindow.draw",
+		"GTextArea.setText",
+		"JBEConsole.print",
+		"GObject.setState",
+		"GWindow.drawLine",
+		"GWindow.drawRect",
+		"GWindow.drawOval",
+		"GWindow.drawLines",
+		"GBufferedImage.updateRegion",
+		"GBufferedImage.updateRegions",
+		"GPolygon.addVertices",
+	};
+
+	/* Argument tags */
+	private static final byte HANDLE = 'h';
+	private static final byte DOUBLE = 'd';
+	private static final byte INT = 'i';
+	private static final byte BOOLEAN = 'b';
+	private static final byte STRING = 's';
+	private static final byte SHARED_STRING = 'S';
+
+	private static final Charset UTF8 = Charset.forName("UTF-8");
+
+	public FrameScanner(JavaBackEnd jbe) {
+		this.jbe = jbe;
+	}
+
+	/**
+	 * Sets the scanner to read the arguments in the first
+	 * <code>length</code> bytes of <code>body</code>.
+	 */
+	public void setFrame(byte[] body, int length) {
+		this.body = body;
+		buffer = ByteBuffer.wrap(body, 0, length);
+	}
+
+	/**
+	 * The text form of the protocol separates the arguments with
+	 * punctuation, which a frame does not contain.
+	 */
+	@Override
+	public void verifyToken(String expected) {
+		/* Empty */
+	}
+
+	public int nextIntArg() {
+		byte tag = buffer.get();
+		if (tag == INT) return buffer.getInt();
+		if (tag == DOUBLE) return (int) buffer.getDouble();
+		throw new RuntimeException("FrameScanner: Expected an integer");
+	}
+
+	public double nextDoubleArg() {
+		byte tag = buffer.get();
+		if (tag == DOUBLE) return buffer.getDouble();
+		if (tag == INT) return buffer.getInt();
+		throw new RuntimeException("FrameScanner: Expected a double");
+	}
+
+	public boolean nextBooleanArg() {
+		if (buffer.get() != BOOLEAN) {
+			throw new RuntimeException("FrameScanner: Expected a boolean");
+		}
+		return buffer.get() != 0;
+	}
+
+	/**
+	 * Returns a string argument.  An object handle is returned in the
+	 * canonical form produced by <code>JavaBackEnd.canonicalId</code>,
+	 * so that it names the same object as the pointer string that the
+	 * text protocol sends.  A shared string is read from the outbound
+	 * ring of the shared-memory region.
+	 */
+	public String nextStringArg() {
+		byte tag = buffer.get();
+		if (tag == HANDLE) return Long.toHexString(buffer.getLong());
+		if (tag == STRING) {
+			int length = buffer.getInt();
+			String str = new String(body, buffer.position(), length, UTF8);
+			buffer.position(buffer.position() + length);
+			return str;
+		}
+		if (tag == SHARED_STRING) {
+			long pos = buffer.getLong();
+			int length = buffer.getInt();
+			return jbe.getSharedMemory().readString(pos, length);
+		}
+		throw new RuntimeException("FrameScanner: Expected a string");
+	}
+
+	/**
+	 * Returns the bytes of a string argument without decoding them, for
+	 * the commands that send binary data.
+	 */
+	public byte[] nextBytesArg() {
+		byte tag = buffer.get();
+		if (tag == STRING) {
+			int length = buffer.getInt();
+			byte[] bytes = new byte[length];
+			buffer.get(bytes);
+			return bytes;
+		}
+		if (tag == SHARED_STRING) {
+			long pos = buffer.getLong();
+			int length = buffer.getInt();
+			return jbe.getSharedMemory().readBytes(pos, length);
+		}
+		throw new RuntimeException("FrameScanner: Expected a string");
+	}
+
+	private JavaBackEnd jbe;
+	private byte[] body;
+	private ByteBuffer buffer;
+}
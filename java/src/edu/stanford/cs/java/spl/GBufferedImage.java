@@ -73,7 +73,7 @@ public class GBufferedImage extends GInteractor {
 		return imageWidth;
 	}
 	
-	public String load(String filename) {
+	public byte[] load(String filename) {
 		try {
 			bufferedImage = ImageIO.read(new File(filename));
 			if (bufferedImage == null)
@@ -81,7 +81,7 @@ public class GBufferedImage extends GInteractor {
 			imageWidth = bufferedImage.getWidth();
 			imageHeight = bufferedImage.getHeight();
 			repaintImage();
-		    return toStringBase64(); // this is a LONG string
+		    return toBytes(); // this is a LONG string
 		} catch (Exception e) {
 			throw (new RuntimeException(e.getMessage()));
 		}
@@ -109,21 +109,67 @@ public class GBufferedImage extends GInteractor {
 		repaintImage();
 	}
 	
-	public String toStringBase64() {
-		StringBuilder sb = new StringBuilder(1024 * 256);
-		sb.append((int) imageWidth);
-		sb.append('\n');
-		sb.append((int) imageHeight);
-		sb.append('\n');
-		for (int y = 0; y < imageHeight; y++) {
-			for (int x = 0; x < imageWidth; x++) {
-				// trim off top two hex digits (alpha) because C++ lib expects 24-bit ints
-				int px = bufferedImage.getRGB(x, y);
-				sb.append(String.format("#%06x\n", px & 0x00ffffff));
+	/**
+	 * Replaces the pixels in the given region with the packed colors in
+	 * <code>data</code>, which holds three bytes (red, green, blue) for
+	 * each pixel, row by row.
+	 */
+	public void updateRegion(int x, int y, int width, int height, byte[] data) {
+		int[] rgb = new int[width * height];
+		for (int i = 0; i < rgb.length; i++) {
+			rgb[i] = ((data[3 * i] & 0xff) << 16) | ((data[3 * i + 1] & 0xff) << 8)
+					| (data[3 * i + 2] & 0xff);
+		}
+		bufferedImage.setRGB(x, y, width, height, rgb, 0, width);
+		repaintImage();
+	}
+	
+	/**
+	 * Replaces the pixels in several regions at once and repaints the image
+	 * a single time.  Each region takes four entries of <code>rects</code>
+	 * (x, y, width, height), and <code>data</code> holds the pixels of the
+	 * regions in order, packed as they are for <code>updateRegion</code>.
+	 */
+	public void updateRegions(int[] rects, byte[] data) {
+		int offset = 0;
+		for (int k = 0; k + 3 < rects.length; k += 4) {
+			int width = rects[k + 2];
+			int height = rects[k + 3];
+			int[] rgb = new int[width * height];
+			for (int i = 0; i < rgb.length; i++) {
+				int j = offset + 3 * i;
+				rgb[i] = ((data[j] & 0xff) << 16) | ((data[j + 1] & 0xff) << 8)
+						| (data[j + 2] & 0xff);
 			}
+			bufferedImage.setRGB(rects[k], rects[k + 1], width, height, rgb, 0, width);
+			offset += 3 * rgb.length;
+		}
+		repaintImage();
+	}
+	
+	/**
+	 * Returns the image in the form the C++ library reads: the width and
+	 * height as four-byte big-endian integers, followed by three bytes
+	 * (red, green, blue) for each pixel, row by row.
+	 */
+	public byte[] toBytes() {
+		int[] rgb = bufferedImage.getRGB(0, 0, imageWidth, imageHeight, null, 0, imageWidth);
+		byte[] data = new byte[8 + 3 * rgb.length];
+		data[0] = (byte) (imageWidth >> 24);
+		data[1] = (byte) (imageWidth >> 16);
+		data[2] = (byte) (imageWidth >> 8);
+		data[3] = (byte) imageWidth;
+		data[4] = (byte) (imageHeight >> 24);
+		data[5] = (byte) (imageHeight >> 16);
+		data[6] = (byte) (imageHeight >> 8);
+		data[7] = (byte) imageHeight;
+		int i = 8;
+		for (int px : rgb) {
+			data[i++] = (byte) (px >> 16);
+			data[i++] = (byte) (px >> 8);
+			data[i++] = (byte) px;
 		}
-		String base64 = Base64.encodeBytes(sb.toString().getBytes());
-		return base64;
+		return data;
 	}
 	
 	// JL modified this method so that calls to thread-unsafe Swing methods
@@ -137,94 +183,4 @@ public class GBufferedImage extends GInteractor {
 	    		label.setSize(size);	        }
 	    });		
 	}
-	
-	/**
-     * Creates a scaled instance of this {@code GBufferedImage}'s 
-     * image and stores it as targetImage's image. Returns Base64-encoded 
-     * string representation of targetImage.
-     *
-     * Adapted by Jeff Lutgen from 
-     * https://today.java.net/pub/a/today/2007/04/03/perils-of-image-getscaledinstance.html
-     *
-     * @param targetWidth the desired width of the scaled instance,
-     *    in pixels
-     * @param targetWidth the desired width of the scaled instance,
-     *    in pixels
-     * @param targetHeight the desired height of the scaled instance,
-     *    in pixels
-     * 
-     * hint: one of the rendering hints that corresponds to
-     *    {@code RenderingHints.KEY_INTERPOLATION} (e.g.
-     *    {@code RenderingHints.VALUE_INTERPOLATION_NEAREST_NEIGHBOR},
-     *    {@code RenderingHints.VALUE_INTERPOLATION_BILINEAR},
-     *    {@code RenderingHints.VALUE_INTERPOLATION_BICUBIC})
-     *    
-     * higherQuality: if true, this method will use a multi-step
-     *    scaling technique that provides higher quality than the usual
-     *    one-step technique (only useful in downscaling cases, where
-     *    {@code targetWidth} or {@code targetHeight} is
-     *    smaller than the original dimensions, and generally only when
-     *    the {@code BILINEAR} hint is specified)
-     *    
-     * @return a scaled version of the original {@code BufferedImage}
-     */
-    public String scale(GBufferedImage targetImage,
-    									   int targetWidth,
-                                           int targetHeight)
-    {
-    	boolean higherQuality;
-    	Object hint;
-    	if (targetWidth < imageWidth || targetHeight < imageHeight) {
-    		higherQuality = true;
-    		hint = RenderingHints.VALUE_INTERPOLATION_BILINEAR;
-    	} else {
-    		higherQuality = false;
-    		hint = RenderingHints.VALUE_INTERPOLATION_BICUBIC;
-    	}
-        int type = BufferedImage.TYPE_INT_RGB;
-        BufferedImage ret = (BufferedImage) bufferedImage;
-        int w, h;
-        if (higherQuality) {
-            // Use multi-step technique: start with original size, then
-            // scale down in multiple passes with drawImage()
-            // until the target size is reached
-            w = bufferedImage.getWidth();
-            h = bufferedImage.getHeight();
-        } else {
-            // Use one-step technique: scale directly from original
-            // size to target size with a single drawImage() call
-            w = targetWidth;
-            h = targetHeight;
-        }
-        
-        do {
-            if (higherQuality && w > targetWidth) {
-                w /= 2;
-                if (w < targetWidth) {
-                    w = targetWidth;
-                }
-            }
-
-            if (higherQuality && h > targetHeight) {
-                h /= 2;
-                if (h < targetHeight) {
-                    h = targetHeight;
-                }
-            }
-
-            BufferedImage tmp = new BufferedImage(w, h, type);
-            Graphics2D g2 = tmp.createGraphics();
-            g2.setRenderingHint(RenderingHints.KEY_INTERPOLATION, hint);
-            g2.drawImage(ret, 0, 0, w, h, null);
-            g2.dispose();
-
-            ret = tmp;
-        } while (w != targetWidth || h != targetHeight);
-        
-        targetImage.bufferedImage = ret;
-        targetImage.imageWidth = ret.getWidth();
-        targetImage.imageHeight = ret.getHeight();
-        targetImage.repaintImage();
-        return targetImage.toStringBase64();
-    }
 }
@@ -127,13 +127,13 @@ public class GTextArea extends GInteractor {
 	}
 
 	/**
-	 * Returns the text displayed by this object, encoded in Base64.
+	 * Returns the text displayed by this object.
 	 *
 	 * @return The text displayed by this object
 	 */
 
 	public String getText() {
-		return Base64.encodeBytes(textArea.getText().getBytes());
+		return textArea.getText();
 	}
 
 	/**
@@ -42,8 +42,14 @@ import edu.stanford.cs.java.tokenscanner.TokenScanner;
 import java.awt.Color;
 import java.awt.Component;
 import java.awt.Dimension;
+import java.awt.FontMetrics;
 import java.awt.Graphics2D;
+import java.awt.Shape;
 import java.awt.Toolkit;
+import java.awt.geom.Ellipse2D;
+import java.awt.geom.Line2D;
+import java.awt.geom.Path2D;
+import java.awt.geom.Rectangle2D;
 import java.lang.reflect.Method;
 import java.util.ArrayList;
 import java.util.HashMap;
@@ -76,8 +82,9 @@ public abstract class JBECommand {
 		cmdTable.put("GBufferedImage.load", new GBufferedImage_load());
 		cmdTable.put("GBufferedImage.resize", new GBufferedImage_resize());
 		cmdTable.put("GBufferedImage.save", new GBufferedImage_save());
-		cmdTable.put("GBufferedImage.scale", new GBufferedImage_scale());
 		cmdTable.put("GBufferedImage.setRGB", new GBufferedImage_setRGB());
+		cmdTable.put("GBufferedImage.updateRegion", new GBufferedImage_updateRegion());
+		cmdTable.put("GBufferedImage.updateRegions", new GBufferedImage_updateRegions());
 		cmdTable.put("GButton.create", new GButton_create());
 		cmdTable.put("GButton.setEnabled", new GButton_setEnabled());
 		cmdTable.put("GCheckBox.create", new GCheckBox_create());
@@ -94,6 +101,7 @@ public abstract class JBECommand {
 		cmdTable.put("GLabel.create", new GLabel_create());
 		cmdTable.put("GLabel.getFontAscent", new GLabel_getFontAscent());
 		cmdTable.put("GLabel.getFontDescent", new GLabel_getFontDescent());
+		cmdTable.put("GLabel.getFontMetrics", new GLabel_getFontMetrics());
 		cmdTable.put("GLabel.getGLabelSize", new GLabel_getGLabelSize());
 		cmdTable.put("GLabel.setFont", new GLabel_setFont());
 		cmdTable.put("GLabel.setLabel", new GLabel_setLabel());
@@ -116,6 +124,7 @@ public abstract class JBECommand {
 		cmdTable.put("GObject.setLineWidth", new GObject_setLineWidth());
 		cmdTable.put("GObject.setLocation", new GObject_setLocation());
 		cmdTable.put("GObject.setSize", new GObject_setSize());
+		cmdTable.put("GObject.setState", new GObject_setState());
 		cmdTable.put("GObject.setVisible", new GObject_setVisible());
 		cmdTable.put("GOptionPane.showMessageDialog", new GOptionPane_showMessageDialog());
 		cmdTable.put("GOptionPane.showConfirmDialog", new GOptionPane_showConfirmDialog());
@@ -123,6 +132,7 @@ public abstract class JBECommand {
 		cmdTable.put("GOptionPane.showOptionDialog", new GOptionPane_showOptionDialog());
 		cmdTable.put("GOval.create", new GOval_create());
 		cmdTable.put("GPolygon.addVertex", new GPolygon_addVertex());
+		cmdTable.put("GPolygon.addVertices", new GPolygon_addVertices());
 		cmdTable.put("GPolygon.create", new GPolygon_create());
 		cmdTable.put("GRect.create", new GRect_create());
 		cmdTable.put("GRoundRect.create", new GRoundRect_create());
@@ -156,6 +166,10 @@ public abstract class JBECommand {
 		cmdTable.put("GWindow.create", new GWindow_create());
 		cmdTable.put("GWindow.delete", new GWindow_delete());
 		cmdTable.put("GWindow.draw", new GWindow_draw());
+		cmdTable.put("GWindow.drawLine", new GWindow_drawLine());
+		cmdTable.put("GWindow.drawLines", new GWindow_drawLines());
+		cmdTable.put("GWindow.drawOval", new GWindow_drawOval());
+		cmdTable.put("GWindow.drawRect", new GWindow_drawRect());
 		cmdTable.put("GWindow.exitGraphics", new GWindow_exitGraphics());
 		cmdTable.put("GWindow.getCanvasWidth", new GWindow_getCanvasWidth());
 		cmdTable.put("GWindow.getCanvasHeight", new GWindow_getCanvasHeight());
@@ -167,6 +181,8 @@ public abstract class JBECommand {
 		cmdTable.put("GWindow.setTitle", new GWindow_setTitle());
 		cmdTable.put("GWindow.setVisible", new GWindow_setVisible());
 		cmdTable.put("TopCompound.create", new TopCompound_create());
+		cmdTable.put("JBE.openSharedMemory", new JBE_openSharedMemory());
+		cmdTable.put("JBE.setProtocol", new JBE_setProtocol());
 		cmdTable.put("JBEConsole.clear", new JBEConsole_clear());
 		cmdTable.put("JBEConsole.getLine", new JBEConsole_getLine());
 		cmdTable.put("JBEConsole.print", new JBEConsole_print());
@@ -181,24 +197,71 @@ public abstract class JBECommand {
 	}
 
 	public int nextInt(TokenScanner scanner) {
+		if (scanner instanceof FrameScanner) {
+			return ((FrameScanner) scanner).nextIntArg();
+		}
 		String token = scanner.nextToken();
 		if (token.equals("-")) token += scanner.nextToken();
 		return Integer.parseInt(token);
 	}
 
 	public double nextDouble(TokenScanner scanner) {
+		if (scanner instanceof FrameScanner) {
+			return ((FrameScanner) scanner).nextDoubleArg();
+		}
 		String token = scanner.nextToken();
 		if (token.equals("-")) token += scanner.nextToken();
 		return Double.parseDouble(token);
 	}
 
 	public String nextString(TokenScanner scanner) {
+		if (scanner instanceof FrameScanner) {
+			return ((FrameScanner) scanner).nextStringArg();
+		}
 		return scanner.getStringValue(scanner.nextToken());
 	}
 
+	// Reads binary data, which a frame carries as raw bytes and the text
+	// protocol as a Base64 string.
+	public byte[] nextBytes(TokenScanner scanner) {
+		if (scanner instanceof FrameScanner) {
+			return ((FrameScanner) scanner).nextBytesArg();
+		}
+		String data = scanner.getStringValue(scanner.nextToken());
+		try {
+			return Base64.decode(data.getBytes("US-ASCII"));
+		} catch (java.io.IOException ex) {
+			throw new RuntimeException(ex.getMessage());
+		}
+	}
+
 	public boolean nextBoolean(TokenScanner scanner) {
+		if (scanner instanceof FrameScanner) {
+			return ((FrameScanner) scanner).nextBooleanArg();
+		}
 		return scanner.nextToken().startsWith("t");
 	}
+
+	// Paints a shape on the offscreen image of a window, as GWindow_draw
+	// paints an object, for the immediate-mode drawing commands.
+	public void paintShape(JavaBackEnd jbe, String id, final Shape shape,
+			String color, final boolean filled) {
+		JBEWindow jw = jbe.getWindow(id);
+		if (jw == null) {
+			throw (new RuntimeException("paintShape: null window"));
+		}
+		final JBECanvas jc = jw.getCanvas();
+		final Graphics2D osg = jc.getOSG();
+		final Color c = JavaBackEnd.decodeColor(color);
+		SwingUtilities.invokeLater(new Runnable() {
+			public void run() {
+				osg.setColor(c);
+				if (filled) osg.fill(shape);
+				osg.draw(shape);
+				jc.repaint();
+			}
+		});
+	}
 }
 
 class GWindow_create extends JBECommand {
@@ -542,6 +605,26 @@ class JBEConsole_setSize extends JBECommand {
 	}
 }
 
+class JBE_setProtocol extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String protocol = nextString(scanner);
+		scanner.verifyToken(")");
+		jbe.setProtocol(protocol);
+	}
+}
+
+class JBE_openSharedMemory extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String path = nextString(scanner);
+		scanner.verifyToken(",");
+		int size = nextInt(scanner);
+		scanner.verifyToken(")");
+		jbe.openSharedMemory(path, size);
+	}
+}
+
 class JBEConsole_getLine extends JBECommand {
 	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
 		scanner.verifyToken("(");
@@ -554,9 +637,10 @@ class JBEConsole_print extends JBECommand {
 	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
 		scanner.verifyToken("(");
 		String str = nextString(scanner);
-		String token = scanner.nextToken();
 		boolean isStdErr = false;
-		if (token.equals(",")) {
+		if (scanner instanceof FrameScanner) {
+			isStdErr = nextBoolean(scanner);
+		} else if (scanner.nextToken().equals(",")) {
 			isStdErr = nextBoolean(scanner);
 		}
 		//scanner.verifyToken(")");
@@ -846,6 +930,32 @@ class GPolygon_addVertex extends JBECommand {
 	}
 }
 
+// OK on main thread
+class GPolygon_addVertices extends JBECommand {
+	// gpolygon.addVertices(count, x1, y1, x2, y2, ...);
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		int n = nextInt(scanner);
+		double[] coords = new double[2 * n];
+		for (int i = 0; i < coords.length; i++) {
+			scanner.verifyToken(",");
+			coords[i] = nextDouble(scanner);
+		}
+		scanner.verifyToken(")");
+		GObject gobj = jbe.getGObject(id);
+		if (gobj != null) {
+			GPolygon poly = (GPolygon) gobj;
+			for (int i = 0; i < coords.length; i += 2) {
+				poly.addVertex(coords[i], coords[i + 1]);
+			}
+		} else {
+			throw (new RuntimeException("GPolygon_addVertices: null object"));
+		}
+	}
+}
+
 
 // OK on main thread, I think
 class GImage_create extends JBECommand {
@@ -1266,6 +1376,94 @@ class GWindow_draw extends JBECommand {
 	}
 }
 
+class GWindow_drawLine extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		double x0 = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double y0 = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double x1 = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double y1 = nextDouble(scanner);
+		scanner.verifyToken(",");
+		String color = nextString(scanner);
+		scanner.verifyToken(")");
+		paintShape(jbe, id, new Line2D.Double(x0, y0, x1, y1), color, false);
+	}
+}
+
+class GWindow_drawRect extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		double x = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double y = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double width = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double height = nextDouble(scanner);
+		scanner.verifyToken(",");
+		String color = nextString(scanner);
+		scanner.verifyToken(",");
+		boolean filled = nextBoolean(scanner);
+		scanner.verifyToken(")");
+		Shape shape = new Rectangle2D.Double(x, y, width, height);
+		paintShape(jbe, id, shape, color, filled);
+	}
+}
+
+class GWindow_drawOval extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		double x = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double y = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double width = nextDouble(scanner);
+		scanner.verifyToken(",");
+		double height = nextDouble(scanner);
+		scanner.verifyToken(",");
+		String color = nextString(scanner);
+		scanner.verifyToken(",");
+		boolean filled = nextBoolean(scanner);
+		scanner.verifyToken(")");
+		Shape shape = new Ellipse2D.Double(x, y, width, height);
+		paintShape(jbe, id, shape, color, filled);
+	}
+}
+
+class GWindow_drawLines extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		String color = nextString(scanner);
+		scanner.verifyToken(",");
+		int n = nextInt(scanner);
+		Path2D.Double path = new Path2D.Double();
+		for (int i = 0; i < n; i++) {
+			scanner.verifyToken(",");
+			double x = nextDouble(scanner);
+			scanner.verifyToken(",");
+			double y = nextDouble(scanner);
+			if (i == 0) {
+				path.moveTo(x, y);
+			} else {
+				path.lineTo(x, y);
+			}
+		}
+		scanner.verifyToken(")");
+		paintShape(jbe, id, path, color, false);
+	}
+}
+
 // OK on main thread. setSize for GOval, GRect, etc., can run on main thread
 // since only Swing method triggered is repaint().
 // setSize for interactors handles invokeLater business itself.
@@ -1292,7 +1490,7 @@ class GObject_setFilled extends JBECommand {
 		scanner.verifyToken("(");
 		String id = nextString(scanner);
 		scanner.verifyToken(",");
-		boolean flag = scanner.nextToken().equals("true");
+		boolean flag = nextBoolean(scanner);
 		scanner.verifyToken(")");
 		GObject gobj = jbe.getGObject(id);
 		if (gobj != null) 
@@ -1320,6 +1518,68 @@ class GObject_setFillColor extends JBECommand {
 	}
 }
 
+// Applies several property changes to one object.  The flags say which
+// properties follow, in the order of the flags; they must match the
+// StateFlag enumeration in platform.cpp.
+class GObject_setState extends JBECommand {
+	private static final int LOCATION = 1;
+	private static final int SIZE = 2;
+	private static final int COLOR = 4;
+	private static final int FILL_COLOR = 8;
+	private static final int FILLED = 16;
+	private static final int VISIBLE = 32;
+	private static final int LINE_WIDTH = 64;
+
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String id = nextString(scanner);
+		scanner.verifyToken(",");
+		int flags = nextInt(scanner);
+		GObject gobj = jbe.getGObject(id);
+		if (gobj == null) {
+			throw (new RuntimeException("GObject_setState: null object:" + id));
+		}
+		if ((flags & LOCATION) != 0) {
+			scanner.verifyToken(",");
+			double x = nextDouble(scanner);
+			scanner.verifyToken(",");
+			double y = nextDouble(scanner);
+			gobj.setLocation(x, y);
+		}
+		if ((flags & SIZE) != 0) {
+			scanner.verifyToken(",");
+			double width = nextDouble(scanner);
+			scanner.verifyToken(",");
+			double height = nextDouble(scanner);
+			((GResizable) gobj).setSize(width, height);
+		}
+		if ((flags & COLOR) != 0) {
+			scanner.verifyToken(",");
+			String color = nextString(scanner);
+			gobj.setColor(color.equals("") ? null : JavaBackEnd.decodeColor(color));
+		}
+		if ((flags & FILL_COLOR) != 0) {
+			scanner.verifyToken(",");
+			String color = nextString(scanner);
+			Color c = color.equals("") ? null : JavaBackEnd.decodeColor(color);
+			((GFillable) gobj).setFillColor(c);
+		}
+		if ((flags & FILLED) != 0) {
+			scanner.verifyToken(",");
+			((GFillable) gobj).setFilled(nextBoolean(scanner));
+		}
+		if ((flags & VISIBLE) != 0) {
+			scanner.verifyToken(",");
+			gobj.setVisible(nextBoolean(scanner));
+		}
+		if ((flags & LINE_WIDTH) != 0) {
+			scanner.verifyToken(",");
+			gobj.setLineWidth(nextDouble(scanner));
+		}
+		scanner.verifyToken(")");
+	}
+}
+
 // OK on main thread; actual setting occurs on EDT (see JBELabel)
 class GLabel_setFont extends JBECommand {
 	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
@@ -1353,6 +1613,32 @@ class GLabel_setLabel extends JBECommand {
 	}
 }
 
+/*
+ * Reports the metrics that the C++ side needs to measure labels itself:
+ * the ascent, descent, and height of the font, followed by the advance
+ * widths of the printable ASCII characters from ' ' through '~'.
+ */
+
+// OK on main thread
+class GLabel_getFontMetrics extends JBECommand {
+	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
+		scanner.verifyToken("(");
+		String font = nextString(scanner);
+		scanner.verifyToken(")");
+		GLabel probe = new GLabel("");
+		probe.setFont(font);
+		FontMetrics fm = probe.getFontMetrics();
+		StringBuilder sb = new StringBuilder("result:");
+		sb.append(fm.getAscent()).append(' ');
+		sb.append(fm.getDescent()).append(' ');
+		sb.append(fm.getHeight());
+		for (char ch = ' '; ch <= '~'; ch++) {
+			sb.append(' ').append(fm.charWidth(ch));
+		}
+		jbe.println(sb.toString());
+	}
+}
+
 class GLabel_getFontAscent extends JBECommand {
 	public void execute(TokenScanner scanner, JavaBackEnd jbe) {
 		scanner.verifyToken("(");
@@ -1964,14 +2250,11 @@ class GBufferedImage_load extends JBECommand {
 		GObject gobj = jbe.getGObject(id);
 		if (gobj != null && gobj instanceof GBufferedImage) {
 			GBufferedImage img = (GBufferedImage) gobj;
-			result = img.load(filename);
-			jbe.println("result:" + result);
+			jbe.printBulkResult(img.load(filename));
 		} else {
 			jbe.println("result:");
 		}
 	}
-
-	public String result;
 }
 
 class GBufferedImage_resize extends JBECommand {
@@ -2015,33 +2298,31 @@ class GBufferedImage_save extends JBECommand {
 	}
 }
 
-class GBufferedImage_scale extends JBECommand {
-	// gbufferedimage.scale(targetImage, w, h);
+class GBufferedImage_setRGB extends JBECommand {
+	// gbufferedimage.setRGB(x, y, rgb);
 	public void execute(TokenScanner paramTokenScanner, JavaBackEnd jbe) {
 		paramTokenScanner.verifyToken("(");
-		String id1 = nextString(paramTokenScanner);
+		String id = nextString(paramTokenScanner);
 		paramTokenScanner.verifyToken(",");
-		String id2 = nextString(paramTokenScanner);
+		int x = nextInt(paramTokenScanner);
 		paramTokenScanner.verifyToken(",");
-		int w = nextInt(paramTokenScanner);
+		int y = nextInt(paramTokenScanner);
 		paramTokenScanner.verifyToken(",");
-		int h = nextInt(paramTokenScanner);
+		int rgb = nextInt(paramTokenScanner);
 		paramTokenScanner.verifyToken(")");
 
-		GObject gobj1 = jbe.getGObject(id1);
-		GObject gobj2 = jbe.getGObject(id2);
-		if (gobj1 != null && gobj1 instanceof GBufferedImage
-				&& gobj2 != null && gobj2 instanceof GBufferedImage) {
-			String result = ((GBufferedImage) gobj1).scale((GBufferedImage) gobj2, w, h);
-			jbe.println("result:" + result);
-		} else {
-			throw (new RuntimeException("GBufferedImage_scale: invalid GBufferedImage"));
+		GObject gobj = jbe.getGObject(id);
+		if (gobj != null && gobj instanceof GBufferedImage) {
+			GBufferedImage img = (GBufferedImage) gobj;
+			img.setRGB(x, y, rgb);
 		}
 	}
 }
 
-class GBufferedImage_setRGB extends JBECommand {
-	// gbufferedimage.setRGB(x, y, rgb);
+// The pixels arrive three bytes per pixel, row by row, as raw bytes in a
+// frame or in Base64 in the text protocol.
+class GBufferedImage_updateRegion extends JBECommand {
+	// gbufferedimage.updateRegion(x, y, width, height, data);
 	public void execute(TokenScanner paramTokenScanner, JavaBackEnd jbe) {
 		paramTokenScanner.verifyToken("(");
 		String id = nextString(paramTokenScanner);
@@ -2050,13 +2331,43 @@ class GBufferedImage_setRGB extends JBECommand {
 		paramTokenScanner.verifyToken(",");
 		int y = nextInt(paramTokenScanner);
 		paramTokenScanner.verifyToken(",");
-		int rgb = nextInt(paramTokenScanner);
+		int w = nextInt(paramTokenScanner);
+		paramTokenScanner.verifyToken(",");
+		int h = nextInt(paramTokenScanner);
+		paramTokenScanner.verifyToken(",");
+		byte[] data = nextBytes(paramTokenScanner);
 		paramTokenScanner.verifyToken(")");
 
 		GObject gobj = jbe.getGObject(id);
 		if (gobj != null && gobj instanceof GBufferedImage) {
 			GBufferedImage img = (GBufferedImage) gobj;
-			img.setRGB(x, y, rgb);
+			img.updateRegion(x, y, w, h, data);
+		}
+	}
+}
+
+// The regions are listed as x, y, width, height; their pixels follow in
+// one block of data, in the order of the regions.
+class GBufferedImage_updateRegions extends JBECommand {
+	// gbufferedimage.updateRegions(count, x1, y1, w1, h1, ..., data);
+	public void execute(TokenScanner paramTokenScanner, JavaBackEnd jbe) {
+		paramTokenScanner.verifyToken("(");
+		String id = nextString(paramTokenScanner);
+		paramTokenScanner.verifyToken(",");
+		int count = nextInt(paramTokenScanner);
+		int[] rects = new int[4 * count];
+		for (int i = 0; i < rects.length; i++) {
+			paramTokenScanner.verifyToken(",");
+			rects[i] = nextInt(paramTokenScanner);
+		}
+		paramTokenScanner.verifyToken(",");
+		byte[] data = nextBytes(paramTokenScanner);
+		paramTokenScanner.verifyToken(")");
+
+		GObject gobj = jbe.getGObject(id);
+		if (gobj != null && gobj instanceof GBufferedImage) {
+			GBufferedImage img = (GBufferedImage) gobj;
+			img.updateRegions(rects, data);
 		}
 	}
 }
@@ -2134,7 +2445,7 @@ class GTextArea_getText extends JBECommand {
 			throw (new RuntimeException(e.getMessage()));
 		}
 		if (!wasNull)
-			jbe.println("result:" + result);
+			jbe.printBulkResult(result.getBytes());
 		else
 			throw (new RuntimeException("GTextArea_getText: null text area"));
 	}
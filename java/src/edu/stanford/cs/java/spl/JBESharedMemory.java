@@ -0,0 +1,115 @@
+/*
+ * JBESharedMemory.java
+ */
+
+/*************************************************************************/
+/* Stanford Portable Library                                             */
+/* Copyright (c) 2014 by Eric Roberts <eroberts@cs.stanford.edu>         */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/*************************************************************************/
+
+package edu.stanford.cs.java.spl;
+
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.charset.Charset;
+
+/**
+ * The memory region that the C++ side shares with the back end for bulk
+ * data.  The region starts with a HEADER_SIZE-byte header followed by two
+ * rings of the same size.  The outbound ring carries strings from C++ to
+ * the back end, and the inbound ring carries bulk results back.  Each
+ * side counts the bytes it has written to its ring, and the reader of a
+ * ring publishes the number of bytes it has consumed in the header: the
+ * eight bytes at OUT_CONSUMED for the outbound ring and those at
+ * IN_CONSUMED for the inbound one, in the byte order of the machine so
+ * that each side updates a counter with a single store.  A block never
+ * wraps around the end of a ring; the writer skips to the start instead.
+ * The layout must match the shared-memory notes in platform.cpp.
+ */
+
+public class JBESharedMemory {
+
+	private static final int HEADER_SIZE = 64;
+	private static final int OUT_CONSUMED = 0;
+	private static final int IN_CONSUMED = 8;
+	private static final Charset UTF8 = Charset.forName("UTF-8");
+
+	/**
+	 * Maps the region stored in the file at <code>path</code>, which the
+	 * C++ side has created with the specified size.
+	 */
+	public JBESharedMemory(String path, int size) throws IOException {
+		RandomAccessFile file = new RandomAccessFile(path, "rw");
+		try {
+			buffer = file.getChannel().map(FileChannel.MapMode.READ_WRITE,
+					0, size);
+			buffer.order(ByteOrder.nativeOrder());
+		} finally {
+			file.close();
+		}
+		areaSize = (size - HEADER_SIZE) / 2;
+	}
+
+	/**
+	 * Returns the string of <code>length</code> bytes that the C++ side
+	 * wrote at position <code>pos</code> of the outbound ring, and marks
+	 * the space up to its end as free.
+	 */
+	public String readString(long pos, int length) {
+		return new String(readBytes(pos, length), UTF8);
+	}
+
+	/**
+	 * Returns the <code>length</code> bytes that the C++ side wrote at
+	 * position <code>pos</code> of the outbound ring, without decoding
+	 * them, and marks the space up to their end as free.
+	 */
+	public byte[] readBytes(long pos, int length) {
+		byte[] bytes = new byte[length];
+		synchronized (buffer) {
+			buffer.position(HEADER_SIZE + (int) (pos % areaSize));
+			buffer.get(bytes);
+			buffer.putLong(OUT_CONSUMED, pos + length);
+		}
+		return bytes;
+	}
+
+	/**
+	 * Copies <code>data</code> into the inbound ring and returns its
+	 * position, or returns -1 if there is not enough free space.
+	 */
+	public long writeResult(byte[] data) {
+		synchronized (buffer) {
+			long pos = written;
+			int offset = (int) (pos % areaSize);
+			if (offset + data.length > areaSize) pos += areaSize - offset;
+			if (pos + data.length - buffer.getLong(IN_CONSUMED) > areaSize) {
+				return -1;
+			}
+			buffer.position(HEADER_SIZE + areaSize + (int) (pos % areaSize));
+			buffer.put(data);
+			written = pos + data.length;
+			return pos;
+		}
+	}
+
+	private MappedByteBuffer buffer;
+	private int areaSize;
+	private long written;
+}
@@ -50,12 +50,13 @@ import java.lang.reflect.InvocationHandler;
 import java.lang.reflect.Method;
 import java.lang.reflect.Proxy;
 import java.io.BufferedInputStream;
-import java.io.BufferedReader;
+import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
+import java.io.EOFException;
 import java.io.File;
 import java.io.FileInputStream;
 import java.io.FileOutputStream;
 import java.io.IOException;
-import java.io.InputStreamReader;
 import java.io.PrintStream;
 import java.net.MalformedURLException;
 import java.net.URL;
@@ -211,7 +212,7 @@ ChangeListener {
 		}
 		
 		JBEWindow window = new JBEWindow(this, id, appName, width, height);
-		windowTable.put(id, window);
+		windowTable.put(canonicalId(id), window);
 		
 		// Ugly hack by JL to compensate for top menu bar on Mac
 		if (isMacOS) {
@@ -280,11 +281,11 @@ ChangeListener {
 	}
 
 	protected void deleteWindow(String id) {
-		windowTable.remove(id);
+		windowTable.remove(canonicalId(id));
 	}
 
 	protected void defineGObject(String id, GObject gobj) {
-		gobjTable.put(id, gobj);
+		gobjTable.put(canonicalId(id), gobj);
 	}
 
 	protected void defineSource(JComponent comp, String id) {
@@ -292,7 +293,7 @@ ChangeListener {
 	}
 
 	protected void deleteGObject(String id) {
-		gobjTable.remove(id);
+		gobjTable.remove(canonicalId(id));
 	}
 
 	protected String getSourceId(JComponent comp) {
@@ -300,7 +301,28 @@ ChangeListener {
 	}
 
 	protected GObject getGObject(String id) {
-		return gobjTable.get(id);
+		return gobjTable.get(canonicalId(id));
+	}
+
+	/**
+	 * Returns the key under which the object with the specified id is
+	 * stored.  The C++ side names objects by their addresses, which the
+	 * text protocol sends in the platform's pointer format and binary
+	 * frames send as integers; both reduce to the same lowercase
+	 * hexadecimal string without a prefix or leading zeros.
+	 */
+
+	protected static String canonicalId(String id) {
+		int start = 0;
+		int n = id.length();
+		if (n > 2 && id.charAt(0) == '0'
+				&& (id.charAt(1) == 'x' || id.charAt(1) == 'X')) {
+			start = 2;
+		}
+		while (start < n - 1 && id.charAt(start) == '0') {
+			start++;
+		}
+		return id.substring(start).toLowerCase();
 	}
 
 	protected JComponent getInteractor(GObject gobj) {
@@ -313,7 +335,7 @@ ChangeListener {
 	}
 
 	protected JBEWindow getWindow(String id) {
-		return windowTable.get(id);
+		return windowTable.get(canonicalId(id));
 	}
 
 	public JFrame getConsoleFrame() {
@@ -680,7 +702,7 @@ ChangeListener {
 				System.out.flush();
 				acknowledgeEvent();
 			}
-			windowTable.remove(jw.getWindowId());
+			windowTable.remove(canonicalId(jw.getWindowId()));
 		} else {
 			// Console was closed
 			synchronized (eventLock) {
@@ -740,17 +762,18 @@ ChangeListener {
 
 	public void componentHidden(ComponentEvent e) { }
 	public void componentMoved(ComponentEvent e) { }
+	// Every resize is reported, since the C++ side caches the sizes of
+	// the canvas and the interactors; it drops the events outside the
+	// mask, so only those inside the mask answer a wait for an event.
 	public void componentResized(ComponentEvent e) {
-		if ((eventMask & WINDOW_EVENT) != 0) {
-			JBECanvas jc = (JBECanvas) e.getSource();
-			synchronized (eventLock) {
-				System.out.print("event:windowResized");
-				System.out.print("(\"" + jc.getWindowId());
-				System.out.print("\", " + getEventTime());
-				System.out.println(")");
-				System.out.flush();
-				acknowledgeEvent();
-			}
+		JBECanvas jc = (JBECanvas) e.getSource();
+		synchronized (eventLock) {
+			System.out.print("event:windowResized");
+			System.out.print("(\"" + jc.getWindowId());
+			System.out.print("\", " + getEventTime());
+			System.out.println(")");
+			System.out.flush();
+			if ((eventMask & WINDOW_EVENT) != 0) acknowledgeEvent();
 		}
 	}
 
@@ -769,17 +792,101 @@ ChangeListener {
 		}
 	}
 
+	/**
+	 * Switches the command stream between the text protocol, in which
+	 * each command is a line, and the binary protocol described in
+	 * FrameScanner.  The switch takes effect with the next command.
+	 */
+
+	protected void setProtocol(String name) {
+		if (name.equals("binary")) {
+			binaryProtocol = true;
+		} else if (name.equals("text")) {
+			binaryProtocol = false;
+		} else {
+			throw new RuntimeException("setProtocol: Unknown protocol " + name);
+		}
+		println("result:" + name);
+	}
+
+	/**
+	 * Maps the shared-memory region that the C++ side has created for
+	 * bulk data and answers "ok", or answers with the reason it could
+	 * not be mapped, in which case bulk data stays in the pipe.
+	 */
+
+	protected void openSharedMemory(String path, int size) {
+		try {
+			sharedMemory = new JBESharedMemory(path, size);
+			println("result:ok");
+		} catch (Exception ex) {
+			println("result:" + ex.getMessage());
+		}
+	}
+
+	protected JBESharedMemory getSharedMemory() {
+		return sharedMemory;
+	}
+
+	/**
+	 * Sends a result that may be large.  The data goes through the shared
+	 * memory region when there is one and it has room, in which case the
+	 * reply line gives only its position and length; otherwise the data is sent in
+	 * the pipe encoded in Base64.
+	 */
+
+	protected void printBulkResult(byte[] data) {
+		long pos = (sharedMemory == null) ? -1 : sharedMemory.writeResult(data);
+		if (pos >= 0) {
+			println("bulk:" + pos + "," + data.length);
+		} else {
+			println("result:" + Base64.encodeBytes(data));
+		}
+	}
+
 	private void commandLoop() {
-		BufferedReader rd = new BufferedReader(new InputStreamReader(System.in));
+		DataInputStream in =
+			new DataInputStream(new BufferedInputStream(System.in, 65536));
 		TokenScanner scanner = new TokenScanner();
 		scanner.ignoreWhitespace();
 		scanner.scanNumbers();
 		scanner.scanStrings();
 		scanner.addWordCharacters(".");
+		FrameScanner frameScanner = new FrameScanner(this);
+		byte[] body = new byte[256];
+		ByteArrayOutputStream lineBuffer = new ByteArrayOutputStream();
 		while (true) {
 			try {
-				String line = rd.readLine();
-				if (line == null) break;
+				String line = null;
+				if (binaryProtocol) {
+					int length;
+					try {
+						length = in.readInt();
+					} catch (EOFException ex) {
+						break;
+					}
+					int opcode = in.readUnsignedShort();
+					length -= 2;
+					if (length > body.length) {
+						body = new byte[Math.max(length, 2 * body.length)];
+					}
+					in.readFully(body, 0, length);
+					if (opcode == FrameScanner.TEXT) {
+						line = new String(body, 0, length);
+					} else {
+						String fn = FrameScanner.OPCODE_NAMES[opcode];
+						if (DEBUG) {
+							printLog(fn + " [frame]");
+						}
+						frameScanner.setFrame(body, length);
+						JBECommand cmd = cmdTable.get(fn);
+						if (cmd != null) cmd.execute(frameScanner, this);
+						continue;
+					}
+				} else {
+					line = readLine(in, lineBuffer);
+					if (line == null) break;
+				}
 				if (DEBUG) {
 					printLog(line);
 				}
@@ -794,6 +901,29 @@ ChangeListener {
 		}
 	}
 
+	/*
+	 * Reads one text command from the byte stream, which has to be done by
+	 * hand because the same stream carries binary frames once the protocol
+	 * is switched.  Returns null at the end of the input.
+	 */
+
+	private static String readLine(DataInputStream in,
+			ByteArrayOutputStream lineBuffer) throws IOException {
+		lineBuffer.reset();
+		while (true) {
+			int ch = in.read();
+			if (ch == -1) {
+				if (lineBuffer.size() == 0) return null;
+				break;
+			}
+			if (ch == '\n') break;
+			lineBuffer.write(ch);
+		}
+		String line = lineBuffer.toString();
+		if (line.endsWith("\r")) line = line.substring(0, line.length() - 1);
+		return line;
+	}
+
 	private void processArguments(String[] args) {
 		appName = "JBE";
 		exec = null;
@@ -926,6 +1056,8 @@ ChangeListener {
 	private int consoleWidth = DEFAULT_CONSOLE_WIDTH;
 	private int consoleHeight = DEFAULT_CONSOLE_HEIGHT;
 	private HashMap<String,JBECommand> cmdTable;
+	private boolean binaryProtocol;
+	private JBESharedMemory sharedMemory;
 	private HashMap<String,JBEWindow> windowTable;
 	private HashMap<String,GObject> gobjTable;
 	private HashMap<String,GTimer> timerTable;
@@ -0,0 +1,156 @@
+/*
+ * @file gcompound-test.cpp
+ *
+ * Checks GCompound against a simple model of its contents: a vector of
+ * the children from back to front.  A long random sequence of adds,
+ * removals, deletions, z-order changes, moves, and resizes is applied
+ * to both, and after each step getElementCount, getElement,
+ * getElementAt, contains, and getBounds must agree with the answers
+ * computed from the model.  The number of children rises well past the
+ * point at which GCompound builds its spatial index and falls back
+ * below it several times.
+ *
+ * Run with JBEBACKEND=headless to test without the Java back end.
+ * Uses printf, so don't use Java console.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "gobjects.h"
+#include "gwindow.h"
+#include "random.h"
+
+using namespace std;
+
+static const int STEPS = 20000;
+static const int PHASE_LENGTH = 2500;
+static const int PROBES = 8;
+
+static GCompound *comp;
+static vector<GObject *> model;
+static int failures = 0;
+
+static void fail(int step, const char *what) {
+    if (failures++ < 20) printf("step %d: %s\n", step, what);
+}
+
+static int pick() {
+    return randomInteger(0, model.size() - 1);
+}
+
+static void apply(bool growing) {
+    int op = randomInteger(0, 9);
+    if (model.empty() || op <= (growing ? 3 : 0)) {
+        GRect *rect = new GRect(randomReal(0, 40), randomReal(0, 40));
+        comp->add(rect, randomReal(-50, 450), randomReal(-50, 350));
+        model.push_back(rect);
+        return;
+    }
+    int i = pick();
+    GObject *gobj = model[i];
+    switch (op) {
+    case 1:
+        comp->remove(gobj);
+        model.erase(model.begin() + i);
+        delete gobj;
+        break;
+    case 2:
+        model.erase(model.begin() + i);
+        delete gobj;
+        break;
+    case 3:
+        gobj->setLocation(randomReal(-50, 450), randomReal(-50, 350));
+        break;
+    case 4:
+        gobj->move(randomReal(-20, 20), randomReal(-20, 20));
+        break;
+    case 5:
+        ((GRect *) gobj)->setSize(randomReal(0, 60), randomReal(0, 60));
+        break;
+    case 6:
+        gobj->sendToFront();
+        model.erase(model.begin() + i);
+        model.push_back(gobj);
+        break;
+    case 7:
+        gobj->sendToBack();
+        model.erase(model.begin() + i);
+        model.insert(model.begin(), gobj);
+        break;
+    case 8:
+        gobj->sendForward();
+        if (i + 1 < (int) model.size()) swap(model[i], model[i + 1]);
+        break;
+    default:
+        gobj->sendBackward();
+        if (i > 0) swap(model[i], model[i - 1]);
+        break;
+    }
+}
+
+static void check(int step) {
+    if (comp->getElementCount() != (int) model.size()) {
+        fail(step, "getElementCount differs");
+        return;
+    }
+    for (int i = 0; i < (int) model.size(); i++) {
+        if (comp->getElement(i) != model[i]) {
+            fail(step, "getElement differs");
+            break;
+        }
+    }
+    for (int k = 0; k < PROBES; k++) {
+        double x = randomReal(-60, 500);
+        double y = randomReal(-60, 400);
+        GObject *top = NULL;
+        for (int i = model.size() - 1; i >= 0 && top == NULL; i--) {
+            if (model[i]->contains(x, y)) top = model[i];
+        }
+        if (comp->getElementAt(x, y) != top) fail(step, "getElementAt differs");
+        if (comp->contains(x + comp->getX(), y + comp->getY()) != (top != NULL)) {
+            fail(step, "contains differs");
+        }
+    }
+    if (model.empty()) return;
+    double x1 = 1E20, y1 = 1E20, x2 = -1E20, y2 = -1E20;
+    for (GObject *gobj : model) {
+        GRectangle r = gobj->getBounds();
+        x1 = min(x1, r.getX());
+        y1 = min(y1, r.getY());
+        x2 = max(x2, r.getX() + r.getWidth());
+        y2 = max(y2, r.getY() + r.getHeight());
+    }
+    GRectangle bounds = comp->getBounds();
+    if (fabs(bounds.getX() - comp->getX() - x1) > 1E-9
+            || fabs(bounds.getY() - comp->getY() - y1) > 1E-9
+            || fabs(bounds.getWidth() - (x2 - x1)) > 1E-9
+            || fabs(bounds.getHeight() - (y2 - y1)) > 1E-9) {
+        fail(step, "getBounds differs");
+    }
+}
+
+int main() {
+    setRandomSeed(106);
+    GWindow gw(500, 400);
+    comp = new GCompound();
+    gw.add(comp, 20, 30);
+    int maxSize = 0;
+    for (int step = 0; step < STEPS; step++) {
+        apply((step / PHASE_LENGTH) % 2 == 0);
+        if (randomChance(0.001)) {
+            comp->removeAll();
+            for (GObject *gobj : model) {
+                delete gobj;
+            }
+            model.clear();
+        }
+        maxSize = max(maxSize, (int) model.size());
+        check(step);
+    }
+    printf("%d steps, up to %d children: %s (%d failures)\n", STEPS, maxSize,
+           (failures == 0) ? "ok" : "FAILED", failures);
+    if (failures > 0) return 1;
+    exitGraphics();
+    return 0;
+}
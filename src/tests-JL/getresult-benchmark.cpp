@@ -0,0 +1,41 @@
+/*
+ * @file getresult-benchmark.cpp
+ *
+ * Measures how fast large replies come back from the Java back end.
+ * A GTextArea is filled with text of increasing size, and getText,
+ * which returns the whole text as a single reply line, is timed.
+ *
+ * Uses printf, so don't use Java console.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "gtextarea.h"
+#include "gwindow.h"
+
+using namespace std;
+
+static const int REPEATS = 5;
+static const int SIZES_KB[] = { 64, 1024, 4096, 16384 };
+
+int main() {
+    GWindow gw(400, 300);
+    GTextArea *textArea = new GTextArea(300, 200);
+    gw.addToRegion(textArea, "CENTER");
+    for (int kb : SIZES_KB) {
+        string text(kb * 1024, 'x');
+        textArea->setText(text);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        size_t received = 0;
+        for (int i = 0; i < REPEATS; i++) {
+            received += textArea->getText().length();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%6d KB reply  %8.2f ms/call  %8.1f MB/s  %s\n", kb,
+               1000 * seconds / REPEATS, received / seconds / 1e6,
+               received == text.length() * REPEATS ? "ok" : "SIZE MISMATCH");
+    }
+    exitGraphics();
+    return 0;
+}
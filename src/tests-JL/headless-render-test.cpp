@@ -0,0 +1,146 @@
+/*
+ * @file headless-render-test.cpp
+ *
+ * Checks the pixels that the headless back end draws for a few simple
+ * scenes: a filled rectangle, an object that has been moved, regions of
+ * a GBufferedImage, and lines and rectangles drawn directly on the
+ * window.  Every command reaches the headless rasterizer through the
+ * same text protocol that is sent to the Java back end, so this also
+ * exercises the interpreter for that protocol.  If any pixel is wrong,
+ * the canvas is saved to headless-render-test.ppm.
+ *
+ * Run with JBEBACKEND=headless.
+ * Uses printf, so don't use Java console.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include "gbufferedimage.h"
+#include "gobjects.h"
+#include "gwindow.h"
+#include "headless.h"
+#include "vector.h"
+
+using namespace std;
+
+static const int WHITE = 0xFFFFFF;
+static const int BLACK = 0x000000;
+static const int RED = 0xFF0000;
+static const int GREEN = 0x00FF00;
+static const int BLUE = 0x0000FF;
+static const int MAGENTA = 0xFF00FF;
+
+static GWindow *gw;
+static Grid<int> pixels;
+static int failures = 0;
+
+static void snapshot() {
+    pixels = getWindowPixels(*gw);
+}
+
+static void expect(const char *what, int x, int y, int rgb) {
+    int actual = pixels[y][x];
+    if (actual != rgb) {
+        failures++;
+        printf("%s: pixel (%d, %d) is %06x, expected %06x\n",
+               what, x, y, actual, rgb);
+    }
+}
+
+static void testFilledRect() {
+    GRect *rect = new GRect(20, 20, 60, 40);
+    rect->setColor("RED");
+    rect->setFilled(true);
+    gw->add(rect);
+    snapshot();
+    expect("filled rect", 50, 40, RED);
+    expect("filled rect", 20, 20, RED);
+    expect("filled rect", 80, 60, RED);
+    expect("filled rect", 19, 40, WHITE);
+    expect("filled rect", 81, 40, WHITE);
+    expect("filled rect", 50, 61, WHITE);
+}
+
+static void testMovedObject() {
+    GOval *oval = new GOval(120, 20, 30, 30);
+    oval->setColor("BLUE");
+    oval->setFilled(true);
+    gw->add(oval);
+    snapshot();
+    expect("oval", 135, 35, BLUE);
+    expect("oval", 121, 21, WHITE);
+    oval->setLocation(200, 20);
+    snapshot();
+    expect("moved oval", 135, 35, WHITE);
+    expect("moved oval", 215, 35, BLUE);
+    oval->move(0, 40);
+    snapshot();
+    expect("moved oval", 215, 35, WHITE);
+    expect("moved oval", 215, 75, BLUE);
+}
+
+static void testBufferedImage() {
+    GBufferedImage *img = new GBufferedImage(20, 100, 50, 50, BLACK);
+    gw->add(img);
+    img->fillRegion(10, 10, 20, 20, GREEN);
+    img->setRGB(45, 45, BLUE);
+    snapshot();
+    expect("image", 25, 105, BLACK);
+    expect("image", 30, 110, GREEN);
+    expect("image", 49, 129, GREEN);
+    expect("image", 50, 115, BLACK);
+    expect("image", 35, 130, BLACK);
+    expect("image", 65, 145, BLUE);
+    expect("image", 69, 149, BLACK);
+    expect("image", 70, 150, WHITE);
+    GBufferedImage *buffered = new GBufferedImage(100, 100, 20, 20, BLACK);
+    buffered->setDoubleBuffered(true);
+    gw->add(buffered);
+    buffered->fillRegion(0, 0, 20, 20, RED);
+    snapshot();
+    expect("double-buffered image", 110, 110, BLACK);
+    buffered->present();
+    snapshot();
+    expect("double-buffered image", 110, 110, RED);
+}
+
+static void testDrawing() {
+    Vector<GPoint> points;
+    points.add(GPoint(150, 150));
+    points.add(GPoint(250, 150));
+    points.add(GPoint(250, 250));
+    gw->setColor("MAGENTA");
+    gw->drawLines(points);
+    gw->setColor("GREEN");
+    gw->fillRect(300, 150, 40, 40);
+    snapshot();
+    expect("drawLines", 150, 150, MAGENTA);
+    expect("drawLines", 200, 150, MAGENTA);
+    expect("drawLines", 250, 200, MAGENTA);
+    expect("drawLines", 250, 250, MAGENTA);
+    expect("drawLines", 200, 151, WHITE);
+    expect("drawLines", 200, 200, WHITE);
+    expect("drawLines", 250, 251, WHITE);
+    expect("fillRect", 320, 170, GREEN);
+    expect("fillRect", 299, 170, WHITE);
+}
+
+int main() {
+    if (!isHeadless()) {
+        printf("This test requires JBEBACKEND=headless\n");
+        return 0;
+    }
+    gw = new GWindow(400, 300);
+    testFilledRect();
+    testMovedObject();
+    testBufferedImage();
+    testDrawing();
+    if (failures > 0) {
+        saveWindowImage(*gw, "headless-render-test.ppm");
+        printf("FAILED (%d pixels wrong)\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    exitGraphics();
+    return 0;
+}
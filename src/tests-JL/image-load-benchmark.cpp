@@ -0,0 +1,66 @@
+/*
+ * @file image-load-benchmark.cpp
+ *
+ * Measures how long GBufferedImage::load takes as the image grows, for
+ * both ways an image can be loaded.  Each image is generated in memory
+ * and saved twice.  The PNG file is written and read by the library
+ * itself, so loading it times the C++ decoder.  The GIF file is written
+ * and read by the Java back end, so loading it times the transfer of
+ * every pixel from the back end as packed RGB.  The GIF image is reduced
+ * to 64 colors first so that it survives the format unchanged.
+ *
+ * Uses printf, so don't use Java console.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "filelib.h"
+#include "gbufferedimage.h"
+#include "grid.h"
+
+using namespace std;
+
+static const int REPEATS = 3;
+static const int SIZES[][2] = {
+    { 256, 256 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 }
+};
+
+static void timeLoad(const char *path, const string & filename,
+                     const Grid<int> & pixels) {
+    GBufferedImage source;
+    source.setPixels(pixels);
+    source.save(filename);
+
+    GBufferedImage image;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < REPEATS; i++) {
+        image.load(filename);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%5d x %-5d %-9s %10.2f ms/load  %8.1f Mpixels/s  %s\n",
+           pixels.numCols(), pixels.numRows(), path, 1000 * seconds / REPEATS,
+           (double) pixels.numCols() * pixels.numRows() * REPEATS / seconds / 1e6,
+           image.getPixels() == pixels ? "ok" : "PIXEL MISMATCH");
+    deleteFile(filename);
+}
+
+int main() {
+    for (const int *size : SIZES) {
+        int width = size[0];
+        int height = size[1];
+        Grid<int> pixels(height, width);
+        Grid<int> reduced(height, width);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                pixels[y][x] = ((x * 255 / width) << 16) | ((y * 255 / height) << 8)
+                               | ((x ^ y) & 0xff);
+                reduced[y][x] = pixels[y][x] & 0xC0C0C0;
+            }
+        }
+        timeLoad("library", "image-load-benchmark.png", pixels);
+        timeLoad("back end", "image-load-benchmark.gif", reduced);
+    }
+    exitGraphics();
+    return 0;
+}
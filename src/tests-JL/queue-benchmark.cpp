@@ -0,0 +1,126 @@
+/*
+ * @file queue-benchmark.cpp
+ *
+ * Measures producer/consumer throughput of SPSCQueue and MPMCQueue
+ * against a Queue guarded by a Lock, the pattern they replace.
+ *
+ * Uses printf, so don't use Java console.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include "concurrentqueue.h"
+#include "queue.h"
+#include "thread.h"
+
+using namespace std;
+
+static const int ITEMS = 2000000;
+static const int CAPACITY = 1024;
+static const int MAX_THREADS = 4;
+
+/*
+ * Queue + Lock baseline.  Producers wait while the queue holds CAPACITY
+ * items so that all three variants are bounded the same way.
+ */
+
+struct LockedQueue {
+    Queue<int> queue;
+    Lock lock;
+};
+
+struct Worker {
+    void *queue;
+    int count;
+    long long sum;
+};
+
+static void lockedProducer(Worker & worker) {
+    LockedQueue *lq = (LockedQueue *) worker.queue;
+    for (int i = 1; i <= worker.count; i++) {
+        synchronized (lq->lock) {
+            while (lq->queue.size() >= CAPACITY) {
+                lq->lock.wait();
+            }
+            lq->queue.enqueue(i);
+            lq->lock.signal();
+        }
+    }
+}
+
+static void lockedConsumer(Worker & worker) {
+    LockedQueue *lq = (LockedQueue *) worker.queue;
+    for (int i = 0; i < worker.count; i++) {
+        synchronized (lq->lock) {
+            while (lq->queue.isEmpty()) {
+                lq->lock.wait();
+            }
+            worker.sum += lq->queue.dequeue();
+            lq->lock.signal();
+        }
+    }
+}
+
+template <typename QueueType>
+static void producer(Worker & worker) {
+    QueueType *queue = (QueueType *) worker.queue;
+    for (int i = 1; i <= worker.count; i++) {
+        queue->enqueue(i);
+    }
+}
+
+template <typename QueueType>
+static void consumer(Worker & worker) {
+    QueueType *queue = (QueueType *) worker.queue;
+    for (int i = 0; i < worker.count; i++) {
+        worker.sum += queue->dequeue();
+    }
+}
+
+/*
+ * Runs nThreads producers and nThreads consumers over the shared queue,
+ * checks that every item arrived exactly once, and reports items/second.
+ */
+static void run(const char *name, void *queue, int nThreads,
+                void (*produce)(Worker &), void (*consume)(Worker &)) {
+    Worker producers[MAX_THREADS];
+    Worker consumers[MAX_THREADS];
+    Thread threads[2 * MAX_THREADS];
+    int perThread = ITEMS / nThreads;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < nThreads; i++) {
+        Worker w = { queue, perThread, 0 };
+        producers[i] = w;
+        consumers[i] = w;
+        threads[2 * i] = fork(consume, consumers[i]);
+        threads[2 * i + 1] = fork(produce, producers[i]);
+    }
+    long long sum = 0;
+    for (int i = 0; i < nThreads; i++) {
+        join(threads[2 * i]);
+        join(threads[2 * i + 1]);
+        sum += consumers[i].sum;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long long expected = (long long) nThreads * perThread * (perThread + 1) / 2;
+    printf("%-12s %dP/%dC  %8.2f Mitems/s  %s\n", name, nThreads, nThreads,
+           nThreads * perThread / seconds / 1e6,
+           sum == expected ? "ok" : "CHECKSUM MISMATCH");
+}
+
+int main() {
+    printf("%d items, capacity %d\n", ITEMS, CAPACITY);
+
+    LockedQueue locked;
+    run("Queue+Lock", &locked, 1, lockedProducer, lockedConsumer);
+    SPSCQueue<int> spsc(CAPACITY);
+    run("SPSCQueue", &spsc, 1, producer< SPSCQueue<int> >, consumer< SPSCQueue<int> >);
+    MPMCQueue<int> mpmc1(CAPACITY);
+    run("MPMCQueue", &mpmc1, 1, producer< MPMCQueue<int> >, consumer< MPMCQueue<int> >);
+
+    LockedQueue locked4;
+    run("Queue+Lock", &locked4, MAX_THREADS, lockedProducer, lockedConsumer);
+    MPMCQueue<int> mpmc4(CAPACITY);
+    run("MPMCQueue", &mpmc4, MAX_THREADS, producer< MPMCQueue<int> >, consumer< MPMCQueue<int> >);
+    return 0;
+}
@@ -35,6 +35,7 @@ using namespace std;
 static void testInsertionOperator(HashMap<string,string> & elements,
                                   string pattern);
 static void testExtractionOperator();
+static void testRehash();
 static void testMapCopy(HashMap<string,string> & map,
                         HashMap<string,string> mapByValue);
 static void markElement(string name, int & elementBitSet, string & str);
@@ -95,6 +96,7 @@ void testHashMapClass() {
    test(elements.toString(), "{" + pattern + "}");
    testInsertionOperator(elements, pattern);
    testExtractionOperator();
+   testRehash();
    reportResult("HashMap class");
 }
 
@@ -165,6 +167,29 @@ static void testInsertionOperator(HashMap<string,string> & elements,
    test(ss.str(), "{" + pattern + "}");
 }
 
+/* Test that entries survive the table growing and being copied */
+
+static void testRehash() {
+   HashMap<int,int> squares;
+   reportMessage("HashMap<int,int> squares;");
+   reportMessage("for (int i = 0; i < 1000; i++) squares[i] = i * i;");
+   for (int i = 0; i < 1000; i++) squares[i] = i * i;
+   test(squares.size(), 1000);
+   test(squares.get(999), 998001);
+   trace(squares.remove(500));
+   test(squares.containsKey(500), false);
+   test(squares.containsKey(501), true);
+   HashMap<int,int> copy = squares;
+   reportMessage("HashMap<int,int> copy = squares;");
+   test(copy.size(), 999);
+   test(copy.get(31), 961);
+   test(copy == squares, true);
+   test(hashCode(copy) == hashCode(squares), true);
+   test(hashCode(0.0) == hashCode(-0.0), true);
+   test(hashCode64(string("abc")) == hashCode64("abc"), true);
+   test(hashCode(string("abc")) == hashCode("abc"), true);
+}
+
 static void testExtractionOperator() {
    declare(istringstream ss("{one:1, two:2, three:3}"));
    reportMessage("HashMap<string,int> map;");
@@ -28,11 +28,13 @@
 #include "queue.h"
 #include "strlib.h"
 #include "unittest.h"
+#include "vector.h"
 using namespace std;
 
 static string enqueueTest(Queue<int> & queue, int n);
 static string dequeueTest(Queue<int> & queue, int n);
 static void testQueueCopy(Queue<string> & queue, Queue<string> queueByValue);
+static void testBulkOperations();
 
 void testQueueClass() {
    declare(Queue<string> queue);
@@ -63,6 +65,7 @@ void testQueueClass() {
    test(intQueue.dequeue(), 2);
    test(intQueue.dequeue(), 3);
    test(intQueue.isEmpty(), true);
+   testBulkOperations();
    reportResult("Queue class");
 }
 
@@ -102,3 +105,36 @@ static void testQueueCopy(Queue<string> & queue, Queue<string> queueByValue) {
    }
    test(elementsByValue == elementsCopy, true);
 }
+
+/* Test enqueueAll, dequeueInto, and fixed-capacity queues */
+
+static void testBulkOperations() {
+   declare(Queue<int> fixedQueue(4, true));
+   declare(Vector<int> values);
+   reportMessage("values += 1, 2, 3;");
+   values += 1, 2, 3;
+   trace(fixedQueue.enqueueAll(values));
+   test(fixedQueue.size(), 3);
+   test(fixedQueue.isFull(), false);
+   checkError(fixedQueue.enqueueAll(values),
+              "Queue::enqueue: Attempting to enqueue onto a full fixed-capacity queue");
+   test(fixedQueue.size(), 3);
+   declare(int buffer[4]);
+   test(fixedQueue.dequeueInto(buffer, 2), 2);
+   test(buffer[1], 2);
+   trace(fixedQueue.enqueueAll(values));
+   test(fixedQueue.isFull(), true);
+   test(fixedQueue.toString(), "{3, 1, 2, 3}");
+   test(fixedQueue.dequeueInto(buffer, 10), 4);
+   test(buffer[0] + buffer[3], 6);
+   test(fixedQueue.isEmpty(), true);
+   declare(Queue<int> growingQueue);
+   for (int i = 0; i < 25; i++) {
+      growingQueue.enqueue(i);
+      if (i % 2 == 0) growingQueue.dequeue();
+   }
+   trace(growingQueue.enqueueAll(values));
+   test(growingQueue.size(), 15);
+   test(growingQueue.peek(), 13);
+   test(growingQueue.back(), 3);
+}
@@ -48,6 +48,9 @@ static void testInsertionOperator();
 static void testExtractionOperator();
 static void testSetCopy(Set<char> & set, Set<char> setByValue);
 static string setSignature(Set<char> & set);
+static void appendToMapAllString(char ch);
+
+static string mapAllString;
 
 void testSetClass() {
    testCharSet();
@@ -91,6 +94,9 @@ static void testCharSet() {
    declare(string str = "");
    trace(foreach (char ch in vowels) str += ch);
    test(str, "aeiou");
+   trace(mapAllString = "");
+   trace(vowels.mapAll(appendToMapAllString));
+   test(mapAllString, "aeiou");
    testCommaOperator();
    testSetCopy(consonants, consonants);
    testSetCopy(empty, empty);
@@ -232,3 +238,7 @@ static string setSignature(Set<char> & set) {
    }
    return signature;
 }
+
+static void appendToMapAllString(char ch) {
+   mapAllString += ch;
+}
@@ -31,6 +31,7 @@
 using namespace std;
 
 static void testStackCopy(Stack<int> & stack, Stack<int> stackByValue);
+static void testInlineStack();
 
 void testStackClass() {
    declare(Stack<int> intStack);
@@ -53,6 +54,7 @@ void testStackClass() {
    test(intStack.pop(), 2);
    test(intStack.pop(), 1);
    test(intStack.isEmpty(), true);
+   testInlineStack();
    reportResult("Stack class");
 }
 
@@ -72,3 +74,30 @@ static void testStackCopy(Stack<int> & stack, Stack<int> stackByValue) {
    }
    test(elementsByValue == elementsCopy, true);
 }
+
+/* Test a stack that outgrows its inline buffer */
+
+static void testInlineStack() {
+   reportMessage("Stack<string,2> stack;");
+   Stack<string,2> stack;
+   trace(stack.push("one"));
+   trace(stack.push("two"));
+   trace(stack.push("three"));
+   test(stack.size(), 3);
+   test(stack.toString(), "{\"one\", \"two\", \"three\"}");
+   reportMessage("Stack<string,2> copy = stack;");
+   Stack<string,2> copy = stack;
+   test(copy == stack, true);
+   test(stack.pop(), "three");
+   test(copy == stack, false);
+   trace(stack.clear());
+   test(stack.isEmpty(), true);
+   trace(stack.push("four"));
+   test(stack.peek(), "four");
+   trace(stack = copy);
+   test(stack.size(), 3);
+   test(stack.pop(), "three");
+   test(stack.pop(), "two");
+   test(stack.pop(), "one");
+   checkError(stack.pop(), "Stack::pop: Attempting to pop an empty stack");
+}